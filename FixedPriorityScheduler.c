@@ -1,30 +1,48 @@
 #include "FixedPriorityScheduler.h"
+#include "waittable.h"
 #ifndef __STM32F3xx_H
 #include "stm32f3xx.h"
 #include <stdio.h>
 #endif
 /* This is an implementation of a Fixed-Priority Scheduler.
 
-   An array of pointers to TCBs is declared, and when tasks are added they are inserted into
-	 this array.  When tasks finish, they are removed from the array (pointers are set back to
-	 zero). 
-	 
-	 When the scheduler is invoked, the program checks whether there is a runnable task. If a 
-	 runnable taske exists, the priority is checked and the task is run. 
-	 
-	 The inefficiency in this implementation arises mainly from the way arrays are used for list
-	 storage.  If the array is large and the number of tasks is small, the scheduler will spend
-	 a lot of time looking through the array each time it is called. */
+   Every task is on exactly one of three intrusive lists, linked through its TCB: the ready
+	 list, the sleep list (kept in wake-up order) or the wait table (see waittable.h), where the
+	 waiters for each reason are kept in priority order, first come first served within a
+	 priority, so the most urgent waiter is always woken first.  Adding, removing, waking and
+	 blocking a task don't depend on how many other tasks there are, and there is no limit on
+	 the number of tasks other than memory for their TCBs.
+
+	 The running task is always the head of the ready list.  It keeps the CPU until its time
+	 slice, which depends on its priority, runs out, and then goes to the back of the list.
+	 A sleeper that falls due is put in front of it on that tick, and the task it displaced
+	 carries on with the rest of its slice when the sleeper gives up the CPU.
+	 When the scheduler is invoked, it only needs to look at the head of the ready list and
+	 the head of the sleep list.
+
+	 Slices are budgets of CPU time in core clock cycles, measured by the kernel at every
+	 switch (see OS_taskCycles()), not spans of wall-clock ticks.  A task's 'ticks' field holds
+	 the value its own cycle count must reach for the slice to end, so time spent preempted,
+	 asleep or waiting doesn't use it up, and a task that yields or blocks keeps what is left
+	 for next time.  The slice can only be taken away on a tick, so a task may overrun it by
+	 up to a tick; the overrun comes off its next slice. */
 
 /* Prototypes (functions are static, so these aren't in the header file) */
 static OS_TCB_t const *fixedPriorityScheduler_scheduler(void);
-static void fixedPriorityScheduler_addTask(OS_TCB_t * const tcb);
+static uint32_t fixedPriorityScheduler_addTask(OS_TCB_t * const tcb);
 static void fixedPriorityScheduler_taskExit(OS_TCB_t * const tcb);
 static void fixedPriorityScheduler_wait(void* const reason, uint32_t checkCode);
 static void fixedPriorityScheduler_notify(void* const reason);
+static uint32_t fixedPriorityScheduler_notifyOne(void* const reason);
+static uint32_t fixedPriorityScheduler_tick(uint32_t now);
+static uint32_t fixedPriorityScheduler_nextWake(uint32_t now);
+
+/* Task lists */
+static OS_list_t readyList = OS_LIST_INIT(readyList);
+static OS_list_t sleepList = OS_LIST_INIT(sleepList);
+static OS_waitTable_t waitTable = OS_WAIT_TABLE_INIT;
 
-/* Define maximum tasks */
-static OS_TCB_t * tasks[SIMPLE_FP_MAX_TASKS] = {0};
+#define TASK_OF(node) OS_LIST_ENTRY(node, OS_TCB_t, schedNode)
 
 
 /* Scheduler block for the Fixed-Priority Scheduler */
@@ -34,101 +52,148 @@ OS_Scheduler_t const fixedPriorityScheduler = {
 	.addtask_callback = fixedPriorityScheduler_addTask,
 	.taskexit_callback = fixedPriorityScheduler_taskExit,
 	.wait_callback = fixedPriorityScheduler_wait,
-	.notify_callback = fixedPriorityScheduler_notify 
+	.notify_callback = fixedPriorityScheduler_notify,
+	.notifyone_callback = fixedPriorityScheduler_notifyOne,
+	.tick_callback = fixedPriorityScheduler_tick,
+	.nextwake_callback = fixedPriorityScheduler_nextWake
 };
 
 //TODO: Check OS_TCB_t data field as it is being used for reason in Notify / Wait As well as tick counter in Scheduler
 
 
+/* Puts a task on the sleep list, behind any task that is due to wake at the same time or earlier */
+static void sleepListInsert(OS_TCB_t * const task) {
+	OS_listNode_t *position = sleepList.prev;
+	while (position != &sleepList && OS_tickBefore(task->data, TASK_OF(position)->data)) {
+		position = position->prev;
+	}
+	OS_listInsertBefore(position->next, &task->schedNode);
+}
+
+/* Returns non-zero if the first sleeper's wake-up time is before tick 'now' */
+static uint32_t sleeperDue(uint32_t now) {
+	return !OS_listIsEmpty(&sleepList) && OS_tickBefore(TASK_OF(sleepList.next)->data, now);
+}
+
+/* Returns non-zero if a task has used up its time slice */
+static uint32_t sliceUsed(OS_TCB_t const * const task) {
+	return (int32_t)(OS_taskCycles(task) - task->ticks) >= 0;
+}
+
+/* Starts a new time slice for a task, of a length depending on its priority */
+static void sliceStart(OS_TCB_t * const task) {
+	uint32_t ticks;
+	if (task->priority == HIGH) {
+		ticks = HIGH;
+	}
+	else if (task->priority == MEDIUM) {
+		ticks = MEDIUM;
+	}
+	else {
+		ticks = LOW;
+	}
+	uint32_t const slice = ticks * OS_tickCycles();
+	// Carry an overrun into the new slice, unless it would use up the whole of it
+	task->ticks += slice;
+	if (sliceUsed(task)) {
+		task->ticks = OS_taskCycles(task) + slice;
+	}
+}
+
 /* Fixed-Priority Scheduler callback */
 static OS_TCB_t const *fixedPriorityScheduler_scheduler(void) {
-	static int i = 0;
 	// store the elapsed ticks value at the start of the task
 	const uint32_t OSticks = OS_elapsedTicks();
-	const OS_TCB_t *OSCurrentTask = OS_currentTCB();
-	for (int j = 0; j < SIMPLE_FP_MAX_TASKS; j++) {
-		// Determine whether there is a current task and if it is runnable
-		if (tasks[i] == NULL || !isTaskRunnable(tasks[i], OSticks)) {
-			// Consider next task 
-			i = (i + 1) % SIMPLE_FP_MAX_TASKS; 
-			continue; 
-		}	
-		// Check if the current task have ticks left?
-		if (tasks[i]->ticks > OSticks) {
-			// If yes, return task
-			return tasks[i]; 
+	OS_TCB_t *OSCurrentTask = OS_currentTCB();
+	// Determine whether the current task is still at the head of the ready list
+	if (!OS_listIsEmpty(&readyList) && TASK_OF(readyList.next) == OSCurrentTask) {
+		if (OSCurrentTask->state & TASK_STATE_SLEEP) {
+			// Task has gone to sleep
+			OS_listRemove(&OSCurrentTask->schedNode);
+			sleepListInsert(OSCurrentTask);
+		}
+		else if ((OSCurrentTask->state & TASK_STATE_YIELD) || sliceUsed(OSCurrentTask)) {
+			// Task has yielded or is out of time. Consider the next task
+			OS_listRemove(&OSCurrentTask->schedNode);
+			OS_listPushBack(&readyList, &OSCurrentTask->schedNode);
 		}
-		else {
-			// If no, check if task is currently running
-			if (tasks[i] == OSCurrentTask){
-				// if yes, this task is out of time. Consider the next task
-				i = (i + 1) % SIMPLE_FP_MAX_TASKS;
-				continue;
-			}
-			else {
-				// If no, task needs to be run again. Set its new tick value depending on priority
-				if (tasks[i]->priority == HIGH) {
-					tasks[i]->ticks = OSticks + HIGH;
-				}
-				else if (tasks[i]->priority == MEDIUM) {
-					tasks[i]->ticks = OSticks + MEDIUM;
-				}		
-				else {
-					tasks[i]->ticks = OSticks + LOW;
-				}
-			}
+		else if (!sleeperDue(OSticks)) {
+			// Task has ticks left, keep running it
+			return OSCurrentTask;
 		}
-		return tasks[i];					
+		// Otherwise a sleeper is due and goes in front of it.  It keeps the rest of its slice.
+	}
+	// Clear yield state - the task has now given up the CPU
+	OSCurrentTask->state &= ~TASK_STATE_YIELD;
+	// Wake any sleepers whose time has elapsed.  Only the head of the list needs checking.
+	while (sleeperDue(OSticks)) {
+		OS_TCB_t *task = TASK_OF(sleepList.next);
+		OS_listRemove(&task->schedNode);
+		// Clear sleep state.  Whatever was left of its time slice is still there.
+		task->state &= ~TASK_STATE_SLEEP;
+		// Put it at the front of the ready list, so that it runs next
+		OS_listInsertBefore(readyList.next, &task->schedNode);
+	}
+	// If there are no valid tasks in the task list, return the idle task.
+	if (OS_listIsEmpty(&readyList)) {
+		return OS_idleTCB_p;
 	}
-	// If there are no valid tasks in the task list, return the idle task. 
-	return OS_idleTCB_p;
+	OS_TCB_t *task = TASK_OF(readyList.next);
+	// If the task has used up its time slice, give it a new one
+	if (sliceUsed(task)) {
+		sliceStart(task);
+	}
+	return task;
 }
 
-/*Fixed-Priority Scheduler function to determine whether a task is runnable by checking the state*/
-static uint32_t isTaskRunnable(OS_TCB_t *task, const uint32_t curTicks) {
-	// Check if task is in yield state
-	if (task->state & TASK_STATE_YIELD) {
-		// Clear yield state
-		task->state &= ~TASK_STATE_YIELD;
-		return 0;
+/* Tick callback.  Returns non-zero only if the scheduler callback would do more than carry on
+   with the running task: its time slice is over, it is no longer at the head of the ready
+	 list, or a sleeper is due.  A due sleeper is woken on this tick even if the running task
+	 has time left, so OS_sleep(n) always returns on the first tick more than n ticks later,
+	 unless another task woken on the same tick runs first.  Sleeping, yielding and waiting
+	 pend PendSV for themselves, so they don't need to be checked here. */
+static uint32_t fixedPriorityScheduler_tick(uint32_t now) {
+	OS_TCB_t const *OSCurrentTask = OS_currentTCB();
+	if (sleeperDue(now)) {
+		return 1;
 	}
-	// Check if tasks is in sleep state
-	else if (task->state & TASK_STATE_SLEEP) {		
-		// Check if the right amount of time has elapsed 
-		if (task->data < curTicks) {
-			// Clear sleep state
-			task->state &= ~TASK_STATE_SLEEP;
-			return 1;
-		}
-		return 0;
+	if (!OS_listIsEmpty(&readyList)) {
+		return TASK_OF(readyList.next) != OSCurrentTask || sliceUsed(OSCurrentTask);
 	}
-	// If task state is wait return task is not runnable
-	else if (task->state & TASK_STATE_WAIT) {
-		return 0;
+	return OSCurrentTask != OS_idleTCB_p;
+}
+
+/* Next-wake callback.  A sleeper is woken on the first tick after its wake-up time. */
+static uint32_t fixedPriorityScheduler_nextWake(uint32_t now) {
+	if (OS_listIsEmpty(&sleepList)) {
+		return 0xFFFFFFFF;
 	}
-	return 1; 
+	uint32_t const wake = TASK_OF(sleepList.next)->data;
+	return OS_tickBefore(wake, now) ? 0 : wake + 1 - now;
 }
 
 /* Add task callback */
-static void fixedPriorityScheduler_addTask(OS_TCB_t * const tcb) {
-	for (int i = 0; i < SIMPLE_FP_MAX_TASKS; i++) {
-		if (tasks[i] == 0) {
-			tasks[i] = tcb;
-			tasks[i]->data = OS_elapsedTicks();
-			return;
-		}
+static uint32_t fixedPriorityScheduler_addTask(OS_TCB_t * const tcb) {
+	// A task can only be added once
+	if (OS_listIsLinked(&tcb->schedNode)) {
+		return 0;
 	}
-	// If we get here, there are no free TCB slots, the task won't be added
+	tcb->data = OS_elapsedTicks();
+	// Its first slice starts when it first runs
+	tcb->ticks = tcb->cycles;
+	OS_listPushBack(&readyList, &tcb->schedNode);
+	return 1;
 }
 
 /* Task exit callback */
 static void fixedPriorityScheduler_taskExit(OS_TCB_t * const tcb) {
-	// Remove the given TCB from the list of tasks so it won't be run again
-	for (int i = 0; i < SIMPLE_FP_MAX_TASKS; i++) {
-		if (tasks[i] == tcb) {
-			tasks[i] = 0;
-		}
-	}	
+	// Remove the given TCB from whichever list it is on so it won't be run again
+	if (tcb->state & TASK_STATE_WAIT) {
+		OS_waitTableRemove(&waitTable, tcb);
+	}
+	else if (OS_listIsLinked(&tcb->schedNode)) {
+		OS_listRemove(&tcb->schedNode);
+	}
 }
 
 /* Task wait callback */
@@ -136,26 +201,43 @@ static void fixedPriorityScheduler_wait(void* const reason, uint32_t checkCode){
 	// Store the reason code in the current TCB by using the data field
 	// Check code increases when notify is called, to allow the task that is about to wait whether it needs to.
 	if(checkCode == currentCheckValue()){
-		OS_currentTCB()->data = (uint32_t)reason; 
-		// Waiting state 
-		OS_currentTCB()->state |= TASK_STATE_WAIT; 
+		OS_TCB_t *task = OS_currentTCB();
+		task->data = (uint32_t)reason;
+		// Waiting state
+		task->state |= TASK_STATE_WAIT;
+		OS_listRemove(&task->schedNode);
+		OS_waitTableInsert(&waitTable, task, 1);
 		SCB->ICSR = SCB_ICSR_PENDSVSET_Msk;
 	}
 	else {
-		return; 
+		return;
 	}
 }
 
-/* Task notify callback */
+/* Moves a task taken from the wait table back to the ready list */
+static void waitTableWake(OS_TCB_t * const task) {
+	// Clear wait state
+	task->state &= ~TASK_STATE_WAIT;
+	task->data = 0;
+	OS_listPushBack(&readyList, &task->schedNode);
+}
+
+/* Task notify callback.  The waiters are in priority order, so the woken tasks join the
+   ready list highest priority first. */
 static void fixedPriorityScheduler_notify(void* const reason){
-		for (int i = 0; i < SIMPLE_FP_MAX_TASKS; i++) {
-		if (tasks[i] != 0) {
-			// If task state is wait and data is equal to the reason code 
-			if ((tasks[i]->state & TASK_STATE_WAIT) && (tasks[i]->data == (uint32_t)reason)) {
-					// Clear wait state
-					tasks[i]->state &= ~TASK_STATE_WAIT;
-					tasks[i]->data = 0;
-			}
-		}
-		}
+	OS_TCB_t *task;
+	while ((task = OS_waitTableTake(&waitTable, reason)) != 0) {
+		waitTableWake(task);
+	}
+}
+
+/* Task notify-one callback: wakes the highest-priority task waiting for the reason (the one
+   that has waited longest, if several share that priority) */
+static uint32_t fixedPriorityScheduler_notifyOne(void* const reason){
+	OS_TCB_t * const task = OS_waitTableTake(&waitTable, reason);
+	if (task) {
+		waitTableWake(task);
+		return 1;
+	}
+	return 0;
 }
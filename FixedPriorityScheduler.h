@@ -3,11 +3,7 @@
 
 #include "os.h"
 
-// define max tasks system can process
-#define SIMPLE_FP_MAX_TASKS 8
-
 extern OS_Scheduler_t const fixedPriorityScheduler;
-static uint32_t isTaskRunnable(OS_TCB_t *task, const uint32_t curTicks);
 
 enum FPSPriority {
 	HIGH =16,
@@ -0,0 +1,63 @@
+#ifndef _CRITICAL_H_
+#define _CRITICAL_H_
+
+#include <stdint.h>
+#include "stm32f3xx.h"
+
+/* Interrupt priority model.  Priorities are the numbers passed to NVIC_SetPriority(): 0 is the
+   most urgent and (1 << __NVIC_PRIO_BITS) - 1 the least.
+
+	 SVC, PendSV and SysTick all run at OS_KERNEL_PRIORITY, the least urgent level, so every
+	 interrupt can preempt the kernel, and the kernel handlers can never preempt each other.
+	 Interrupts at OS_MAX_SYSCALL_PRIORITY or less urgent may use the FromISR functions.  Those
+	 more urgent than it are never masked by the kernel, so they see no jitter from it, but they
+	 must not call any kernel function at all. */
+#define OS_KERNEL_PRIORITY ((1 << __NVIC_PRIO_BITS) - 1)
+#define OS_MAX_SYSCALL_PRIORITY 5
+
+#if OS_MAX_SYSCALL_PRIORITY < 1 || OS_MAX_SYSCALL_PRIORITY > OS_KERNEL_PRIORITY
+#error "OS_MAX_SYSCALL_PRIORITY must be between 1 and OS_KERNEL_PRIORITY"
+#endif
+
+/* The same level as a BASEPRI value: the priority sits in the top bits of the byte */
+#define OS_MAX_SYSCALL_BASEPRI (OS_MAX_SYSCALL_PRIORITY << (8 - __NVIC_PRIO_BITS))
+
+/* Masks every interrupt that may call the kernel, leaving the more urgent ones running, and
+   returns the previous mask to hand to OS_exitCritical().  Critical sections nest, and an
+	 interrupt that is already more urgent than OS_MAX_SYSCALL_PRIORITY is left unchanged.
+	 BASEPRI can only be written in privileged code, so this is for interrupt handlers and the
+	 kernel; tasks must use a mutex instead.  Keep critical sections short: they delay every
+	 interrupt that they mask. */
+static inline uint32_t OS_enterCritical(void) {
+	uint32_t const previous = __get_BASEPRI();
+	__set_BASEPRI_MAX(OS_MAX_SYSCALL_BASEPRI);
+	__DSB();
+	__ISB();
+	return previous;
+}
+
+/* Ends a critical section begun by OS_enterCritical() */
+static inline void OS_exitCritical(uint32_t previous) {
+	__set_BASEPRI(previous);
+}
+
+/* Returns non-zero if the code calling it is allowed to use the FromISR functions: privileged
+   thread mode (main() before OS_start()), or an exception no more urgent than
+	 OS_MAX_SYSCALL_PRIORITY.  Tasks run unprivileged (see os_asm.s), where OS_enterCritical()
+	 can't mask anything, so they must not call the FromISR functions; they have the SVC-based
+	 calls.  NMI and HardFault have fixed priorities above every configurable one, so they never
+	 are allowed.  The system handlers (SVC, PendSV, SysTick and the configurable faults) have
+	 negative IRQ numbers, which NVIC_GetPriority() looks up in the SCB. */
+static inline uint32_t OS_kernelCallAllowed(void) {
+	uint32_t const exception = __get_IPSR();
+	if (exception == 0) {
+		// CONTROL.nPRIV is set in unprivileged thread mode
+		return !(__get_CONTROL() & 1);
+	}
+	if (exception < 4) {
+		return 0;
+	}
+	return NVIC_GetPriority((IRQn_Type)((int32_t) exception - 16)) >= OS_MAX_SYSCALL_PRIORITY;
+}
+
+#endif /* _CRITICAL_H_ */
@@ -0,0 +1,95 @@
+#include "idle.h"
+#include "os_internal.h"
+
+/* This is the idle task.
+
+	 It runs whenever the scheduler has nothing else to run.  Each time round its loop it
+	 calls every idle hook, and only when none of them has anything left to do does it ask
+	 the power policy (through an SVC, since the deadline comes from the scheduler and the
+	 timer wheel) whether to sleep.  The WFI itself is done in thread mode, so SysTick and
+	 other interrupts can wake it whatever their priority.  If the idle task is switched out
+	 between the SVC and the WFI, PendSV clears SLEEPDEEP, so when it comes back it only
+	 sleeps until the next interrupt.
+
+	 Idle time is measured by PendSV with the kernel's cycle clock, _OS_cycleNow(), which
+	 keeps counting while the core sleeps. */
+
+static OS_idleHook_t _hooks[OS_IDLE_MAX_HOOKS];
+static uint32_t volatile _hookCount = 0;
+static OS_idlePolicy_t volatile _policy = OS_idlePolicyDefault;
+
+static uint64_t _idleCycles = 0;
+static uint64_t _idleStart = 0;
+static uint32_t _sleeps = 0;
+static uint32_t _deepSleeps = 0;
+
+uint32_t OS_idleHookAdd(OS_idleHook_t hook) {
+	if (_hookCount == OS_IDLE_MAX_HOOKS) {
+		return 0;
+	}
+	// The idle task only looks at hooks below the count, so fill in the slot first
+	_hooks[_hookCount] = hook;
+	_hookCount = _hookCount + 1;
+	return 1;
+}
+
+void OS_idleSetPolicy(OS_idlePolicy_t policy) {
+	_policy = policy ? policy : OS_idlePolicyDefault;
+}
+
+uint32_t OS_idlePolicyDefault(uint32_t ticks) {
+	if (!OS_IDLE_SLEEP) {
+		return OS_IDLE_RUN;
+	}
+	if (OS_IDLE_DEEP_SLEEP_TICKS && ticks >= OS_IDLE_DEEP_SLEEP_TICKS) {
+		return OS_IDLE_DEEP;
+	}
+	return OS_IDLE_WFI;
+}
+
+/* SVC handler for _OS_idlePrepare() */
+void _svc_OS_idlePrepare(_OS_SVC_StackFrame_t * const stack) {
+	uint32_t const mode = _policy(_OS_nextDeadline());
+	if (mode == OS_IDLE_DEEP) {
+		SCB->SCR |= SCB_SCR_SLEEPDEEP_Msk;
+		_deepSleeps++;
+	} else {
+		SCB->SCR &= ~SCB_SCR_SLEEPDEEP_Msk;
+		if (mode == OS_IDLE_WFI) {
+			_sleeps++;
+		}
+	}
+	stack->r0 = mode;
+}
+
+void _OS_idleTask(void) {
+	while (1) {
+		uint32_t busy = 0;
+		for (uint32_t i = 0; i < _hookCount; i++) {
+			busy |= _hooks[i]();
+		}
+		if (!busy && _OS_idlePrepare() != OS_IDLE_RUN) {
+			__DSB();
+			__WFI();
+		}
+	}
+}
+
+void _OS_idleSwitch(uint32_t entering) {
+	uint64_t const now = _OS_cycleNow();
+	if (entering) {
+		_idleStart = now;
+	} else {
+		_idleCycles += now - _idleStart;
+		SCB->SCR &= ~SCB_SCR_SLEEPDEEP_Msk;
+	}
+}
+
+/* SVC handler for OS_idleStats() */
+void _svc_OS_idleStats(_OS_SVC_StackFrame_t const * const stack) {
+	OS_idleStats_t * const stats = (OS_idleStats_t *) stack->r0;
+	stats->idleCycles = _idleCycles;
+	stats->totalCycles = _OS_cycleNow();
+	stats->sleeps = _sleeps;
+	stats->deepSleeps = _deepSleeps;
+}
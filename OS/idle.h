@@ -0,0 +1,60 @@
+#ifndef _IDLE_H_
+#define _IDLE_H_
+
+#include <stdint.h>
+#include "os.h"
+
+/* Stack size in bytes of the idle task, which runs the idle hooks.  Must be a multiple of 8. */
+#define OS_IDLE_STACK_SIZE 256
+/* Maximum number of idle hooks */
+#define OS_IDLE_MAX_HOOKS 4
+/* If zero, the default power policy never sleeps, which is kinder to the debugger */
+#define OS_IDLE_SLEEP 1
+/* The default power policy uses deep sleep when nothing is due for at least this many ticks.
+   Zero means never.  Deep sleep stops SysTick, so a wake-up source (an RTC alarm, say) must be
+	 arranged for the deadline, or the tick count will fall behind. */
+#define OS_IDLE_DEEP_SLEEP_TICKS 0
+
+/* What the idle task does once the hooks have nothing left to do */
+typedef enum {
+	OS_IDLE_RUN,      // go round again without sleeping
+	OS_IDLE_WFI,      // sleep until the next interrupt
+	OS_IDLE_DEEP      // WFI with SLEEPDEEP set (stop mode)
+} OS_idleMode_e;
+
+/* An idle hook does a little background work (aggregating statistics, draining a trace
+   buffer, reclaiming memory, checking stacks) and returns non-zero if it has more to do, in
+	 which case the CPU doesn't sleep.  Hooks run in the idle task, unprivileged and at the
+	 lowest priority, so they must never block or wait. */
+typedef uint32_t (* OS_idleHook_t)(void);
+
+/* A power policy is given the number of ticks until the kernel next has something to do
+   (0xFFFFFFFF if nothing is scheduled), and returns an OS_idleMode_e.  It runs in an SVC
+	 handler, so it may touch privileged registers to set up a wake-up source. */
+typedef uint32_t (* OS_idlePolicy_t)(uint32_t ticks);
+
+typedef struct {
+	uint64_t idleCycles;      // core clock cycles spent in the idle task
+	uint64_t totalCycles;     // core clock cycles since the OS started
+	uint32_t sleeps;          // times the idle task slept with WFI
+	uint32_t deepSleeps;      // times it used deep sleep
+} OS_idleStats_t;
+
+/* Registers an idle hook.  Returns zero if there are already OS_IDLE_MAX_HOOKS. */
+uint32_t OS_idleHookAdd(OS_idleHook_t hook);
+/* Replaces the power policy.  Passing zero restores the default. */
+void OS_idleSetPolicy(OS_idlePolicy_t policy);
+/* The default power policy (see OS_IDLE_SLEEP and OS_IDLE_DEEP_SLEEP_TICKS) */
+uint32_t OS_idlePolicyDefault(uint32_t ticks);
+/* Fills in the idle-time statistics */
+void __svc(OS_SVC_IDLE_STATS) OS_idleStats(OS_idleStats_t * stats);
+
+/* SVC delegate for the idle task: asks the power policy what to do, and sets SLEEPDEEP to
+   suit.  Returns an OS_idleMode_e. */
+uint32_t __svc(OS_SVC_IDLE_PREPARE) _OS_idlePrepare(void);
+/* The idle task.  _task_init_switch branches here once the OS is running. */
+void _OS_idleTask(void);
+/* Called by PendSV when it switches into the idle task (entering non-zero) or out of it */
+void _OS_idleSwitch(uint32_t entering);
+
+#endif /* _IDLE_H_ */
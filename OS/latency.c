@@ -0,0 +1,133 @@
+#include "latency.h"
+#include "os_internal.h"
+#include <string.h>
+
+/* This is the kernel latency profiler.
+
+	 SysTick and the FromISR functions note when they asked for PendSV.  PendSV notes when it
+	 started and which of the two it is serving (interrupt requests first, since they are
+	 drained before the scheduler runs).  If the scheduler picks a different task, the end
+	 of _task_switch closes the samples; otherwise PendSV closes its own sample on the way
+	 out.  Every sample goes into a log2 histogram, so recording is a CLZ and an increment.
+	 Everything is updated in handler mode at PendSV or SysTick priority except the interrupt
+	 request stamp, which interrupts that can preempt PendSV set.  That is one word, set if it
+	 is zero and swapped for zero by PendSV with LDREX/STREX, so no request's stamp is lost
+	 between PendSV reading it and clearing it. */
+
+#if OS_LATENCY_ENABLED
+
+static OS_latencyHistogram_t _histograms[OS_LATENCY_PATHS];
+static uint32_t volatile _tickStamp, _tickPending;
+static uint32_t volatile _irqStamp;   // with bit 0 set; zero if no request is waiting
+static uint32_t _pendSVStamp;
+static uint32_t _switchPath, _switchStamp;   // OS_LATENCY_PATHS if none
+
+/* Timestamps are the kernel's cycle clock, modulo 2^32 */
+static uint32_t _latencyNow(void) {
+	return (uint32_t)_OS_cycleNow();
+}
+
+static void _latencyRecord(uint32_t path, uint32_t cycles) {
+	OS_latencyHistogram_t * const histogram = &_histograms[path];
+	uint32_t bin = 32 - __CLZ(cycles);
+	if (bin >= OS_LATENCY_BINS) {
+		bin = OS_LATENCY_BINS - 1;
+	}
+	histogram->bins[bin]++;
+	if (histogram->count == 0 || cycles < histogram->min) {
+		histogram->min = cycles;
+	}
+	if (cycles > histogram->max) {
+		histogram->max = cycles;
+	}
+	histogram->count++;
+	histogram->total += cycles;
+}
+
+void _OS_latencyInit(void) {
+	memset(_histograms, 0, sizeof(_histograms));
+	_switchPath = OS_LATENCY_PATHS;
+}
+
+void _OS_latencyTick(uint32_t stamp) {
+	if (!_tickPending) {
+		_tickStamp = stamp;
+		_tickPending = 1;
+	}
+}
+
+void _OS_latencyIrq(void) {
+	// Bit 0 marks the stamp as set, at the cost of a cycle's resolution
+	uint32_t const stamp = _latencyNow() | 1;
+	do {
+		if (__LDREXW((uint32_t *) &_irqStamp)) {
+			// An earlier request is still waiting for PendSV
+			__CLREX();
+			return;
+		}
+	} while (__STREXW(stamp, (uint32_t *) &_irqStamp));
+}
+
+void _OS_latencyPendSV(void) {
+	uint32_t irqStamp;
+	_pendSVStamp = _latencyNow();
+	do {
+		irqStamp = __LDREXW((uint32_t *) &_irqStamp);
+	} while (__STREXW(0, (uint32_t *) &_irqStamp));
+	if (irqStamp) {
+		_switchPath = OS_LATENCY_IRQ_TO_TASK;
+		_switchStamp = irqStamp & ~1UL;
+	} else if (_tickPending) {
+		_switchPath = OS_LATENCY_TICK_TO_TASK;
+		_switchStamp = _tickStamp;
+	} else {
+		_switchPath = OS_LATENCY_PATHS;
+	}
+	_tickPending = 0;
+}
+
+OS_TCB_t const * _OS_latencySchedule(OS_TCB_t const * (* scheduler)(void)) {
+	uint32_t const start = _latencyNow();
+	OS_TCB_t const * const next = scheduler();
+	uint32_t const now = _latencyNow();
+	_latencyRecord(OS_LATENCY_SCHEDULER, now - start);
+	if (next == _currentTCB) {
+		// No switch: _task_switch returns straight away, so PendSV ends here
+		_latencyRecord(OS_LATENCY_PENDSV, now - _pendSVStamp);
+	}
+	return next;
+}
+
+void _OS_latencyResume(void) {
+	uint32_t const now = _latencyNow();
+	_latencyRecord(OS_LATENCY_PENDSV, now - _pendSVStamp);
+	if (_switchPath != OS_LATENCY_PATHS) {
+		_latencyRecord(_switchPath, now - _switchStamp);
+	}
+}
+
+#else
+
+void _OS_latencyPendSV(void) {
+}
+
+void _OS_latencyResume(void) {
+}
+
+#endif /* OS_LATENCY_ENABLED */
+
+/* SVC handler for OS_latencyRead() */
+void _svc_OS_latencyRead(_OS_SVC_StackFrame_t const * const stack) {
+	OS_latencyHistogram_t * const histogram = (OS_latencyHistogram_t *) stack->r1;
+#if OS_LATENCY_ENABLED
+	uint32_t const path = stack->r0;
+	if (path < OS_LATENCY_PATHS) {
+		*histogram = _histograms[path];
+		if (stack->r2) {
+			memset(&_histograms[path], 0, sizeof(_histograms[path]));
+		}
+		return;
+	}
+#endif
+	memset(histogram, 0, sizeof(*histogram));
+}
@@ -0,0 +1,53 @@
+#ifndef _LATENCY_H_
+#define _LATENCY_H_
+
+#include <stdint.h>
+#include "os.h"
+
+/* If non-zero, the kernel times how long it takes to get from a tick or an interrupt request
+   to the task that runs because of it, and how long PendSV and the scheduler take, and bins
+	 the results into histograms.  If zero, the hooks are compiled out (apart from two empty
+	 calls from the assembly-language handlers) and the histograms read as empty. */
+#ifndef OS_LATENCY_ENABLED
+#define OS_LATENCY_ENABLED 0
+#endif
+/* Number of histogram bins.  Bin 0 counts zero-cycle samples, bin i counts samples of
+   2^(i-1) to 2^i - 1 cycles, and the last bin also counts everything longer. */
+#define OS_LATENCY_BINS 24
+
+/* The measured paths */
+typedef enum {
+	OS_LATENCY_TICK_TO_TASK,    // SysTick entry to the switch into the task it caused to run
+	OS_LATENCY_IRQ_TO_TASK,     // first FromISR request to the switch into the task PendSV chose
+	OS_LATENCY_PENDSV,          // PendSV entry to exit, including the context switch
+	OS_LATENCY_SCHEDULER,       // the scheduler callback alone
+	OS_LATENCY_PATHS
+} OS_latencyPath_e;
+
+/* Histogram of one path.  Times are in core clock cycles. */
+typedef struct {
+	uint32_t bins[OS_LATENCY_BINS];
+	uint32_t count;
+	uint32_t min;
+	uint32_t max;
+	uint64_t total;
+} OS_latencyHistogram_t;
+
+/* Copies the histogram of one path, and if 'reset' is non-zero, clears it, without PendSV
+   being able to add a sample in between. */
+void __svc(OS_SVC_LATENCY_READ) OS_latencyRead(uint32_t path, OS_latencyHistogram_t * histogram, uint32_t reset);
+
+/* Kernel hooks */
+void _OS_latencyInit(void);
+/* Called by SysTick when it pends PendSV, with the cycle clock as it was on entry to SysTick */
+void _OS_latencyTick(uint32_t stamp);
+/* Called by _isrPush() when it queues the first of a run of requests */
+void _OS_latencyIrq(void);
+/* Called by PendSV_Handler on entry */
+void _OS_latencyPendSV(void);
+/* Times the scheduler callback, and notes whether PendSV is going to switch tasks */
+OS_TCB_t const * _OS_latencySchedule(OS_TCB_t const * (* scheduler)(void));
+/* Called by _task_switch once the new task's context is in place */
+void _OS_latencyResume(void);
+
+#endif /* _LATENCY_H_ */
@@ -0,0 +1,61 @@
+#ifndef _LIST_H_
+#define _LIST_H_
+
+#include <stdint.h>
+#include <stddef.h>
+
+/* Intrusive, circular, doubly-linked lists.
+
+   A list node is embedded in the structure that is to be listed (see OS_TCB_t), so putting
+	 something on a list never allocates memory, and insertion and removal are constant time.
+	 A list is a sentinel node whose 'next' is the first entry and whose 'prev' is the last;
+	 an empty list points at itself.  Nodes that are not on any list have null pointers. */
+
+typedef struct s_OS_listNode {
+	struct s_OS_listNode * volatile next;
+	struct s_OS_listNode * volatile prev;
+} OS_listNode_t;
+
+typedef OS_listNode_t OS_list_t;
+
+/* Static initialiser for an empty list, e.g. static OS_list_t list = OS_LIST_INIT(list); */
+#define OS_LIST_INIT(list) { &(list), &(list) }
+
+/* Given a pointer to a node, yields a pointer to the structure of the given type that
+   contains it as the given member */
+#define OS_LIST_ENTRY(node, type, member) ((type *)((char *)(node) - offsetof(type, member)))
+
+static inline void OS_listInit(OS_list_t * list) {
+	list->next = list->prev = list;
+}
+
+static inline uint32_t OS_listIsEmpty(OS_list_t const * list) {
+	return list->next == list;
+}
+
+/* Returns non-zero if the node is currently on a list */
+static inline uint32_t OS_listIsLinked(OS_listNode_t const * node) {
+	return node->next != 0;
+}
+
+/* Links 'node' into a list immediately before 'position' (which may be the list itself,
+   meaning "at the end") */
+static inline void OS_listInsertBefore(OS_listNode_t * position, OS_listNode_t * node) {
+	node->next = position;
+	node->prev = position->prev;
+	position->prev->next = node;
+	position->prev = node;
+}
+
+static inline void OS_listPushBack(OS_list_t * list, OS_listNode_t * node) {
+	OS_listInsertBefore(list, node);
+}
+
+/* Unlinks a node from whichever list it is on */
+static inline void OS_listRemove(OS_listNode_t * node) {
+	node->prev->next = node->next;
+	node->next->prev = node->prev;
+	node->next = node->prev = 0;
+}
+
+#endif /* _LIST_H_ */
@@ -1,19 +1,44 @@
 #include "os.h"
 #include "os_internal.h"
+#include "timer.h"
+#include "isr.h"
+#include "latency.h"
+#include "idle.h"
+#include "critical.h"
 #include "stm32f3xx.h"
 #include <stdlib.h>
 #include <string.h>
 
 __align(8)
-/* Idle task stack frame area and TCB.  The TCB is not declared const, to ensure that it is placed in writable
+/* Idle task stack and TCB.  The TCB is not declared const, to ensure that it is placed in writable
    memory by the compiler.  The pointer to the TCB _is_ declared const, as it is visible externally - but it will
    still be writable by the assembly-language context switch. */
-static OS_StackFrame_t const volatile _idleTaskSF;
-static OS_TCB_t OS_idleTCB = { (void *)(&_idleTaskSF + 1), 0, 0, 0 };
+static uint32_t _idleStack[OS_IDLE_STACK_SIZE / sizeof(uint32_t)];
+static OS_TCB_t OS_idleTCB = { (void *)(_idleStack + OS_IDLE_STACK_SIZE / sizeof(uint32_t)), 0, 0, 0 };
 OS_TCB_t const * const OS_idleTCB_p = &OS_idleTCB;
 
-/* Total elapsed ticks */
-static volatile uint32_t _ticks = 0;
+/* Task pool used by OS_createTask().  A slot is in use when its bit in _taskPoolUsed is set. */
+#if OS_TASK_POOL_SIZE > 32
+#error "OS_TASK_POOL_SIZE must not exceed 32"
+#endif
+static OS_TCB_t _taskPoolTCBs[OS_TASK_POOL_SIZE];
+__align(8)
+static uint32_t _taskPoolStacks[OS_TASK_POOL_SIZE][OS_TASK_POOL_STACK_SIZE / sizeof(uint32_t)];
+static uint32_t _taskPoolUsed = 0;
+
+#if OS_STACK_CHECK
+/* Words still holding OS_STACK_FILL at the bottom of the idle stack (index 0) and of each pool
+   stack, as last seen by OS_stackCheckHook(), and the stack it checks next */
+static uint32_t _stackUnused[OS_TASK_POOL_SIZE + 1];
+static uint32_t _stackNext = 0;
+#endif
+
+/* Total elapsed ticks, and the number of times that count has wrapped */
+static volatile uint32_t _ticks = OS_INITIAL_TICKS;
+static volatile uint32_t _ticksHigh = 0;
+
+/* Cycle count when the running task's time was last charged to it */
+static uint32_t _cycleMark = 0;
 
 /* Pointer to the 'scheduler' struct containing callback pointers */
 static OS_Scheduler_t const * _scheduler = 0;
@@ -39,10 +64,79 @@ uint32_t OS_elapsedTicks() {
 	return _ticks;
 }
 
-/* IRQ handler for the system tick.  Schedules PendSV */
+/* Getter for the current time in 64 bits.  SysTick may run between the two reads, so they
+   are repeated until the high word is stable. */
+uint64_t OS_elapsedTicks64() {
+	uint32_t high, low;
+	do {
+		high = _ticksHigh;
+		low = _ticks;
+	} while (high != _ticksHigh);
+	return ((uint64_t)high << 32) | low;
+}
+
+/* Core clock cycles since the OS started.  The DWT cycle counter would be simpler, but it stops
+   while the core sleeps and QEMU doesn't emulate it.  SysTick counts down from LOAD to zero
+	 over one tick.  The tick count is read until it is stable, in case an interrupt more urgent
+	 than SysTick is running; and if the counter has reloaded but SysTick hasn't run yet (it
+	 can't during an SVC or PendSV), that tick is counted here. */
+uint64_t _OS_cycleNow(void) {
+	uint32_t const load = SysTick->LOAD + 1;
+	uint64_t ticks;
+	uint32_t value;
+	do {
+		ticks = OS_elapsedTicks64();
+		value = SysTick->VAL;
+	} while (ticks != OS_elapsedTicks64());
+	if (SCB->ICSR & SCB_ICSR_PENDSTSET_Msk) {
+		ticks++;
+		value = SysTick->VAL;
+	}
+	return ticks * load + (load - 1 - value);
+}
+
+/* SVC handler for OS_nowUs().  SysTick registers can only be read in privileged mode. */
+void _svc_OS_nowUs(_OS_SVC_StackFrame_t * const stack) {
+	uint32_t const load = SysTick->LOAD + 1;
+	uint64_t const cycles = _OS_cycleNow();
+	uint64_t const us = cycles / load * OS_TICK_US + (cycles % load) * OS_TICK_US / load;
+	stack->r0 = (uint32_t)us;
+	stack->r1 = (uint32_t)(us >> 32);
+}
+
+uint32_t OS_taskCycles(OS_TCB_t const * task) {
+	uint32_t cycles = task->cycles;
+	if (task == _currentTCB) {
+		cycles += (uint32_t)_OS_cycleNow() - _cycleMark;
+	}
+	return cycles;
+}
+
+uint32_t OS_tickCycles(void) {
+	return SysTick->LOAD + 1;
+}
+
+/* IRQ handler for the system tick.  Advances the software timers and schedules PendSV if the
+   scheduler has something to do.  Anything else that changes what should run (sleeping,
+	 yielding, waiting, interrupt requests) pends PendSV for itself. */
 void SysTick_Handler(void) {
+#if OS_LATENCY_ENABLED
+	// Before the timers and the tick callback, so their time counts.  The tick being handled
+	// isn't in _ticks yet (and is no longer pending), hence the extra period.
+	uint32_t const stamp = (uint32_t)_OS_cycleNow() + SysTick->LOAD + 1;
+#endif
 	_ticks = _ticks + 1;
-	SCB->ICSR = SCB_ICSR_PENDSVSET_Msk;
+	if (_ticks == 0) {
+		_ticksHigh = _ticksHigh + 1;
+	}
+	_OS_timerTick(_ticks);
+	// Interrupt requests that PendSV had to put off are retried on the next tick
+	if (!_scheduler->tick_callback || _scheduler->tick_callback(_ticks) || _isrPending()) {
+#if OS_LATENCY_ENABLED
+		_OS_latencyTick(stamp);
+#endif
+		SCB->ICSR = SCB_ICSR_PENDSVSET_Msk;
+	}
 }
 
 /* SVC handler for OS_yield().  Sets the TASK_STATE_YIELD flag and schedules PendSV */
@@ -56,22 +150,44 @@ void _svc_OS_schedule(void) {
 	SCB->ICSR = SCB_ICSR_PENDSVSET_Msk;
 }
 
-/* Sets up the OS by storing a pointer to the structure containing all the callbacks.
-   Also establishes the system tick timer and interrupt if preemption is enabled. */
+/* Sets up the OS by storing a pointer to the structure containing all the callbacks, and
+   gives the kernel's exception handlers their priorities (see critical.h). */
 void OS_init(OS_Scheduler_t const * scheduler) {
 	_scheduler = scheduler;
 	SCB->CCR |= SCB_CCR_STKALIGN_Msk;
+	NVIC_SetPriority(SVCall_IRQn, OS_KERNEL_PRIORITY);
+	NVIC_SetPriority(PendSV_IRQn, OS_KERNEL_PRIORITY);
+	NVIC_SetPriority(SysTick_IRQn, OS_KERNEL_PRIORITY);
 //    *((uint32_t volatile *)0xE000ED14) |= (1 << 9); // Set STKALIGN
 	ASSERT(_scheduler->scheduler_callback);
 	ASSERT(_scheduler->addtask_callback);
 	ASSERT(_scheduler->taskexit_callback);
 	ASSERT(_scheduler->wait_callback);
 	ASSERT(_scheduler->notify_callback);
+	ASSERT(_scheduler->notifyone_callback);
+#if OS_LATENCY_ENABLED
+	_OS_latencyInit();
+#endif
+#if OS_STACK_CHECK
+	// Nothing runs on these stacks yet
+	for (uint32_t i = 0; i < OS_IDLE_STACK_SIZE / sizeof(uint32_t); i++) {
+		_idleStack[i] = OS_STACK_FILL;
+	}
+	_stackUnused[0] = OS_IDLE_STACK_SIZE / sizeof(uint32_t);
+	for (uint32_t slot = 0; slot < OS_TASK_POOL_SIZE; slot++) {
+		for (uint32_t i = 0; i < OS_TASK_POOL_STACK_SIZE / sizeof(uint32_t); i++) {
+			_taskPoolStacks[slot][i] = OS_STACK_FILL;
+		}
+		_stackUnused[slot + 1] = OS_TASK_POOL_STACK_SIZE / sizeof(uint32_t);
+	}
+	OS_idleHookAdd(OS_stackCheckHook);
+#endif
 }
 
 /* Starts the OS and never returns. */
 void OS_start() {
 	ASSERT(_scheduler);
+	_cycleMark = (uint32_t)_OS_cycleNow();
 	// This call never returns (and enables interrupts and resets the stack)
 	_task_init_switch(OS_idleTCB_p);
 }
@@ -82,6 +198,10 @@ void OS_initialiseTCB(OS_TCB_t * TCB, uint32_t * const stack, void (* const func
 	TCB->priority = priority;
 	TCB->state = TCB->data = 0;
 	TCB->ticks = OS_elapsedTicks();
+	TCB->schedNode.next = TCB->schedNode.prev = 0;
+	TCB->waitNode.next = TCB->waitNode.prev = 0;
+	TCB->notifyValue = TCB->notifyPending = 0;
+	TCB->cycles = 0;
 	OS_StackFrame_t *sf = (OS_StackFrame_t *)(TCB->sp);
 	memset(sf, 0, sizeof(OS_StackFrame_t));
 	/* By placing the address of the task function in pc, and the address of _OS_task_end() in lr, the task
@@ -108,29 +228,122 @@ void _OS_task_end(void) {
 void _svc_OS_enable_systick(void) {
 	if (_scheduler->preemptive) {
 		SystemCoreClockUpdate();
-		SysTick_Config(SystemCoreClock / 1000);
-		NVIC_SetPriority(SysTick_IRQn, 0x10);
+		SysTick_Config(SystemCoreClock / OS_TICK_HZ);
+		// SysTick_Config() sets its own priority, so this must come after it
+		NVIC_SetPriority(SysTick_IRQn, OS_KERNEL_PRIORITY);
 	}
 }
 
 /* SVC handler to add a task.  Invokes a callback to do the work. */
-void _svc_OS_addTask(_OS_SVC_StackFrame_t const * const stack) {
+void _svc_OS_addTask(_OS_SVC_StackFrame_t * const stack) {
 	/* The TCB pointer is on the stack in the r0 position, having been passed as an
 	   argument to the SVC pseudo-function.  SVC handlers are called with the stack
 	   pointer in r0 (see os_asm.s) so the stack can be interrogated to find the TCB
-	   pointer. */
-	_scheduler->addtask_callback((OS_TCB_t *)stack->r0);
+	   pointer.  The result goes back in the same slot, to be returned in r0. */
+	stack->r0 = _scheduler->addtask_callback((OS_TCB_t *)stack->r0);
+}
+
+/* Returns a task pool slot to the pool.  TCBs that didn't come from the pool are ignored. */
+static void _OS_taskPool_release(OS_TCB_t const * const tcb) {
+	if (tcb >= _taskPoolTCBs && tcb < _taskPoolTCBs + OS_TASK_POOL_SIZE) {
+		_taskPoolUsed &= ~(1UL << (tcb - _taskPoolTCBs));
+	}
+}
+
+/* SVC handler for OS_createTask().  Takes the lowest free slot in the task pool (the bitmap
+   makes this a single CLZ rather than a search), initialises it and adds it to the scheduler. */
+void _svc_OS_createTask(_OS_SVC_StackFrame_t * const stack) {
+	void (* const func)(void const * const) = (void (*)(void const * const))stack->r0;
+	void const * const data = (void const *)stack->r1;
+	uint32_t const stackSize = stack->r2;
+	uint32_t const priority = stack->r3;
+	uint32_t const freeSlots = ~_taskPoolUsed & ((OS_TASK_POOL_SIZE < 32) ? ((1UL << OS_TASK_POOL_SIZE) - 1) : 0xFFFFFFFFUL);
+	stack->r0 = 0;
+	if (stackSize > OS_TASK_POOL_STACK_SIZE || freeSlots == 0) {
+		return;
+	}
+	uint32_t const slot = 31 - __CLZ(freeSlots & -freeSlots);
+	OS_TCB_t * const tcb = &_taskPoolTCBs[slot];
+	OS_initialiseTCB(tcb, _taskPoolStacks[slot] + (OS_TASK_POOL_STACK_SIZE / sizeof(uint32_t)), func, data, priority);
+	if (_scheduler->addtask_callback(tcb)) {
+		_taskPoolUsed |= (1UL << slot);
+		stack->r0 = (uint32_t)tcb;
+	}
+}
+
+/* SVC handler for OS_deleteTask().  Removes the task from the scheduler and reclaims its
+   pool slot; if the task deleted itself, PendSV is queued to switch away from it. */
+void _svc_OS_deleteTask(_OS_SVC_StackFrame_t const * const stack) {
+	OS_TCB_t * const tcb = (OS_TCB_t *)stack->r0;
+	_scheduler->taskexit_callback(tcb);
+	_OS_taskPool_release(tcb);
+	if (tcb == _currentTCB) {
+		SCB->ICSR = SCB_ICSR_PENDSVSET_Msk;
+	}
+}
+
+/* Stack high-water marks.  See os.h for details. */
+uint32_t OS_stackHighWater(OS_TCB_t const * task) {
+#if OS_STACK_CHECK
+	if (task == OS_idleTCB_p) {
+		return OS_IDLE_STACK_SIZE - _stackUnused[0] * sizeof(uint32_t);
+	}
+	if (task >= _taskPoolTCBs && task < _taskPoolTCBs + OS_TASK_POOL_SIZE) {
+		return OS_TASK_POOL_STACK_SIZE - _stackUnused[task - _taskPoolTCBs + 1] * sizeof(uint32_t);
+	}
+#endif
+	return 0;
+}
+
+uint32_t OS_stackCheckHook(void) {
+#if OS_STACK_CHECK
+	uint32_t const index = _stackNext;
+	uint32_t const * const bottom = index ? _taskPoolStacks[index - 1] : _idleStack;
+	// Words above the old mark have been used already, so there's no need to look at them again
+	uint32_t unused = 0;
+	while (unused < _stackUnused[index] && bottom[unused] == OS_STACK_FILL) {
+		unused++;
+	}
+	_stackUnused[index] = unused;
+	_stackNext = (index == OS_TASK_POOL_SIZE) ? 0 : index + 1;
+#endif
+	return 0;
 }
 
 /* SVC handler to invoke the scheduler (via a callback) from PendSV */
 OS_TCB_t const * _OS_scheduler() {
-	return _scheduler->scheduler_callback();
+	// Charge the running task for the time since the last switch, so the scheduler sees it
+	uint32_t const now = (uint32_t)_OS_cycleNow();
+	_currentTCB->cycles += now - _cycleMark;
+	_cycleMark = now;
+#if OS_LATENCY_ENABLED
+	OS_TCB_t const * const next = _OS_latencySchedule(_scheduler->scheduler_callback);
+#else
+	OS_TCB_t const * const next = _scheduler->scheduler_callback();
+#endif
+	// Account for time spent in the idle task
+	if ((next == OS_idleTCB_p) != (_currentTCB == OS_idleTCB_p)) {
+		_OS_idleSwitch(next == OS_idleTCB_p);
+	}
+	return next;
+}
+
+/* Returns how many ticks from now the kernel next has something to do: wake a sleeping task
+   or expire a timer.  0xFFFFFFFF if nothing is scheduled. */
+uint32_t _OS_nextDeadline(void) {
+	uint32_t ticks = _scheduler->nextwake_callback ? _scheduler->nextwake_callback(_ticks) : 1;
+	uint32_t const timer = _OS_timerNextExpiry();
+	return timer < ticks ? timer : ticks;
 }
 
 /* SVC handler that's called by _OS_task_end when a task finishes.  Invokes the
    task end callback and then queues PendSV to call the scheduler. */
 void _svc_OS_task_exit(void) {
 	_scheduler->taskexit_callback(_currentTCB);
+	/* The context switch that follows will still write to this TCB and stack, but the slot
+	   can only be handed out again by another SVC call, and that can't happen until PendSV
+		 has switched away. */
+	_OS_taskPool_release(_currentTCB);
 	SCB->ICSR = SCB_ICSR_PENDSVSET_Msk;
 }
 
@@ -140,8 +353,27 @@ void _svc_OS_wait(_OS_SVC_StackFrame_t const * const stack, uint32_t checkCode){
 	_scheduler->wait_callback((void *)stack->r0, (uint32_t)stack->r1);
 }
 
+/* Wakes the tasks waiting on the given reason.  Bumping the check value first means that a task
+   which read the old value before deciding to wait will not go to sleep and miss this. */
+void _OS_notify(void * reason) {
+	mcheckValue++;
+	_scheduler->notify_callback(reason);
+}
+
+/* As _OS_notify(), but wakes at most one task.  Returns non-zero if a task was woken. */
+uint32_t _OS_notifyOne(void * reason) {
+	mcheckValue++;
+	return _scheduler->notifyone_callback(reason);
+}
+
+/* Blocks the current task on the given reason unconditionally.  Only for SVC handlers, which
+   have already decided atomically that the task must wait. */
+void _OS_wait(void * reason) {
+	_scheduler->wait_callback(reason, mcheckValue);
+}
+
 /*SVC Notify handler*/
 void _svc_OS_notify(_OS_SVC_StackFrame_t const * const stack){
-	_scheduler->notify_callback((void *)stack->r0);
+	_OS_notify((void *)stack->r0);
 
 }
@@ -15,20 +15,69 @@ enum OS_SVC_e {
 	OS_SVC_YIELD,
 	OS_SVC_SCHEDULE,
 	OS_SVC_WAIT,
-	OS_SVC_NOTIFY
-	
+	OS_SVC_NOTIFY,
+	OS_SVC_CREATE_TASK,
+	OS_SVC_DELETE_TASK,
+	OS_SVC_BATCH,
+	OS_SVC_TIMER_START,
+	OS_SVC_TIMER_STOP,
+	OS_SVC_TIMER_TAKE,
+	OS_SVC_NOW_US,
+	OS_SVC_COND_WAIT,
+	OS_SVC_COND_SIGNAL,
+	OS_SVC_HEAP_ALLOC,
+	OS_SVC_HEAP_FREE,
+	OS_SVC_HEAP_RESIZE,
+	OS_SVC_HEAP_STATS,
+	OS_SVC_TASK_NOTIFY,
+	OS_SVC_TASK_NOTIFY_TAKE,
+	OS_SVC_LATENCY_READ,
+	OS_SVC_IDLE_PREPARE,
+	OS_SVC_IDLE_STATS
 };
 
+/* SysTick frequency, and the length of a tick in microseconds */
+#define OS_TICK_HZ 1000
+#define OS_TICK_US (1000000 / OS_TICK_HZ)
+/* Value OS_elapsedTicks() starts from.  Set it a little below 0xFFFFFFFF to have code meet the
+   32-bit wrap within seconds rather than after 49 days. */
+#ifndef OS_INITIAL_TICKS
+#define OS_INITIAL_TICKS 0
+#endif
+
+/* Capacity of the pool that OS_createTask() draws TCBs and stacks from.  At most 32. */
+#define OS_TASK_POOL_SIZE 8
+/* Size in bytes of every stack in the task pool.  Must be a multiple of 8. */
+#define OS_TASK_POOL_STACK_SIZE 512
+
+/* If non-zero, OS_init() fills the idle stack and the task pool's stacks with OS_STACK_FILL and
+   registers OS_stackCheckHook(), which keeps a high-water mark for each of them. */
+#define OS_STACK_CHECK 1
+#define OS_STACK_FILL 0xA5A5A5A5UL
+
 /* A structure to hold callbacks for a scheduler, plus a 'preemptive' flag */
 typedef struct {
 	uint_fast8_t preemptive;
 	OS_TCB_t const * (* scheduler_callback)(void);
-	void (* addtask_callback)(OS_TCB_t * const newTask);
+	/* Returns non-zero if the task was added, or zero if the scheduler has no room for it */
+	uint32_t (* addtask_callback)(OS_TCB_t * const newTask);
 	void (* taskexit_callback)(OS_TCB_t * const task);
 	
 	/* Callback function pointers for wait and notify */
 	void (* wait_callback)(void* const reason,  uint32_t checkCode);
 	void (* notify_callback)(void* const reason);
+	/* Wakes only the first task waiting for the reason.  Returns non-zero if there was one. */
+	uint32_t (* notifyone_callback)(void* const reason);
+
+	/* Optional.  Called by SysTick with the new tick count; returns non-zero if the scheduler
+	   callback needs to run on this tick.  It must only read the scheduler's state, which belongs
+		 to PendSV; SysTick and PendSV share a priority (see critical.h), so it is never seen half
+		 changed.  If it is null, the scheduler runs on every tick. */
+	uint32_t (* tick_callback)(uint32_t now);
+	/* Optional.  Returns how many ticks after 'now' the first sleeping task is due to wake, or
+	   0xFFFFFFFF if none is sleeping.  Used by the idle task to decide how deeply to sleep; if
+		 it is null, the idle task assumes something may be due on the next tick. */
+	uint32_t (* nextwake_callback)(uint32_t now);
 } OS_Scheduler_t;
 
 /***************************/
@@ -48,6 +97,28 @@ OS_TCB_t * OS_currentTCB(void);
 /* Returns the number of elapsed systicks since the last reboot (modulo 2^32). */
 uint32_t OS_elapsedTicks(void);
 
+/* Returns the number of elapsed systicks since the last reboot, without wrapping. */
+uint64_t OS_elapsedTicks64(void);
+
+/* Returns the time since the last reboot in microseconds, from the tick count and the SysTick
+   counter.  Never wraps. */
+uint64_t __svc(OS_SVC_NOW_US) OS_nowUs(void);
+
+/* Returns non-zero if tick count 'a' is before tick count 'b'.  Correct across the wrap of
+   OS_elapsedTicks(), as long as the two are less than 2^31 ticks apart.  Deadlines held as
+	 32-bit tick counts must always be compared with this, never with < or >. */
+static inline uint32_t OS_tickBefore(uint32_t a, uint32_t b) {
+	return (int32_t)(a - b) < 0;
+}
+
+/* Returns how many core clock cycles a task has run for (modulo 2^32), including the current
+   run if it is the running task.  The cycle counter can only be read in handler mode, so this
+	 is for schedulers.  Time spent in interrupt handlers is charged to the task they interrupted. */
+uint32_t OS_taskCycles(OS_TCB_t const * task);
+
+/* Returns the number of core clock cycles in one tick.  Handler mode only. */
+uint32_t OS_tickCycles(void);
+
 /******************************************/
 /* Task creation and management functions */
 /******************************************/
@@ -65,8 +136,31 @@ uint32_t OS_elapsedTicks(void);
    The fourth argument is a void pointer to data that the task should receive. */
 void OS_initialiseTCB(OS_TCB_t * TCB, uint32_t * const stack, void (* const func)(void const * const), void const * const data, uint32_t priority);
 
-/* SVC delegate to add a task */
-void __svc(OS_SVC_ADD_TASK) OS_addTask(OS_TCB_t const * const);
+/* SVC delegate to add a task.  Returns non-zero on success, or zero if the scheduler is full. */
+uint32_t __svc(OS_SVC_ADD_TASK) OS_addTask(OS_TCB_t const * const);
+
+/* Creates a task using a TCB and stack taken from the task pool, and adds it to the scheduler.
+   The first two arguments are as for OS_initialiseTCB().  The third is the stack size the task
+	 needs in bytes, which must not exceed OS_TASK_POOL_STACK_SIZE (zero means "the pool default"),
+	 and the fourth is its priority.  Returns the new task's TCB, or zero if the pool is exhausted,
+	 the stack request is too large or the scheduler is full.  Runs in constant time.  When the task
+	 function returns, or the task is deleted, its TCB and stack go back to the pool. */
+OS_TCB_t * __svc(OS_SVC_CREATE_TASK) OS_createTask(void (* const func)(void const * const), void const * const data, uint32_t stackSize, uint32_t priority);
+
+/* Removes a task from the scheduler so that it will never run again.  If the task came from
+   OS_createTask(), its TCB and stack are returned to the pool.  A task may delete itself. */
+void __svc(OS_SVC_DELETE_TASK) OS_deleteTask(OS_TCB_t * const task);
+
+/* Returns the most stack in bytes that the idle task or a task from OS_createTask() has been
+   seen to use, or zero for any other task or if OS_STACK_CHECK is off.  A pool stack is only
+	 filled once, so its mark covers every task that has had the slot.  A mark equal to the stack
+	 size means the stack has probably overflowed.  Marks lag by up to one pass of the idle hook. */
+uint32_t OS_stackHighWater(OS_TCB_t const * task);
+
+/* Idle hook registered by OS_init() when OS_STACK_CHECK is set.  Each call scans one of the
+   checked stacks up from the bottom for the first word that isn't OS_STACK_FILL, stopping at
+	 its previous mark, so it never has more work to report. */
+uint32_t OS_stackCheckHook(void);
 
 /************************/
 /* Scheduling functions */
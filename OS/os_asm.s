@@ -18,6 +18,10 @@ debug2
 ; Import global variables
     IMPORT _currentTCB
     IMPORT _OS_scheduler
+    IMPORT _isrDrain
+    IMPORT _OS_latencyPendSV
+    IMPORT _OS_latencyResume
+    IMPORT _OS_idleTask
 
 ; Import SVC routines
     IMPORT _svc_OS_enable_systick
@@ -27,6 +31,24 @@ debug2
     IMPORT _svc_OS_schedule
 	IMPORT _svc_OS_wait
 	IMPORT _svc_OS_notify
+	IMPORT _svc_OS_createTask
+	IMPORT _svc_OS_deleteTask
+	IMPORT _svc_OS_batch
+	IMPORT _svc_OS_timerStart
+	IMPORT _svc_OS_timerStop
+	IMPORT _svc_OS_timerTake
+	IMPORT _svc_OS_nowUs
+	IMPORT _svc_OS_condWait
+	IMPORT _svc_OS_condSignal
+	IMPORT _svc_OS_heapAlloc
+	IMPORT _svc_OS_heapFree
+	IMPORT _svc_OS_heapResize
+	IMPORT _svc_OS_heapStats
+	IMPORT _svc_OS_taskNotify
+	IMPORT _svc_OS_taskNotifyTake
+	IMPORT _svc_OS_latencyRead
+	IMPORT _svc_OS_idlePrepare
+	IMPORT _svc_OS_idleStats
     
 SVC_Handler
     ; Link register contains special 'exit handler mode' code
@@ -58,11 +80,35 @@ SVC_tableStart
     DCD _svc_OS_schedule
 	DCD _svc_OS_wait
 	DCD _svc_OS_notify
+	DCD _svc_OS_createTask
+	DCD _svc_OS_deleteTask
+	DCD _svc_OS_batch
+	DCD _svc_OS_timerStart
+	DCD _svc_OS_timerStop
+	DCD _svc_OS_timerTake
+	DCD _svc_OS_nowUs
+	DCD _svc_OS_condWait
+	DCD _svc_OS_condSignal
+	DCD _svc_OS_heapAlloc
+	DCD _svc_OS_heapFree
+	DCD _svc_OS_heapResize
+	DCD _svc_OS_heapStats
+	DCD _svc_OS_taskNotify
+	DCD _svc_OS_taskNotifyTake
+	DCD _svc_OS_latencyRead
+	DCD _svc_OS_idlePrepare
+	DCD _svc_OS_idleStats
 SVC_tableEnd
 
     ALIGN
 PendSV_Handler
     STMFD   sp!, {r4, lr} ; r4 included for stack alignment
+    ; Note the entry time for the latency histograms (empty unless they are enabled)
+    LDR     r0, =_OS_latencyPendSV
+    BLX     r0
+    ; Carry out any kernel requests queued by interrupt handlers
+    LDR     r0, =_isrDrain
+    BLX     r0
     LDR     r0, =_OS_scheduler
     BLX     r0
     LDMFD   sp!, {r4, lr}
@@ -86,6 +132,12 @@ _task_switch
     MSR     PSP, r3
     ; Update _currentTCB
     STR     r0, [r2]
+    ; Note the switch time for the latency histograms.  r0-r3 and r12 are free (the new
+    ; task's values are on its stack), but lr holds the exception return code.
+    STMFD   sp!, {r4, lr}
+    LDR     r0, =_OS_latencyResume
+    BLX     r0
+    LDMFD   sp!, {r4, lr}
     ; Clear exclusive access flag
     CLREX
     BX      lr
@@ -117,12 +169,10 @@ _task_init_switch
     ; This SVC call should be handled by _svc_OS_schedule()
     ; It causes a switch to a runnable task, if possible
     SVC     0x04
-_idle_task
-    ; The following line is commented out because it doesn't play nicely with the debugger.
-    ; For deployment, uncomment this line and the CPU will sleep when idling, waking only to
-    ; handle interrupts.
-;   WFI
-    B       _idle_task
+    ; Continue as the idle task, on the idle stack.  Whether it sleeps is up to the power
+    ; policy (see idle.h); set OS_IDLE_SLEEP to 0 if WFI upsets the debugger.
+    LDR     r0, =_OS_idleTask
+    BX      r0
     
     ALIGN
     END
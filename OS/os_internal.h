@@ -27,6 +27,14 @@ void __svc(OS_SVC_EXIT) _OS_task_exit(void);
 
 /* C */
 void _OS_task_end(void);
+void _OS_notify(void * reason);
+uint32_t _OS_notifyOne(void * reason);
+void _OS_wait(void * reason);
+uint32_t _OS_nextDeadline(void);
+/* Core clock cycles since the OS started, from the tick count and SysTick's counter.  This
+   is the kernel's only clock: task run times, idle time, latency samples and OS_nowUs() all
+	 come from it.  Handler mode only. */
+uint64_t _OS_cycleNow(void);
 
 /* asm */
 void _task_switch(void);
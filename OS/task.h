@@ -3,6 +3,7 @@
 
 #include <stdint.h>
 #include <stddef.h>
+#include "list.h"
 
 /* Describes a single stack frame, as found at the top of the stack of a task
    that is not currently running.  Registers r0-r3, r12, lr, pc and psr are stacked
@@ -41,6 +42,19 @@ typedef struct {
 	uint32_t volatile priority;
 	uint32_t volatile data;
 	uint32_t volatile ticks;
+	/* Links the task into whichever of its scheduler's lists (ready, sleeping, waiting) it
+	   currently belongs to.  Owned by the scheduler. */
+	OS_listNode_t schedNode;
+	/* Links the task into a wait table bucket while it is the first task waiting for its
+	   reason (see waittable.h).  Owned by the scheduler. */
+	OS_listNode_t waitNode;
+	/* Direct-to-task notification value, and whether it has been updated since the task last
+	   took it (see tasknotify.h) */
+	uint32_t volatile notifyValue;
+	uint32_t volatile notifyPending;
+	/* Core clock cycles the task has run for (modulo 2^32).  The kernel adds the time since
+	   the last switch each time the scheduler is invoked (see OS_taskCycles()). */
+	uint32_t volatile cycles;
 } OS_TCB_t;
 
 /* Constants that define bits in a thread's 'state' field. */
@@ -0,0 +1,83 @@
+#include "tasknotify.h"
+#include "os_internal.h"
+#include "isr.h"
+
+/* A task waits for its own notifications with the address of its notification value as the
+   reason, so nothing else can ever be waiting for the same thing.  Both the update and the
+	 check-then-wait happen in SVC handlers, so a notification can't slip in between the check
+	 and the wait, and no check value is needed. */
+
+uint32_t _OS_taskNotify(OS_TCB_t * task, uint32_t value, uint32_t action) {
+	switch (action) {
+		case OS_NOTIFY_SET_BITS:
+			task->notifyValue |= value;
+			break;
+		case OS_NOTIFY_INCREMENT:
+			task->notifyValue++;
+			break;
+		case OS_NOTIFY_NO_OVERWRITE:
+			if (task->notifyPending) {
+				return 0;
+			}
+			// fall through
+		case OS_NOTIFY_OVERWRITE:
+			task->notifyValue = value;
+			break;
+		default:
+			return 0;
+	}
+	task->notifyPending = 1;
+	// Only the task itself waits on its notification value, so a task that isn't waiting at
+	// all can't be waiting for this, and the wait list needn't be searched
+	if (task->state & TASK_STATE_WAIT) {
+		_OS_notifyOne((void *) &task->notifyValue);
+	}
+	return 1;
+}
+
+/* SVC handler for OS_taskNotify() */
+void _svc_OS_taskNotify(_OS_SVC_StackFrame_t * const stack) {
+	stack->r0 = _OS_taskNotify((OS_TCB_t *) stack->r0, stack->r1, stack->r2);
+}
+
+/* SVC handler for _OS_taskNotifyTake() */
+void _svc_OS_taskNotifyTake(_OS_SVC_StackFrame_t * const stack) {
+	OS_TCB_t * const task = _currentTCB;
+	uint32_t const decrement = stack->r0;
+	// A counting take needs a non-zero count, whatever else has been done to the value
+	uint32_t const ready = decrement ? task->notifyValue != 0 : task->notifyPending;
+	if (!ready) {
+		stack->r0 = 0;
+		_OS_wait((void *) &task->notifyValue);
+		return;
+	}
+	*(uint32_t *) stack->r2 = task->notifyValue;
+	if (decrement) {
+		task->notifyValue--;
+		task->notifyPending = task->notifyValue != 0;
+	} else {
+		task->notifyValue &= ~stack->r1;
+		task->notifyPending = 0;
+	}
+	stack->r0 = 1;
+}
+
+uint32_t OS_taskNotifyWait(uint32_t clearMask) {
+	uint32_t value;
+	while (!_OS_taskNotifyTake(0, clearMask, &value));
+	return value;
+}
+
+uint32_t OS_taskNotifyTake(void) {
+	uint32_t value;
+	while (!_OS_taskNotifyTake(1, 0, &value));
+	return value;
+}
+
+uint32_t OS_taskNotifyFromISR(OS_TCB_t * task, uint32_t bits) {
+	return _isrPush(BATCH_TASK_NOTIFY_BITS, (void *) task, bits);
+}
+
+uint32_t OS_taskNotifyGiveFromISR(OS_TCB_t * task) {
+	return _isrPush(BATCH_TASK_NOTIFY_GIVE, (void *) task, 0);
+}
@@ -0,0 +1,48 @@
+#ifndef _TASKNOTIFY_H_
+#define _TASKNOTIFY_H_
+
+#include "os.h"
+#include "task.h"
+
+/* Direct-to-task notifications.  Every task has a notification value in its TCB, which other
+   tasks and interrupts can update, and which the task itself can wait on.  This needs no
+	 separate kernel object, and takes one kernel entry on each side, so it is a cheaper
+	 replacement for a semaphore, an event group or a one-word mailbox when there is exactly
+	 one receiver and the sender knows which task it is. */
+
+/* How OS_taskNotify() updates the notification value */
+typedef enum {
+	OS_NOTIFY_SET_BITS,       // value |= argument, like an event group
+	OS_NOTIFY_INCREMENT,      // value += 1, like a counting semaphore (the argument is ignored)
+	OS_NOTIFY_OVERWRITE,      // value = argument, like a one-word mailbox
+	OS_NOTIFY_NO_OVERWRITE    // value = argument, unless the task hasn't taken the last one yet
+} OS_notifyAction_e;
+
+/* Updates a task's notification value, and wakes the task if it is waiting for it.  Returns
+   zero (and changes nothing) if the action was OS_NOTIFY_NO_OVERWRITE and there was already
+	 a notification pending. */
+uint32_t __svc(OS_SVC_TASK_NOTIFY) OS_taskNotify(OS_TCB_t * task, uint32_t value, uint32_t action);
+
+/* Waits until the calling task has a notification pending, then returns the value and clears
+   the bits in 'clearMask' from it.  A mask of 0xFFFFFFFF resets the value to zero. */
+uint32_t OS_taskNotifyWait(uint32_t clearMask);
+
+/* Counting-semaphore style take: waits until the notification value is non-zero, then
+   returns it and decrements it by one. */
+uint32_t OS_taskNotifyTake(void);
+
+/* Interrupt-safe counterparts of OS_taskNotify() with OS_NOTIFY_SET_BITS and
+   OS_NOTIFY_INCREMENT, carried out when PendSV next runs.  Return zero if the request was
+	 dropped because the interrupt request queue was full. */
+uint32_t OS_taskNotifyFromISR(OS_TCB_t * task, uint32_t bits);
+uint32_t OS_taskNotifyGiveFromISR(OS_TCB_t * task);
+
+/* SVC delegate behind OS_taskNotifyWait() and OS_taskNotifyTake().  If a notification is
+   pending, stores the value in *value, consumes it and returns non-zero; otherwise blocks the
+	 caller until one arrives and returns zero. */
+uint32_t __svc(OS_SVC_TASK_NOTIFY_TAKE) _OS_taskNotifyTake(uint32_t decrement, uint32_t clearMask, uint32_t * value);
+
+/* Updates a task's notification value from handler mode */
+uint32_t _OS_taskNotify(OS_TCB_t * task, uint32_t value, uint32_t action);
+
+#endif /* _TASKNOTIFY_H_ */
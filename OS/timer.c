@@ -0,0 +1,218 @@
+#include "timer.h"
+#include "os_internal.h"
+#include "isr.h"
+
+/* This is an implementation of software timers, stored in a hierarchical timing wheel.
+
+   Level 0 of the wheel has one slot per tick for the current block of 2^TIMER_WHEEL_BITS
+	 ticks.  Each level above it has one slot per block of the level below, so a timer is
+	 placed in the lowest level whose current block contains its expiry time.  Starting or
+	 stopping a timer is therefore a constant-time list operation, and on each tick SysTick
+	 only looks at one level 0 slot.  When the wheel crosses into a new block at some level,
+	 the timers in that block's slot are cascaded down a level (each timer moves at most once
+	 per level).  Timers beyond the top level wait on an overflow list, which is re-sorted
+	 every time the top level wraps.
+
+	 Expired timers are put on a pending list and the timer service task is notified with
+	 OS_notifyFromISR().  The service task takes them off one at a time with an SVC call, which
+	 copies out the callback and its argument, and runs the callbacks in thread mode.  The wheel and the pending list are only changed by
+	 SysTick and by SVC handlers, which never run at the same time as each other. */
+
+#if (TIMER_WHEEL_BITS * TIMER_WHEEL_LEVELS) >= 32
+#error "The timing wheel must span less than 2^32 ticks"
+#endif
+
+#define TIMER_WHEEL_SLOTS (1UL << TIMER_WHEEL_BITS)
+#define TIMER_WHEEL_MASK (TIMER_WHEEL_SLOTS - 1)
+
+static OS_list_t _wheel[TIMER_WHEEL_LEVELS][TIMER_WHEEL_SLOTS];
+static OS_list_t _overflow;
+static OS_list_t _pending;
+static uint32_t _wheelReady = 0;
+/* The tick the wheel was last advanced to */
+static uint32_t _now = 0;
+
+#define TIMER_OF(n) OS_LIST_ENTRY(n, OS_timer_t, node)
+#define PENDING_TIMER_OF(n) OS_LIST_ENTRY(n, OS_timer_t, pendingNode)
+
+/* The wheel is made of list heads that must point to themselves, so it is set up on first use */
+static void timerWheelInit(void) {
+	for (uint32_t level = 0; level < TIMER_WHEEL_LEVELS; level++) {
+		for (uint32_t slot = 0; slot < TIMER_WHEEL_SLOTS; slot++) {
+			OS_listInit(&_wheel[level][slot]);
+		}
+	}
+	OS_listInit(&_overflow);
+	OS_listInit(&_pending);
+	_now = OS_elapsedTicks();
+	_wheelReady = 1;
+}
+
+/* Puts a timer into the slot for its expiry time */
+static void timerInsert(OS_timer_t * timer) {
+	for (uint32_t level = 0; level < TIMER_WHEEL_LEVELS; level++) {
+		uint32_t const blockShift = TIMER_WHEEL_BITS * (level + 1);
+		// Is the expiry time in the block that the wheel is currently in at this level?
+		if ((timer->expiry >> blockShift) == (_now >> blockShift)) {
+			OS_listPushBack(&_wheel[level][(timer->expiry >> (TIMER_WHEEL_BITS * level)) & TIMER_WHEEL_MASK], &timer->node);
+			return;
+		}
+	}
+	OS_listPushBack(&_overflow, &timer->node);
+}
+
+/* Re-inserts every timer in a slot, now that the wheel has moved on.  The slot is emptied
+   first, because a timer may go straight back into it (the overflow list, for example). */
+static void timerCascade(OS_list_t * slot) {
+	if (OS_listIsEmpty(slot)) {
+		return;
+	}
+	OS_list_t moving;
+	moving.next = slot->next;
+	moving.prev = slot->prev;
+	moving.next->prev = &moving;
+	moving.prev->next = &moving;
+	OS_listInit(slot);
+	while (!OS_listIsEmpty(&moving)) {
+		OS_timer_t * timer = TIMER_OF(moving.next);
+		OS_listRemove(&timer->node);
+		timerInsert(timer);
+	}
+}
+
+void OS_timerInit(OS_timer_t * timer, OS_timerCallback_t callback, void * arg) {
+	timer->node.next = timer->node.prev = 0;
+	timer->pendingNode.next = timer->pendingNode.prev = 0;
+	timer->expiry = timer->period = timer->pending = 0;
+	timer->callback = callback;
+	timer->arg = arg;
+}
+
+uint32_t OS_timerIsRunning(OS_timer_t const * timer) {
+	return OS_listIsLinked(&timer->node);
+}
+
+/* Takes a timer out of the wheel and forgets any unhandled expiries */
+static void timerCancel(OS_timer_t * timer) {
+	if (OS_listIsLinked(&timer->node)) {
+		OS_listRemove(&timer->node);
+	}
+	if (OS_listIsLinked(&timer->pendingNode)) {
+		OS_listRemove(&timer->pendingNode);
+	}
+	timer->pending = 0;
+}
+
+/* SVC handler for OS_timerStart() */
+void _svc_OS_timerStart(_OS_SVC_StackFrame_t const * const stack) {
+	OS_timer_t * timer = (OS_timer_t *)stack->r0;
+	uint32_t delay = stack->r1;
+	if (!_wheelReady) {
+		timerWheelInit();
+	}
+	timerCancel(timer);
+	timer->expiry = _now + (delay ? delay : 1);
+	timer->period = stack->r2;
+	timerInsert(timer);
+}
+
+/* SVC handler for OS_timerStop() */
+void _svc_OS_timerStop(_OS_SVC_StackFrame_t const * const stack) {
+	timerCancel((OS_timer_t *)stack->r0);
+}
+
+/* SVC handler for _OS_timerTake() */
+void _svc_OS_timerTake(_OS_SVC_StackFrame_t * const stack) {
+	stack->r0 = stack->r1 = 0;
+	if (_wheelReady && !OS_listIsEmpty(&_pending)) {
+		OS_timer_t * timer = PENDING_TIMER_OF(_pending.next);
+		if (--timer->pending == 0) {
+			OS_listRemove(&timer->pendingNode);
+		}
+		stack->r0 = (uint32_t)timer->callback;
+		stack->r1 = (uint32_t)timer->arg;
+	}
+}
+
+/* Advances the wheel by one tick.  Called from SysTick_Handler. */
+void _OS_timerTick(uint32_t now) {
+	if (!_wheelReady) {
+		return;
+	}
+	_now = now;
+	// Cascade from the top down, for every level whose block has just ended
+	if ((now & ((1UL << (TIMER_WHEEL_BITS * TIMER_WHEEL_LEVELS)) - 1)) == 0) {
+		timerCascade(&_overflow);
+	}
+	for (uint32_t level = TIMER_WHEEL_LEVELS - 1; level > 0; level--) {
+		uint32_t const shift = TIMER_WHEEL_BITS * level;
+		if ((now & ((1UL << shift) - 1)) == 0) {
+			timerCascade(&_wheel[level][(now >> shift) & TIMER_WHEEL_MASK]);
+		}
+	}
+	// Everything in this level 0 slot expires now
+	OS_list_t * slot = &_wheel[0][now & TIMER_WHEEL_MASK];
+	if (OS_listIsEmpty(slot)) {
+		return;
+	}
+	while (!OS_listIsEmpty(slot)) {
+		OS_timer_t * timer = TIMER_OF(slot->next);
+		OS_listRemove(&timer->node);
+		if (timer->pending++ == 0) {
+			OS_listPushBack(&_pending, &timer->pendingNode);
+		}
+		if (timer->period) {
+			timer->expiry += timer->period;
+			timerInsert(timer);
+		}
+	}
+	OS_notifyFromISR((void *)&_pending);
+}
+
+uint32_t _OS_timerNextExpiry(void) {
+	if (!_wheelReady) {
+		return 0xFFFFFFFF;
+	}
+	if (!OS_listIsEmpty(&_pending)) {
+		return 0;
+	}
+	// The rest of the current level 0 block is exact
+	uint32_t tick = _now + 1;
+	for (; tick & TIMER_WHEEL_MASK; tick++) {
+		if (!OS_listIsEmpty(&_wheel[0][tick & TIMER_WHEEL_MASK])) {
+			return tick - _now;
+		}
+	}
+	// Beyond that, timers only come into level 0 when their block is cascaded into it, so
+	// the end of this block is the soonest anything else can expire
+	if (!OS_listIsEmpty(&_overflow)) {
+		return tick - _now;
+	}
+	for (uint32_t level = 1; level < TIMER_WHEEL_LEVELS; level++) {
+		for (uint32_t slot = 0; slot < TIMER_WHEEL_SLOTS; slot++) {
+			if (!OS_listIsEmpty(&_wheel[level][slot])) {
+				return tick - _now;
+			}
+		}
+	}
+	return 0xFFFFFFFF;
+}
+
+/* The timer service task: runs the callbacks of expired timers */
+static void _OS_timerServiceTask(void const * const args) {
+	while (1) {
+		// Take the check value first, so an expiry between the take and the wait isn't missed
+		uint32_t checkValue = currentCheckValue();
+		// Never touch the timer itself here: its owner may stop it and reuse it at any time
+		_OS_timerExpiry_t const expiry = _OS_timerTake();
+		if (!expiry.callback) {
+			OS_wait((void *)&_pending, checkValue);
+			continue;
+		}
+		expiry.callback(expiry.arg);
+	}
+}
+
+OS_TCB_t * OS_timerServiceStart(uint32_t priority) {
+	return OS_createTask(_OS_timerServiceTask, 0, 0, priority);
+}
@@ -0,0 +1,67 @@
+#ifndef _TIMER_H_
+#define _TIMER_H_
+
+#include "os.h"
+#include "list.h"
+
+/* The timing wheel has TIMER_WHEEL_LEVELS levels of 2^TIMER_WHEEL_BITS slots.  Timers due
+   within 2^(TIMER_WHEEL_BITS * TIMER_WHEEL_LEVELS) ticks are started and stopped in
+	 constant time; later ones wait on an overflow list until they come within range. */
+#define TIMER_WHEEL_BITS 5
+#define TIMER_WHEEL_LEVELS 4
+
+typedef void (* OS_timerCallback_t)(void * arg);
+
+typedef struct {
+	/* Links the timer into a wheel slot while it is running */
+	OS_listNode_t node;
+	/* Links the timer into the list of expired timers waiting for the timer service task */
+	OS_listNode_t pendingNode;
+	uint32_t expiry;
+	uint32_t period;
+	/* Number of expiries the timer service task has still to handle */
+	uint32_t pending;
+	OS_timerCallback_t callback;
+	void * arg;
+} OS_timer_t;
+
+/* Initialises a timer.  When it expires, callback(arg) is called from the timer service task. */
+void OS_timerInit(OS_timer_t * timer, OS_timerCallback_t callback, void * arg);
+
+/* Starts (or restarts) a timer so that it expires 'delay' ticks from now (a delay of zero is
+   treated as one).  If 'period' is non-zero the timer then expires every 'period' ticks
+	 until it is stopped; otherwise it is a one-shot timer.  Constant time. */
+void __svc(OS_SVC_TIMER_START) OS_timerStart(OS_timer_t * timer, uint32_t delay, uint32_t period);
+
+/* Stops a timer, and cancels any expiries whose callbacks haven't run yet.  Constant time. */
+void __svc(OS_SVC_TIMER_STOP) OS_timerStop(OS_timer_t * timer);
+
+/* Returns non-zero if the timer is running */
+uint32_t OS_timerIsRunning(OS_timer_t const * timer);
+
+/* Creates the timer service task, which runs all timer callbacks, from the task pool (see
+   OS_createTask()).  Callbacks run on its stack, one at a time, so they must be short and must
+	 not block for long.  Returns the task's TCB, or zero if it couldn't be created. */
+OS_TCB_t * OS_timerServiceStart(uint32_t priority);
+
+/* An expiry taken by the timer service task.  The callback and its argument are copied out in
+   the SVC handler, because once the SVC returns the timer may be stopped and its memory reused
+	 (pool_allocate_wait() keeps one on its stack, say). */
+typedef struct {
+	OS_timerCallback_t callback;
+	void * arg;
+} _OS_timerExpiry_t;
+
+/* SVC delegate for the timer service task: returns an expired timer's callback and argument,
+   or a null callback if there are none.  Returned in r0 and r1. */
+__value_in_regs _OS_timerExpiry_t __svc(OS_SVC_TIMER_TAKE) _OS_timerTake(void);
+
+/* Called by SysTick_Handler on every tick */
+void _OS_timerTick(uint32_t now);
+
+/* Returns a lower bound on the number of ticks until the next timer expires (zero if expired
+   timers are still waiting for the service task), or 0xFFFFFFFF if no timer is running.
+	 Looks at no more than the rest of the current level 0 block.  Handler mode only. */
+uint32_t _OS_timerNextExpiry(void);
+
+#endif /* _TIMER_H_ */
@@ -0,0 +1,72 @@
+#include "waittable.h"
+
+#define TASK_OF(node) OS_LIST_ENTRY(node, OS_TCB_t, schedNode)
+#define HEAD_OF(node) OS_LIST_ENTRY(node, OS_TCB_t, waitNode)
+
+/* Returns the bucket for a reason.  Reasons are addresses, so a multiplicative hash spreads
+   neighbouring objects over the table. */
+static OS_list_t * waitBucket(OS_waitTable_t * table, uint32_t reason) {
+	OS_list_t * const bucket = &table->buckets[(uint32_t)(reason * 2654435761U) >> (32 - OS_WAIT_TABLE_BITS)];
+	if (!OS_listIsLinked(bucket)) {
+		OS_listInit(bucket);
+	}
+	return bucket;
+}
+
+/* Returns the first task waiting for a reason, or zero */
+static OS_TCB_t * waitHead(OS_list_t const * bucket, uint32_t reason) {
+	for (OS_listNode_t *node = bucket->next; node != bucket; node = node->next) {
+		if (HEAD_OF(node)->data == reason) {
+			return HEAD_OF(node);
+		}
+	}
+	return 0;
+}
+
+void OS_waitTableInsert(OS_waitTable_t * table, OS_TCB_t * task, uint32_t byPriority) {
+	OS_list_t * const bucket = waitBucket(table, task->data);
+	OS_TCB_t * const head = waitHead(bucket, task->data);
+	if (!head) {
+		// First waiter: a ring of one
+		OS_listPushBack(bucket, &task->waitNode);
+		task->schedNode.next = task->schedNode.prev = &task->schedNode;
+		return;
+	}
+	OS_listNode_t *position = &head->schedNode;
+	if (byPriority) {
+		if (task->priority > head->priority) {
+			// Goes in front of the head, and takes its place in the bucket
+			OS_listInsertBefore(&head->schedNode, &task->schedNode);
+			OS_listInsertBefore(&head->waitNode, &task->waitNode);
+			OS_listRemove(&head->waitNode);
+			return;
+		}
+		// Behind every waiter of the same or higher priority
+		position = head->schedNode.next;
+		while (position != &head->schedNode && TASK_OF(position)->priority >= task->priority) {
+			position = position->next;
+		}
+	}
+	// Inserting before the head puts it at the end of the ring
+	OS_listInsertBefore(position, &task->schedNode);
+}
+
+void OS_waitTableRemove(OS_waitTable_t * table, OS_TCB_t * task) {
+	(void) table;
+	if (OS_listIsLinked(&task->waitNode)) {
+		// The next waiter, if any, becomes the head
+		if (task->schedNode.next != &task->schedNode) {
+			OS_listInsertBefore(&task->waitNode, &TASK_OF(task->schedNode.next)->waitNode);
+		}
+		OS_listRemove(&task->waitNode);
+	}
+	OS_listRemove(&task->schedNode);
+}
+
+OS_TCB_t * OS_waitTableTake(OS_waitTable_t * table, void const * reason) {
+	OS_TCB_t * const head = waitHead(waitBucket(table, (uint32_t) reason), (uint32_t) reason);
+	if (head) {
+		OS_waitTableRemove(table, head);
+	}
+	return head;
+}
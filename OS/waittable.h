@@ -0,0 +1,35 @@
+#ifndef _WAITTABLE_H_
+#define _WAITTABLE_H_
+
+#include "task.h"
+
+/* Wait table for schedulers: the tasks waiting in wait_callback, indexed by their reason.
+
+   The reasons in use are hashed into buckets.  Only the first task waiting for a reason is
+	 linked into its bucket (through its waitNode); the others are on a ring through their
+	 schedNodes behind it, in the order they are to be woken.  Finding the waiters for a reason
+	 therefore only looks at the other reasons in the same bucket, and never at the tasks
+	 waiting for them, so notifying costs the same however many tasks are waiting.  A waiting
+	 task's 'data' field holds its reason. */
+
+/* log2 of the number of buckets */
+#define OS_WAIT_TABLE_BITS 5
+
+typedef struct {
+	OS_list_t buckets[1 << OS_WAIT_TABLE_BITS];
+} OS_waitTable_t;
+
+/* Static initialiser for an empty table (the buckets are set up when first used) */
+#define OS_WAIT_TABLE_INIT { { { 0, 0 } } }
+
+/* Adds a task to the waiters for the reason in its 'data' field.  If 'byPriority' is non-zero,
+   it is woken before any waiter of lower priority, and otherwise after all the others. */
+void OS_waitTableInsert(OS_waitTable_t * table, OS_TCB_t * task, uint32_t byPriority);
+
+/* Removes a task from the table, e.g. when it exits while waiting */
+void OS_waitTableRemove(OS_waitTable_t * table, OS_TCB_t * task);
+
+/* Removes and returns the first task waiting for 'reason', or zero if there isn't one */
+OS_TCB_t * OS_waitTableTake(OS_waitTable_t * table, void const * reason);
+
+#endif /* _WAITTABLE_H_ */
@@ -0,0 +1,134 @@
+#include "batch.h"
+#include "os_internal.h"
+#include "semaphore.h"
+#include "queue.h"
+#include "tasknotify.h"
+#include <string.h>
+
+/* This is an implementation of batched kernel calls.
+
+	 Fan-out heavy code (notifying several reasons, releasing several semaphores, posting to
+	 several queues) would otherwise take one SVC exception per operation, and several per
+	 queueSend().  Instead, an array of operations is handed to the kernel in one SVC and
+	 carried out there, followed by one request for the scheduler.
+
+	 Code in handler mode can't take a mutex, so an operation is only carried out in the
+	 kernel when the mutexes that protect its object are free.  Since no task can run while
+	 the SVC handler does, a free mutex means that no task is part way through changing the
+	 object.  Otherwise the kernel stops, and batchSubmit() falls back to the ordinary call
+	 for that operation. */
+
+/* Releases permits to a semaphore from handler mode */
+static batchResult_e batchSemaphoreRelease(semaphore_t * semaphore, uint32_t permits) {
+	if (semaphore->mutex.task) {
+		return BATCH_BUSY;
+	}
+	semaphore->permits += permits;
+	_condSignal(&semaphore->available, 1);
+	if (semaphore->set) {
+		_OS_notify((void *) semaphore->set);
+	}
+	return BATCH_DONE;
+}
+
+/* Copies an element to a queue from handler mode, if there is space for it */
+static batchResult_e batchQueueSend(queue_t * queue, uint32_t const * item) {
+	// The element is carried in the operation's value
+	if (queue->itemSize > sizeof(*item)) {
+		return BATCH_INVALID;
+	}
+	if (queue->mutex.task) {
+		return BATCH_BUSY;
+	}
+	if (queue->count == queue->capacity) {
+		return BATCH_FULL;
+	}
+	memcpy(queue->buffer + queue->insert * queue->itemSize, item, queue->itemSize);
+	queue->insert = (queue->insert + 1) % queue->capacity;
+	queue->count++;
+	_condSignal(&queue->notEmpty, 0);
+	if (queue->set) {
+		_OS_notify((void *) queue->set);
+	}
+	return BATCH_DONE;
+}
+
+batchResult_e _batchExecute(batchOp_t const * op) {
+	switch (op->op) {
+		case BATCH_NOTIFY:
+			_OS_notify(op->object);
+			return BATCH_DONE;
+		case BATCH_SEMAPHORE_RELEASE:
+			return batchSemaphoreRelease((semaphore_t *) op->object, op->value);
+		case BATCH_QUEUE_SEND:
+			return batchQueueSend((queue_t *) op->object, &op->value);
+		case BATCH_TASK_NOTIFY_BITS:
+			_OS_taskNotify((OS_TCB_t *) op->object, op->value, OS_NOTIFY_SET_BITS);
+			return BATCH_DONE;
+		case BATCH_TASK_NOTIFY_GIVE:
+			_OS_taskNotify((OS_TCB_t *) op->object, 0, OS_NOTIFY_INCREMENT);
+			return BATCH_DONE;
+		default:
+			// Unknown operations are skipped
+			return BATCH_DONE;
+	}
+}
+
+/* SVC handler for _OS_batch() */
+void _svc_OS_batch(_OS_SVC_StackFrame_t * const stack) {
+	batchOp_t const * const ops = (batchOp_t const *) stack->r0;
+	uint32_t const count = stack->r1;
+	uint32_t done = 0;
+	while (done < count) {
+		batchResult_e const result = _batchExecute(&ops[done]);
+		if (result != BATCH_DONE && result != BATCH_INVALID) {
+			break;
+		}
+		done++;
+	}
+	// One scheduling decision for everything that was woken
+	if (done) {
+		SCB->ICSR = SCB_ICSR_PENDSVSET_Msk;
+	}
+	stack->r0 = done;
+}
+
+/* Carries out an operation with its normal, possibly blocking, call */
+static void batchBlocking(batchOp_t const * op) {
+	switch (op->op) {
+		case BATCH_NOTIFY:
+			OS_notify(op->object);
+			break;
+		case BATCH_SEMAPHORE_RELEASE:
+			semaphoreRelease((semaphore_t *) op->object, op->value);
+			break;
+		case BATCH_QUEUE_SEND:
+			if (((queue_t *) op->object)->itemSize <= sizeof(op->value)) {
+				queueSend((queue_t *) op->object, &op->value);
+			}
+			break;
+		case BATCH_TASK_NOTIFY_BITS:
+			OS_taskNotify((OS_TCB_t *) op->object, op->value, OS_NOTIFY_SET_BITS);
+			break;
+		case BATCH_TASK_NOTIFY_GIVE:
+			OS_taskNotify((OS_TCB_t *) op->object, 0, OS_NOTIFY_INCREMENT);
+			break;
+		default:
+			break;
+	}
+}
+
+/* Submit a batch of operations */
+void batchSubmit(batchOp_t const * ops, uint32_t count) {
+	while (count) {
+		uint32_t done = _OS_batch(ops, count);
+		ops += done;
+		count -= done;
+		if (count) {
+			// The next operation would block, so do it the slow way and carry on
+			batchBlocking(ops);
+			ops++;
+			count--;
+		}
+	}
+}
@@ -0,0 +1,46 @@
+#ifndef BATCH_H
+#define BATCH_H
+
+#include <stdint.h>
+#include "os.h"
+
+/* Kinds of operation that can be submitted in a batch */
+typedef enum {
+	BATCH_NOTIFY,              // OS_notify(object)
+	BATCH_SEMAPHORE_RELEASE,   // semaphoreRelease(object, value)
+	BATCH_QUEUE_SEND,          // queueSend(object, &value), for queues of elements of at most 4 bytes
+	                           // (skipped for any other queue)
+	BATCH_TASK_NOTIFY_BITS,    // OS_taskNotify(object, value, OS_NOTIFY_SET_BITS)
+	BATCH_TASK_NOTIFY_GIVE     // OS_taskNotify(object, 0, OS_NOTIFY_INCREMENT)
+} batchOp_e;
+
+/* One operation in a batch */
+typedef struct {
+	uint32_t op;
+	void * object;
+	uint32_t value;
+} batchOp_t;
+
+/* Carries out 'count' operations, in order, as if each had been called individually, but
+   with a single kernel entry and a single scheduling decision for the whole batch.  If an
+	 operation can't be completed without blocking (its object is locked by another task, or
+	 the queue is full), that one operation is carried out by its normal blocking call and the
+	 remainder of the batch is resubmitted. */
+void batchSubmit(batchOp_t const * ops, uint32_t count);
+
+/* SVC delegate behind batchSubmit().  Carries out operations until one would block, and
+   returns how many were completed. */
+uint32_t __svc(OS_SVC_BATCH) _OS_batch(batchOp_t const * ops, uint32_t count);
+
+/* Results of carrying out an operation in handler mode */
+typedef enum {
+	BATCH_DONE = 0,
+	BATCH_BUSY,     // the object is locked by a task; nothing was changed
+	BATCH_FULL,     // the queue has no space; nothing was changed
+	BATCH_INVALID   // the operation can't be applied to its object; it is skipped
+} batchResult_e;
+
+/* Carries out one operation from handler mode, without blocking */
+batchResult_e _batchExecute(batchOp_t const * op);
+
+#endif /* BATCH_H */
@@ -0,0 +1,74 @@
+#include "cond.h"
+#include "os_internal.h"
+
+/* This is an implementation of Condition Variables.
+
+	 Waiting is done by an SVC handler, which releases the
+	 mutex, wakes anything waiting for it and blocks the
+	 caller on the condition variable.  No task can run in
+	 between, so there is no window in which a signal could
+	 be lost, and no check value is needed.
+
+	 The number of waiting tasks is kept in the condition
+	 variable.  It only changes in the kernel, and a task
+	 that holds the mutex knows nobody can start waiting, so
+	 signalling with nobody waiting costs nothing. */
+
+/* Initialise the Condition Variable */
+void condInit(OS_cond_t *cond) {
+	cond->waiting = 0;
+}
+
+/* Wait on the Condition Variable */
+void condWait(OS_cond_t *cond, OS_mutex_t *mutex) {
+#if LOCKSTAT_ENABLED
+	// The kernel lets go of the mutex, so the hold ends here
+	if (mutex->task == OS_currentTCB()) {
+		lockstatReleased(&mutex->stats);
+	}
+#endif
+	uint32_t counter = _OS_condWait(cond, mutex);
+	mutexAquire(mutex);
+	mutex->counter = counter;
+}
+
+void condSignal(OS_cond_t *cond) {
+	if (cond->waiting) {
+		_OS_condSignal(cond, 0);
+	}
+}
+
+void condBroadcast(OS_cond_t *cond) {
+	if (cond->waiting) {
+		_OS_condSignal(cond, 1);
+	}
+}
+
+/* SVC handler for _OS_condWait().  Returns how many times the task held the mutex, which it
+   must hold: waiting without it can't be made atomic with the check of the condition. */
+void _svc_OS_condWait(_OS_SVC_StackFrame_t * const stack) {
+	OS_cond_t * const cond = (OS_cond_t *) stack->r0;
+	OS_mutex_t * const mutex = (OS_mutex_t *) stack->r1;
+	ASSERT(mutex->task == _currentTCB);
+	stack->r0 = mutex->counter;
+	mutex->counter = 0;
+	mutex->task = 0;
+	_OS_notify((void *) mutex);
+	cond->waiting++;
+	_OS_wait((void *) cond);
+}
+
+void _condSignal(OS_cond_t *cond, uint32_t all) {
+	if (all) {
+		cond->waiting = 0;
+		_OS_notify((void *) cond);
+	} else if (cond->waiting) {
+		// If nobody was found (a waiting task was deleted), the count was stale
+		cond->waiting = _OS_notifyOne((void *) cond) ? cond->waiting - 1 : 0;
+	}
+}
+
+/* SVC handler for _OS_condSignal() */
+void _svc_OS_condSignal(_OS_SVC_StackFrame_t const * const stack) {
+	_condSignal((OS_cond_t *) stack->r0, stack->r1);
+}
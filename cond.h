@@ -0,0 +1,32 @@
+#ifndef COND_H
+#define COND_H
+
+#include <stdint.h>
+#include "mutex.h"
+#include "os.h"
+
+/* A condition variable, used with an OS_mutex_t to wait until some condition on the data
+   that the mutex protects becomes true. */
+typedef struct {
+	uint32_t volatile waiting;   // number of tasks waiting on it
+} OS_cond_t;
+
+void condInit(OS_cond_t *cond);
+/* Releases the mutex, however many times the calling task holds it, and waits on the
+   condition variable, as one kernel operation, so a signal can't be missed in between.  The
+	 mutex is held again (the same number of times) when this returns.  The condition should
+	 still be checked in a loop, because another task may have changed it first. */
+void condWait(OS_cond_t *cond, OS_mutex_t *mutex);
+/* Wakes the task that has been waiting longest, or all of the waiting tasks.  If the caller
+   holds the mutex, these don't enter the kernel at all when nothing is waiting. */
+void condSignal(OS_cond_t *cond);
+void condBroadcast(OS_cond_t *cond);
+
+/* SVC delegates behind condWait() and condSignal()/condBroadcast() */
+uint32_t __svc(OS_SVC_COND_WAIT) _OS_condWait(OS_cond_t *cond, OS_mutex_t *mutex);
+void __svc(OS_SVC_COND_SIGNAL) _OS_condSignal(OS_cond_t *cond, uint32_t all);
+
+/* Signals a condition variable from handler mode */
+void _condSignal(OS_cond_t *cond, uint32_t all);
+
+#endif /* COND_H */
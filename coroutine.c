@@ -0,0 +1,102 @@
+#include "coroutine.h"
+
+/* This is an implementation of Stackless Coroutines.
+
+	 Each coroutine keeps only the line number it stopped
+	 at, and resumes by switching on it, so a switch costs
+	 one function call and one jump, and nothing is saved
+	 but the coroutine's own state.
+
+	 The host calls every coroutine that might be able to
+	 carry on, in turn.  Sleeping ones are skipped until
+	 they are due.  When a whole pass has nobody ready, the
+	 host waits on its queue set, which every added queue
+	 and semaphore notifies, with a timer set to notify it
+	 too when the first sleeper is due.  The check value is
+	 taken before the pass, so nothing that happens during
+	 the pass is missed. */
+
+/* Timer callback: wakes the host */
+static void coroutineHostWake(void * arg) {
+	OS_notify(arg);
+}
+
+void coroutineHostInit(coroutineHost_t * host) {
+	host->list = 0;
+	queueSetInit(&host->set);
+	OS_timerInit(&host->timer, coroutineHostWake, &host->set);
+}
+
+uint32_t coroutineHostAddQueue(coroutineHost_t * host, queue_t * queue) {
+	return queueSetAddQueue(&host->set, queue);
+}
+
+uint32_t coroutineHostAddSemaphore(coroutineHost_t * host, semaphore_t * semaphore) {
+	return queueSetAddSemaphore(&host->set, semaphore);
+}
+
+void coroutineStart(coroutineHost_t * host, coroutine_t * co, coroutineFunc_t func, void * arg) {
+	co->line = 0;
+	co->wait = CO_WAIT_POLL;
+	co->func = func;
+	co->arg = arg;
+	co->next = host->list;
+	host->list = co;
+}
+
+void coroutineHostRun(coroutineHost_t * host) {
+	while (host->list) {
+		uint32_t checkValue = currentCheckValue();
+		uint32_t const now = OS_elapsedTicks();
+		uint32_t ready = 0, polling = 0, sleeping = 0;
+		uint32_t wake = 0;
+		coroutine_t * const first = host->list;
+		coroutine_t ** link = &host->list;
+		while (*link) {
+			coroutine_t * co = *link;
+			if (co->wait != CO_WAIT_SLEEP || !OS_tickBefore(now, co->wake)) {
+				coroutineResult_e result = co->func(co);
+				if (result == CO_DONE) {
+					*link = co->next;
+					co->next = 0;
+					ready = 1;
+					continue;
+				}
+				if (result == CO_READY) {
+					ready = 1;
+				} else if (co->wait == CO_WAIT_POLL) {
+					polling = 1;
+				}
+			}
+			if (co->wait == CO_WAIT_SLEEP && (!sleeping || OS_tickBefore(co->wake, wake))) {
+				sleeping = 1;
+				wake = co->wake;
+			}
+			link = &co->next;
+		}
+		// Coroutines started during the pass are added at the head, and haven't run yet
+		if (ready || !host->list || host->list != first) {
+			continue;
+		}
+		// Everybody is waiting.  Arrange to be woken for the first sleeper, or the next tick if
+		// something is being polled, and wait for that or for an added queue or semaphore.
+		if (polling || sleeping) {
+			uint32_t const later = OS_elapsedTicks();
+			uint32_t delay = 1;
+			if (!polling) {
+				if (!OS_tickBefore(later, wake)) {
+					// The tick moved on during the pass, and the sleeper is already due
+					continue;
+				}
+				delay = wake - later;
+			}
+			OS_timerStart(&host->timer, delay, 0);
+		}
+		OS_wait((void *) &host->set, checkValue);
+	}
+	OS_timerStop(&host->timer);
+}
+
+void coroutineHostTask(void const * const args) {
+	coroutineHostRun((coroutineHost_t *) args);
+}
@@ -0,0 +1,114 @@
+#ifndef COROUTINE_H
+#define COROUTINE_H
+
+#include <stdint.h>
+#include "os.h"
+#include "timer.h"
+#include "queue.h"
+#include "semaphore.h"
+#include "queueset.h"
+
+/* Stackless coroutines.  Any number of coroutines run inside one host task, on its stack,
+   so each costs only its coroutine_t (24 bytes) instead of a stack and a TCB.
+
+	 A coroutine is a function that takes its coroutine_t, and whose body is wrapped in
+	 CO_BEGIN() and CO_END().  It runs until it reaches one of the CO_ macros below that has
+	 to wait, and then returns to the host; next time the host calls it, it carries on from
+	 that point.  Because the function really does return, local variables don't keep their
+	 values across a wait: keep state in a structure that embeds the coroutine_t, or behind
+	 'arg'.  A coroutine must not call blocking functions (queueReceive(), OS_sleep() and so
+	 on), since they would block every other coroutine in the host as well; it can't use
+	 'switch' around a CO_ macro, and there can be only one CO_ macro per source line.
+
+	 Example:
+
+		 static coroutineResult_e blink(coroutine_t *co) {
+			 CO_BEGIN(co);
+			 while (1) {
+				 ledToggle();
+				 CO_SLEEP(co, 500);
+			 }
+			 CO_END(co);
+		 }
+*/
+
+/* What a coroutine function returns to its host */
+typedef enum {
+	CO_DONE,       // the coroutine has finished, and is removed from its host
+	CO_READY,      // the coroutine yielded, and can run again straight away
+	CO_WAITING     // the coroutine is waiting; see coroutine_t.wait
+} coroutineResult_e;
+
+/* What a waiting coroutine is waiting for, which tells the host when to run it again */
+typedef enum {
+	CO_WAIT_EVENT,    // a queue or semaphore that has been added to the host
+	CO_WAIT_SLEEP,    // the tick in 'wake'
+	CO_WAIT_POLL      // anything else: checked on every tick
+} coroutineWait_e;
+
+typedef struct s_coroutine coroutine_t;
+typedef coroutineResult_e (* coroutineFunc_t)(coroutine_t * co);
+
+struct s_coroutine {
+	uint32_t line;            // where to carry on from; zero to start at the beginning
+	uint32_t wait;            // coroutineWait_e, while waiting
+	uint32_t wake;            // tick to wake at, while sleeping
+	coroutineFunc_t func;
+	void * arg;
+	coroutine_t * next;       // next coroutine in the host
+};
+
+/* A host runs coroutines in a task.  It blocks its task when every coroutine is waiting,
+   and is woken by any queue or semaphore that has been added to it, or by a one-shot timer
+	 when the first sleeping coroutine is due, so nothing is polled unless a coroutine uses
+	 CO_AWAIT().  The timer needs the timer service task (see OS_timerServiceStart()). */
+typedef struct {
+	coroutine_t * list;
+	queueSet_t set;
+	OS_timer_t timer;
+} coroutineHost_t;
+
+void coroutineHostInit(coroutineHost_t * host);
+/* Adds a queue or semaphore that the host's coroutines receive from or acquire, so that the
+   host is woken when it gains an element or permit.  It becomes a member of the host's queue
+	 set, so the same limits apply (see queueset.h).  Returns zero on failure. */
+uint32_t coroutineHostAddQueue(coroutineHost_t * host, queue_t * queue);
+uint32_t coroutineHostAddSemaphore(coroutineHost_t * host, semaphore_t * semaphore);
+/* Adds a coroutine to a host.  It first runs on the host's next pass.  Call this from the
+   host's own task (for example, from another coroutine), or before the host task starts. */
+void coroutineStart(coroutineHost_t * host, coroutine_t * co, coroutineFunc_t func, void * arg);
+/* Runs the host's coroutines in the calling task, and returns once all of them have finished */
+void coroutineHostRun(coroutineHost_t * host);
+/* Task function that runs the host passed as its argument */
+void coroutineHostTask(void const * const args);
+
+/* Coroutine body */
+#define CO_BEGIN(co) switch ((co)->line) { case 0:
+#define CO_END(co) } (co)->line = 0; return CO_DONE
+
+/* Lets the host's other coroutines run, then carries on */
+#define CO_YIELD(co) do { (co)->line = __LINE__; return CO_READY; case __LINE__:; } while (0)
+
+/* Waits until 'condition' is true.  The condition is evaluated again each time the host
+   wakes, with the given kind of wait deciding when that is. */
+#define CO_WAIT_UNTIL(co, kind, condition) do { \
+		(co)->line = __LINE__; case __LINE__: \
+		if (!(condition)) { (co)->wait = (kind); return CO_WAITING; } \
+	} while (0)
+
+/* Waits until an arbitrary condition is true, checking it every tick */
+#define CO_AWAIT(co, condition) CO_WAIT_UNTIL(co, CO_WAIT_POLL, condition)
+/* Receives an element from a queue that has been added to the host */
+#define CO_RECEIVE(co, queue, item) CO_WAIT_UNTIL(co, CO_WAIT_EVENT, queueTryReceive((queue), (item)))
+/* Takes permits from a semaphore that has been added to the host */
+#define CO_ACQUIRE(co, semaphore, permits) CO_WAIT_UNTIL(co, CO_WAIT_EVENT, semaphoreTryAquire((semaphore), (permits)))
+/* Sends an element to a queue, waiting for space.  Queues don't announce space, so this is
+   checked every tick while the queue is full. */
+#define CO_SEND(co, queue, item) CO_WAIT_UNTIL(co, CO_WAIT_POLL, queueTrySend((queue), (item)))
+/* Sleeps for 'ticks' ticks */
+#define CO_SLEEP(co, ticks) do { \
+		(co)->wake = OS_elapsedTicks() + (ticks); \
+		CO_WAIT_UNTIL(co, CO_WAIT_SLEEP, !OS_tickBefore(OS_elapsedTicks(), (co)->wake)); \
+	} while (0)
+
+#endif /* COROUTINE_H */
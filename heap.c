@@ -0,0 +1,336 @@
+#include "heap.h"
+#include "os_internal.h"
+#include "list.h"
+#include <string.h>
+
+/* This is an implementation of a Two-Level Segregated Fit (TLSF) heap.
+
+	 Free blocks are kept on lists by size class.  The first level divides sizes by powers of
+	 two, and the second divides each power of two into HEAP_SL_INDEX_COUNT equal classes
+	 (small sizes are all in the first class, divided linearly).  Two levels of bitmaps say
+	 which lists are non-empty, so finding a free block big enough for a request is a couple
+	 of CLZ instructions, whatever the state of the heap.  Every block records its size and
+	 whether it and the block before it are free, so freeing a block merges it with its
+	 neighbours in constant time too.
+
+	 The heap is changed only by SVC handlers.  They can't be interrupted by a task, and every
+	 operation is short and has a fixed bound, so no mutex is needed and no task ever blocks
+	 on the heap. */
+
+#define HEAP_ALIGN 8
+#define HEAP_SL_INDEX_COUNT (1UL << HEAP_SL_INDEX_COUNT_LOG2)
+#define HEAP_FL_INDEX_SHIFT (HEAP_SL_INDEX_COUNT_LOG2 + 3)
+#define HEAP_FL_INDEX_COUNT (HEAP_FL_INDEX_MAX - HEAP_FL_INDEX_SHIFT + 1)
+#define HEAP_SMALL_BLOCK (1UL << HEAP_FL_INDEX_SHIFT)
+
+#if (1UL << HEAP_FL_INDEX_MAX) < HEAP_ARENA_SIZE
+#error "HEAP_FL_INDEX_MAX is too small for HEAP_ARENA_SIZE"
+#endif
+#if HEAP_ARENA_SIZE % HEAP_ALIGN
+#error "HEAP_ARENA_SIZE must be a multiple of 8"
+#endif
+
+/* Header of a block of the arena.  The payload of the block starts at freeNode, which is
+   only used while the block is free. */
+typedef struct s_heapBlock {
+	struct s_heapBlock * prevPhys;   // the block before this one; only valid if it is free
+	uint32_t size;                   // payload size in bytes, plus the flags below
+	OS_listNode_t freeNode;
+} heapBlock_t;
+
+#define HEAP_FREE       1UL          // this block is free
+#define HEAP_PREV_FREE  2UL          // the block before this one is free
+#define HEAP_FLAGS      (HEAP_FREE | HEAP_PREV_FREE)
+#define HEAP_HEADER     offsetof(heapBlock_t, freeNode)
+#define HEAP_MIN_BLOCK  sizeof(OS_listNode_t)
+
+static uint64_t _arena[HEAP_ARENA_SIZE / sizeof(uint64_t)];
+static OS_list_t _freeLists[HEAP_FL_INDEX_COUNT][HEAP_SL_INDEX_COUNT];
+static uint32_t _flBitmap = 0;
+static uint32_t _slBitmap[HEAP_FL_INDEX_COUNT];
+static uint32_t _heapReady = 0;
+
+static uint32_t _used = 0;
+static uint32_t _highWater = 0;
+static uint32_t _freeBytes = 0;
+static uint32_t _freeBlocks = 0;
+static uint32_t _failures = 0;
+
+#define BLOCK_OF_NODE(n) OS_LIST_ENTRY(n, heapBlock_t, freeNode)
+
+static uint32_t blockSize(heapBlock_t const * block) {
+	return block->size & ~HEAP_FLAGS;
+}
+
+static heapBlock_t * blockNext(heapBlock_t const * block) {
+	return (heapBlock_t *)((uint8_t *)block + HEAP_HEADER + blockSize(block));
+}
+
+static heapBlock_t * blockOf(void * ptr) {
+	return (heapBlock_t *)((uint8_t *)ptr - HEAP_HEADER);
+}
+
+/* Index of the most and least significant set bits of a non-zero word */
+static uint32_t heapFls(uint32_t word) {
+	return 31 - __CLZ(word);
+}
+
+static uint32_t heapFfs(uint32_t word) {
+	return 31 - __CLZ(word & -word);
+}
+
+/* Finds the size class that a block of the given size belongs in */
+static void mappingInsert(uint32_t size, uint32_t * fl, uint32_t * sl) {
+	if (size < HEAP_SMALL_BLOCK) {
+		*fl = 0;
+		*sl = size / (HEAP_SMALL_BLOCK / HEAP_SL_INDEX_COUNT);
+	} else {
+		uint32_t const top = heapFls(size);
+		*sl = (size >> (top - HEAP_SL_INDEX_COUNT_LOG2)) ^ HEAP_SL_INDEX_COUNT;
+		*fl = top - (HEAP_FL_INDEX_SHIFT - 1);
+	}
+}
+
+/* Finds the first size class in which every block is big enough for the given size */
+static void mappingSearch(uint32_t size, uint32_t * fl, uint32_t * sl) {
+	if (size >= HEAP_SMALL_BLOCK) {
+		size += (1UL << (heapFls(size) - HEAP_SL_INDEX_COUNT_LOG2)) - 1;
+	}
+	mappingInsert(size, fl, sl);
+}
+
+static void freeListInsert(heapBlock_t * block) {
+	uint32_t fl, sl;
+	mappingInsert(blockSize(block), &fl, &sl);
+	OS_listInsertBefore(_freeLists[fl][sl].next, &block->freeNode);
+	_flBitmap |= 1UL << fl;
+	_slBitmap[fl] |= 1UL << sl;
+	_freeBytes += blockSize(block);
+	_freeBlocks++;
+}
+
+static void freeListRemove(heapBlock_t * block) {
+	uint32_t fl, sl;
+	mappingInsert(blockSize(block), &fl, &sl);
+	OS_listRemove(&block->freeNode);
+	if (OS_listIsEmpty(&_freeLists[fl][sl])) {
+		_slBitmap[fl] &= ~(1UL << sl);
+		if (!_slBitmap[fl]) {
+			_flBitmap &= ~(1UL << fl);
+		}
+	}
+	_freeBytes -= blockSize(block);
+	_freeBlocks--;
+}
+
+/* Returns the first free block in the given size class or a larger one, updating the class */
+static heapBlock_t * freeListSearch(uint32_t * fl, uint32_t * sl) {
+	uint32_t slMap = _slBitmap[*fl] & (~0UL << *sl);
+	if (!slMap) {
+		uint32_t const flMap = _flBitmap & (~0UL << (*fl + 1));
+		if (!flMap) {
+			return 0;
+		}
+		*fl = heapFfs(flMap);
+		slMap = _slBitmap[*fl];
+	}
+	*sl = heapFfs(slMap);
+	return BLOCK_OF_NODE(_freeLists[*fl][*sl].next);
+}
+
+/* Marks a block as free, merges it with any free neighbours and puts it on a free list */
+static void blockRelease(heapBlock_t * block) {
+	heapBlock_t * next = blockNext(block);
+	if (next->size & HEAP_FREE) {
+		freeListRemove(next);
+		block->size += HEAP_HEADER + blockSize(next);
+	}
+	if (block->size & HEAP_PREV_FREE) {
+		heapBlock_t * const prev = block->prevPhys;
+		freeListRemove(prev);
+		prev->size += HEAP_HEADER + blockSize(block);
+		block = prev;
+	}
+	block->size |= HEAP_FREE;
+	next = blockNext(block);
+	next->prevPhys = block;
+	next->size |= HEAP_PREV_FREE;
+	freeListInsert(block);
+}
+
+/* Shrinks an allocated block to 'size' bytes, and frees the rest if there is enough of it */
+static void blockTrim(heapBlock_t * block, uint32_t size) {
+	if (blockSize(block) < size + HEAP_HEADER + HEAP_MIN_BLOCK) {
+		return;
+	}
+	heapBlock_t * rest = (heapBlock_t *)((uint8_t *)block + HEAP_HEADER + size);
+	rest->size = blockSize(block) - size - HEAP_HEADER;
+	block->size = size | (block->size & HEAP_FLAGS);
+	blockRelease(rest);
+}
+
+/* Rounds a request up to a whole number of alignment units */
+static uint32_t heapAdjustSize(size_t size) {
+	if (size < HEAP_MIN_BLOCK) {
+		return HEAP_MIN_BLOCK;
+	}
+	return (size + HEAP_ALIGN - 1) & ~(HEAP_ALIGN - 1);
+}
+
+/* The arena holds one big free block, followed by an empty block that is never free so
+   that the last real block always has a neighbour */
+static void heapInit(void) {
+	for (uint32_t fl = 0; fl < HEAP_FL_INDEX_COUNT; fl++) {
+		for (uint32_t sl = 0; sl < HEAP_SL_INDEX_COUNT; sl++) {
+			OS_listInit(&_freeLists[fl][sl]);
+		}
+		_slBitmap[fl] = 0;
+	}
+	heapBlock_t * const first = (heapBlock_t *)_arena;
+	first->prevPhys = 0;
+	first->size = sizeof(_arena) - 2 * HEAP_HEADER;
+	blockNext(first)->size = 0;
+	blockRelease(first);
+	_heapReady = 1;
+}
+
+static void * heapAllocate(size_t request) {
+	if (!_heapReady) {
+		heapInit();
+	}
+	if (request > sizeof(_arena)) {
+		_failures++;
+		return 0;
+	}
+	uint32_t const size = heapAdjustSize(request);
+	uint32_t fl, sl;
+	mappingSearch(size, &fl, &sl);
+	heapBlock_t * block = (fl < HEAP_FL_INDEX_COUNT) ? freeListSearch(&fl, &sl) : 0;
+	if (!block) {
+		_failures++;
+		return 0;
+	}
+	freeListRemove(block);
+	block->size &= ~HEAP_FREE;
+	blockNext(block)->size &= ~HEAP_PREV_FREE;
+	blockTrim(block, size);
+	_used += blockSize(block);
+	if (_used > _highWater) {
+		_highWater = _used;
+	}
+	return &block->freeNode;
+}
+
+/* SVC handler for heapAlloc() */
+void _svc_OS_heapAlloc(_OS_SVC_StackFrame_t * const stack) {
+	stack->r0 = (uint32_t)heapAllocate(stack->r0);
+}
+
+/* SVC handler for heapFree() */
+void _svc_OS_heapFree(_OS_SVC_StackFrame_t const * const stack) {
+	void * const ptr = (void *)stack->r0;
+	if (ptr) {
+		heapBlock_t * const block = blockOf(ptr);
+		_used -= blockSize(block);
+		blockRelease(block);
+	}
+}
+
+/* SVC handler for _heapResize().  Grows a block into a free block after it, or shrinks it. */
+void _svc_OS_heapResize(_OS_SVC_StackFrame_t * const stack) {
+	heapBlock_t * const block = blockOf((void *)stack->r0);
+	uint32_t const oldSize = blockSize(block);
+	if (stack->r1 > sizeof(_arena)) {
+		stack->r0 = 0;
+		return;
+	}
+	uint32_t const size = heapAdjustSize(stack->r1);
+	if (size > oldSize) {
+		heapBlock_t * const next = blockNext(block);
+		if (!(next->size & HEAP_FREE) || oldSize + HEAP_HEADER + blockSize(next) < size) {
+			stack->r0 = 0;
+			return;
+		}
+		freeListRemove(next);
+		block->size += HEAP_HEADER + blockSize(next);
+		blockNext(block)->size &= ~HEAP_PREV_FREE;
+	}
+	blockTrim(block, size);
+	_used = _used - oldSize + blockSize(block);
+	if (_used > _highWater) {
+		_highWater = _used;
+	}
+	stack->r0 = 1;
+}
+
+/* SVC handler for heapStats() */
+void _svc_OS_heapStats(_OS_SVC_StackFrame_t const * const stack) {
+	heapStats_t * const stats = (heapStats_t *)stack->r0;
+	if (!_heapReady) {
+		heapInit();
+	}
+	stats->arenaSize = sizeof(_arena);
+	stats->used = _used;
+	stats->highWater = _highWater;
+	stats->free = _freeBytes;
+	stats->freeBlocks = _freeBlocks;
+	stats->failures = _failures;
+	stats->largestFree = 0;
+	// The largest free block is somewhere in the largest non-empty size class
+	if (_flBitmap) {
+		uint32_t const fl = heapFls(_flBitmap);
+		OS_list_t const * const list = &_freeLists[fl][heapFls(_slBitmap[fl])];
+		for (OS_listNode_t const * node = list->next; node != list; node = node->next) {
+			if (blockSize(BLOCK_OF_NODE(node)) > stats->largestFree) {
+				stats->largestFree = blockSize(BLOCK_OF_NODE(node));
+			}
+		}
+	}
+}
+
+void * heapRealloc(void * ptr, size_t size) {
+	if (!ptr) {
+		return heapAlloc(size);
+	}
+	if (!size) {
+		heapFree(ptr);
+		return 0;
+	}
+	if (_heapResize(ptr, size)) {
+		return ptr;
+	}
+	// It can't grow where it is, so move it.  The block belongs to this task, so its size can
+	// be read without the kernel.
+	void * const moved = heapAlloc(size);
+	if (moved) {
+		uint32_t const oldSize = blockSize(blockOf(ptr));
+		memcpy(moved, ptr, oldSize < size ? oldSize : size);
+		heapFree(ptr);
+	}
+	return moved;
+}
+
+#if HEAP_REPLACE_MALLOC
+void * malloc(size_t size) {
+	return heapAlloc(size);
+}
+
+void free(void * ptr) {
+	heapFree(ptr);
+}
+
+void * realloc(void * ptr, size_t size) {
+	return heapRealloc(ptr, size);
+}
+
+void * calloc(size_t count, size_t size) {
+	if (size && count > SIZE_MAX / size) {
+		return 0;
+	}
+	void * const ptr = heapAlloc(count * size);
+	if (ptr) {
+		memset(ptr, 0, count * size);
+	}
+	return ptr;
+}
+#endif
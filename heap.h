@@ -0,0 +1,45 @@
+#ifndef HEAP_H
+#define HEAP_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include "os.h"
+
+/* Size in bytes of the static arena that the heap allocates from */
+#define HEAP_ARENA_SIZE 8192
+/* log2 of the number of size classes each power of two is divided into */
+#define HEAP_SL_INDEX_COUNT_LOG2 4
+/* log2 of the largest block the heap can manage.  Must cover HEAP_ARENA_SIZE. */
+#define HEAP_FL_INDEX_MAX 16
+/* If non-zero, malloc(), calloc(), realloc() and free() are defined in terms of this heap,
+   replacing the C library's.  With the ARM C library, also #pragma import(__use_no_heap). */
+#define HEAP_REPLACE_MALLOC 0
+
+/* Heap statistics.  Sizes are in bytes, and don't include block headers. */
+typedef struct {
+	uint32_t arenaSize;      // size of the arena, including all overheads
+	uint32_t used;           // bytes currently allocated
+	uint32_t highWater;      // largest value 'used' has ever had
+	uint32_t free;           // bytes in free blocks
+	uint32_t freeBlocks;     // number of free blocks
+	uint32_t largestFree;    // largest single allocation that would succeed now
+	uint32_t failures;       // allocations that couldn't be satisfied
+} heapStats_t;
+
+/* Allocates 'size' bytes, aligned to 8 bytes.  Returns zero if there is no free block big
+   enough.  Runs in constant time.  Must not be called from interrupt handlers. */
+void * __svc(OS_SVC_HEAP_ALLOC) heapAlloc(size_t size);
+/* Returns a block to the heap.  Null pointers are ignored.  Runs in constant time. */
+void __svc(OS_SVC_HEAP_FREE) heapFree(void * ptr);
+/* Resizes a block, moving it (and copying its contents) if it can't grow in place.  Returns
+   the new block, or zero if there is no room, in which case the old block is untouched. */
+void * heapRealloc(void * ptr, size_t size);
+/* Fills in the statistics.  Finding the largest free block takes time proportional to the
+   number of blocks in the largest size class, so this is not constant time. */
+void __svc(OS_SVC_HEAP_STATS) heapStats(heapStats_t * stats);
+
+/* SVC delegate behind heapRealloc(): resizes a block without moving it.  Returns non-zero on
+   success. */
+uint32_t __svc(OS_SVC_HEAP_RESIZE) _heapResize(void * ptr, size_t size);
+
+#endif /* HEAP_H */
@@ -0,0 +1,130 @@
+#include "isr.h"
+#include "os_internal.h"
+#include "latency.h"
+#include "critical.h"
+
+/* This is an implementation of the deferred kernel work queue used by interrupt handlers.
+
+	 Interrupt handlers can't use the SVC-based kernel calls or take a mutex, so instead the
+	 FromISR functions describe what they want done (in the same form as a batch operation)
+	 and push it onto a ring buffer, then pend PendSV.  PendSV carries out everything on the
+	 ring before it invokes the scheduler, so a task woken by an interrupt can be switched to
+	 on the way out of that same PendSV.
+
+	 Any number of interrupts at different priorities may push at once, so a slot is claimed
+	 by advancing the head index with LDREX/STREX, and the slot is only marked as ready once
+	 it has been filled in.  PendSV is the only consumer.  If a request's object is locked by
+	 a task, it is left on the ring and retried on the next PendSV (at the latest the next
+	 tick), along with any later requests for the same object, so each object still sees its
+	 requests in order.  Requests for other objects behind it are carried out straight away
+	 and marked done; their slots are freed when the held request ahead of them is, so
+	 while one is held at most ISR_QUEUE_SIZE requests can be pushed from it onwards.
+
+	 Only interrupts no more urgent than OS_MAX_SYSCALL_PRIORITY may push (see critical.h).
+	 The ring itself doesn't need masking, but the count of dropped requests is changed by
+	 several interrupts and by PendSV, so it is counted in a short critical section. */
+
+/* States of a slot */
+typedef enum {
+	ISR_EMPTY,      // claimed, or about to be, but not filled in yet
+	ISR_READY,      // filled in and waiting to be carried out
+	ISR_DONE        // carried out, behind a request that's still held
+} isrState_e;
+
+typedef struct {
+	batchOp_t op;
+	uint32_t volatile state;
+} isrRequest_t;
+
+static isrRequest_t _requests[ISR_QUEUE_SIZE];
+static uint32_t volatile _head = 0;   // next slot to be claimed by an interrupt
+static uint32_t volatile _tail = 0;   // oldest slot not yet carried out by PendSV
+static uint32_t volatile _dropped = 0;
+
+static void _isrDropped(void) {
+	uint32_t const mask = OS_enterCritical();
+	_dropped++;
+	OS_exitCritical(mask);
+}
+
+uint32_t _isrPush(uint32_t op, void * object, uint32_t value) {
+	uint32_t head;
+	// A more urgent interrupt would break the kernel's critical sections
+	ASSERT(OS_kernelCallAllowed());
+	// Claim a slot
+	do {
+		head = __LDREXW((uint32_t *) &_head);
+		if (head - _tail >= ISR_QUEUE_SIZE) {
+			__CLREX();
+			_isrDropped();
+			return 0;
+		}
+	} while (__STREXW(head + 1, (uint32_t *) &_head));
+#if OS_LATENCY_ENABLED
+	// The latency of a run of requests is measured from the first
+	if (head == _tail) {
+		_OS_latencyIrq();
+	}
+#endif
+	// Fill it in, then publish it
+	isrRequest_t * request = &_requests[head % ISR_QUEUE_SIZE];
+	request->op.op = op;
+	request->op.object = object;
+	request->op.value = value;
+	__DMB();
+	request->state = ISR_READY;
+	SCB->ICSR = SCB_ICSR_PENDSVSET_Msk;
+	return 1;
+}
+
+void _isrDrain(void) {
+	void * held[ISR_QUEUE_SIZE];   // objects with a request that's still waiting for them
+	uint32_t heldCount = 0;
+	for (uint32_t index = _tail; index != _head; index++) {
+		isrRequest_t * request = &_requests[index % ISR_QUEUE_SIZE];
+		// A slot can be claimed but not yet filled in if its interrupt was itself interrupted
+		if (request->state == ISR_EMPTY) {
+			break;
+		}
+		if (request->state == ISR_DONE) {
+			continue;
+		}
+		uint32_t i = 0;
+		while (i < heldCount && held[i] != request->op.object) {
+			i++;
+		}
+		if (i < heldCount) {
+			// Behind a held request for the same object, so it must wait too
+			continue;
+		}
+		batchResult_e result = _batchExecute(&request->op);
+		if (result == BATCH_BUSY) {
+			// Try again on the next PendSV
+			held[heldCount++] = request->op.object;
+			continue;
+		}
+		if (result == BATCH_FULL || result == BATCH_INVALID) {
+			// Interrupts can't wait for space, and a request that doesn't apply is lost as well
+			_isrDropped();
+		}
+		request->state = ISR_DONE;
+	}
+	// Free the slots from the front up to the first request that's still to be carried out
+	while (_tail != _head && _requests[_tail % ISR_QUEUE_SIZE].state == ISR_DONE) {
+		_requests[_tail % ISR_QUEUE_SIZE].state = ISR_EMPTY;
+		__DMB();
+		_tail++;
+	}
+}
+
+uint32_t _isrPending(void) {
+	return _tail != _head;
+}
+
+uint32_t OS_notifyFromISR(void * reason) {
+	return _isrPush(BATCH_NOTIFY, reason, 0);
+}
+
+uint32_t isrDropped(void) {
+	return _dropped;
+}
@@ -0,0 +1,30 @@
+#ifndef ISR_H
+#define ISR_H
+
+#include <stdint.h>
+#include "batch.h"
+
+/* Number of requests that interrupts can have outstanding at once.  Must be a power of two. */
+#define ISR_QUEUE_SIZE 16
+
+/* Interrupt-safe counterpart of OS_notify().  May be called from any interrupt handler; it
+   never blocks and never takes a mutex.  The tasks are woken when PendSV next runs, which is
+	 requested straight away.  Returns zero if the request queue was full and the request was
+	 dropped. */
+uint32_t OS_notifyFromISR(void * reason);
+
+/* Returns how many interrupt requests have been lost, either because the request queue was
+   full or because a queue they posted to was full. */
+uint32_t isrDropped(void);
+
+/* Queues a request from an interrupt handler, to be carried out by PendSV.  Used by the
+   FromISR functions of the kernel objects. */
+uint32_t _isrPush(uint32_t op, void * object, uint32_t value);
+
+/* Called by PendSV before the scheduler: carries out queued interrupt requests */
+void _isrDrain(void);
+
+/* Returns non-zero if there are interrupt requests that haven't been carried out yet */
+uint32_t _isrPending(void);
+
+#endif /* ISR_H */
@@ -0,0 +1,140 @@
+#include "lockstat.h"
+
+#if LOCKSTAT_ENABLED
+
+#include <stdio.h>
+#include <string.h>
+
+/* This is a Lock Contention Profiler.
+
+	 Each mutex and semaphore carries a lockstat_t.  A task
+	 that finds the object taken notes the time and the
+	 holder before it waits, and once it has the object it
+	 adds the wait to the statistics.  The holder notes when
+	 it took the object, and its hold time when it lets go.
+	 Nothing is recorded on the uncontended path except two
+	 timer reads and a few additions. */
+
+static lockstat_t * _registered = 0;
+static uint32_t _overheadNs = 0;
+
+static void lockstatClear(lockstat_t * stats) {
+	stats->acquires = 0;
+	stats->contended = 0;
+	stats->totalWait = 0;
+	stats->maxWait = 0;
+	stats->maxHold = 0;
+	stats->peakWaitOwner = 0;
+}
+
+void lockstatObjectInit(lockstat_t * stats) {
+	stats->name = 0;
+	stats->next = 0;
+	lockstatClear(stats);
+}
+
+void lockstatWaiting(lockstatWait_t * wait, OS_TCB_t * owner) {
+	// Only the first wait counts as the start; a task can be woken and lose the race again
+	if (!wait->waited) {
+		wait->waited = 1;
+		wait->start = lockstatNow();
+		wait->owner = owner;
+	}
+}
+
+void lockstatAcquired(lockstat_t * stats, lockstatWait_t const * wait) {
+	uint32_t const now = lockstatNow();
+	stats->acquires++;
+	stats->acquiredAt = now;
+	if (wait->waited) {
+		uint32_t const waited = now - wait->start;
+		stats->contended++;
+		stats->totalWait += waited;
+		if (waited > stats->maxWait) {
+			stats->maxWait = waited;
+			stats->peakWaitOwner = wait->owner;
+		}
+	}
+}
+
+void lockstatReleased(lockstat_t * stats) {
+	uint32_t const held = lockstatNow() - stats->acquiredAt;
+	if (held > stats->maxHold) {
+		stats->maxHold = held;
+	}
+}
+
+void lockstatInit(void) {
+	// The timer clock is the APB1 clock, doubled if APB1 is divided down from AHB
+	static uint32_t const ppre1[] = {1, 1, 1, 1, 2, 4, 8, 16};
+	static uint32_t const hpre[] = {1, 1, 1, 1, 1, 1, 1, 1, 2, 4, 8, 16, 64, 128, 256, 512};
+	SystemCoreClockUpdate();
+	uint32_t const ahbclock = SystemCoreClock / hpre[(RCC->CFGR & RCC_CFGR_HPRE_Msk) >> RCC_CFGR_HPRE_Pos];
+	uint32_t const apb1div = ppre1[(RCC->CFGR & RCC_CFGR_PPRE1_Msk) >> RCC_CFGR_PPRE1_Pos];
+	uint32_t const timerclock = apb1div == 1 ? ahbclock : 2 * ahbclock / apb1div;
+
+	RCC->APB1ENR |= RCC_APB1ENR_TIM2EN;
+	LOCKSTAT_TIMER->CR1 = 0;
+	LOCKSTAT_TIMER->PSC = timerclock / LOCKSTAT_TIMER_HZ - 1;
+	LOCKSTAT_TIMER->ARR = 0xFFFFFFFF;
+	LOCKSTAT_TIMER->EGR = TIM_EGR_UG;			/* Load the prescaler */
+	LOCKSTAT_TIMER->CR1 = TIM_CR1_CEN;
+
+	// Time the hooks on a scratch record.  They are called through volatile pointers so the
+	// compiler can't fold the loop away.  With a microsecond timer, the time for a thousand
+	// pairs in microseconds is the time for one pair in nanoseconds.
+	static lockstat_t scratch;
+	lockstatWait_t const wait = {1, 0, 0};
+	void (* volatile acquired)(lockstat_t *, lockstatWait_t const *) = lockstatAcquired;
+	void (* volatile released)(lockstat_t *) = lockstatReleased;
+	uint32_t const start = lockstatNow();
+	for (uint32_t i = 0; i < LOCKSTAT_CALIBRATION_PAIRS; i++) {
+		acquired(&scratch, &wait);
+		released(&scratch);
+	}
+	_overheadNs = (uint32_t)((uint64_t)(lockstatNow() - start) * (1000000000 / LOCKSTAT_TIMER_HZ) / LOCKSTAT_CALIBRATION_PAIRS);
+}
+
+uint32_t lockstatOverheadNs(void) {
+	return _overheadNs;
+}
+
+void lockstatRegister(lockstat_t * stats, char const * name) {
+	if (!stats->name) {
+		stats->next = _registered;
+		_registered = stats;
+	}
+	stats->name = name;
+}
+
+void lockstatReset(void) {
+	for (lockstat_t * stats = _registered; stats; stats = stats->next) {
+		lockstatClear(stats);
+	}
+}
+
+void lockstatReport(void) {
+	// Insertion sort of the registered list by total wait, longest first.  There are only
+	// ever a handful of objects, and sorting the list itself needs no extra memory.
+	lockstat_t * sorted = 0;
+	while (_registered) {
+		lockstat_t * stats = _registered;
+		_registered = stats->next;
+		lockstat_t ** position = &sorted;
+		while (*position && (*position)->totalWait >= stats->totalWait) {
+			position = &(*position)->next;
+		}
+		stats->next = *position;
+		*position = stats;
+	}
+	_registered = sorted;
+
+	printf("%-16s %10s %10s %12s %10s %10s %10s\r\n", "object", "acquires", "contended", "wait_us", "max_wait", "max_hold", "peak_owner");
+	for (lockstat_t const * stats = _registered; stats; stats = stats->next) {
+		printf("%-16s %10u %10u %12llu %10u %10u %10p\r\n", stats->name, stats->acquires, stats->contended,
+			(unsigned long long) stats->totalWait, stats->maxWait, stats->maxHold, (void *) stats->peakWaitOwner);
+	}
+	printf("hook overhead: %u ns per acquire/release pair\r\n", _overheadNs);
+}
+
+#endif /* LOCKSTAT_ENABLED */
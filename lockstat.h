@@ -0,0 +1,84 @@
+#ifndef LOCKSTAT_H
+#define LOCKSTAT_H
+
+#include <stdint.h>
+#include "task.h"
+#include "stm32f3xx.h"
+
+/* If non-zero, every OS_mutex_t and semaphore_t (and so every queue_t, through its mutex)
+   records contention statistics.  If zero, the statistics and every hook that updates them
+	 are compiled out, and the functions below do nothing. */
+#ifndef LOCKSTAT_ENABLED
+#define LOCKSTAT_ENABLED 0
+#endif
+/* Free-running 32-bit timer used for timestamps, because tasks can't read the DWT cycle
+   counter.  lockstatInit() sets it to count in microseconds. */
+#define LOCKSTAT_TIMER TIM2
+#define LOCKSTAT_TIMER_HZ 1000000
+/* Number of acquire/release hook pairs that lockstatInit() times to measure the overhead */
+#define LOCKSTAT_CALIBRATION_PAIRS 1000
+
+/* Contention statistics for one object.  Times are in microseconds.  A mutex's statistics are
+   only updated by the task that holds it.  Several tasks can hold a semaphore's permits at
+	 once, so its statistics are updated under the semaphore's own mutex.  Either way they need
+	 no locking of their own. */
+typedef struct s_lockstat {
+	char const * name;            // set by lockstatRegister()
+	uint32_t acquires;            // times taken (recursive acquires of a mutex aren't counted)
+	uint32_t contended;           // times a task had to wait first
+	uint64_t totalWait;           // total time spent waiting
+	uint32_t maxWait;             // longest single wait
+	uint32_t maxHold;             // longest time held (not recorded for semaphores)
+	OS_TCB_t * peakWaitOwner;     // task that held the object during the longest wait, if known
+	uint32_t acquiredAt;
+	struct s_lockstat * next;     // next registered object
+} lockstat_t;
+
+/* State of one task's attempt to take an object, kept on its stack */
+typedef struct {
+	uint32_t waited;
+	uint32_t start;
+	OS_TCB_t * owner;
+} lockstatWait_t;
+
+#if LOCKSTAT_ENABLED
+
+/* Starts the timer and measures the overhead of the hooks.  Call once, from main() before
+   OS_start(), since it configures a peripheral. */
+void lockstatInit(void);
+/* Adds an object's statistics to the report under the given name, e.g.
+   lockstatRegister(&mutex.stats, "uart"), lockstatRegister(&semaphore.stats, "slots") or
+	 lockstatRegister(&queue.mutex.stats, "printQueue").  Register objects after initialising
+	 them, from one task or before OS_start(). */
+void lockstatRegister(lockstat_t * stats, char const * name);
+/* Prints the registered objects, most total waiting first, and the measured hook overhead */
+void lockstatReport(void);
+/* Clears the statistics of every registered object */
+void lockstatReset(void);
+/* Time taken by one acquire/release hook pair, in nanoseconds, as measured by lockstatInit() */
+uint32_t lockstatOverheadNs(void);
+
+/* Hooks for the kernel objects */
+static inline uint32_t lockstatNow(void) {
+	return LOCKSTAT_TIMER->CNT;
+}
+/* Called when the object is initialised, before it is registered */
+void lockstatObjectInit(lockstat_t * stats);
+/* Called each time a task finds the object unavailable and is about to wait for it */
+void lockstatWaiting(lockstatWait_t * wait, OS_TCB_t * owner);
+/* Called by the task that has just taken the object */
+void lockstatAcquired(lockstat_t * stats, lockstatWait_t const * wait);
+/* Called by the task that holds the object, just before it lets go */
+void lockstatReleased(lockstat_t * stats);
+
+#else
+
+#define lockstatInit() ((void) 0)
+#define lockstatRegister(stats, name) ((void) 0)
+#define lockstatReport() ((void) 0)
+#define lockstatReset() ((void) 0)
+#define lockstatOverheadNs() 0u
+
+#endif /* LOCKSTAT_ENABLED */
+
+#endif /* LOCKSTAT_H */
@@ -6,7 +6,9 @@
 #include "sleep.h"
 #include "mutex.h"
 #include "queue.h"
+#include "pqueue.h"
 #include "memory.h"
+#include "lockstat.h"
 
 #define packet_MAX_BUFFER 256
 
@@ -28,27 +30,23 @@ typedef struct {
 
 /* List of static variables that */ 
 static OS_mutex_t mutexT;
-static queue_t printQueue;
+static pqueue_t printQueue;
 static queue_t animalQueue;
+static uint32_t printQueueStorage[PQUEUE_BUFFER_SIZE(10, sizeof(packet_t *)) / sizeof(uint32_t)];
+static packet_t *animalQueueStorage[10];
 static pool_t packetPool;
 static packet_t packets[25];
 static uint32_t packetID = 0;
 
 /* Create packets */
 packet_t* getPacket(){
-		packet_t *packet;
-		while(1){
-			packet = pool_allocate(&packetPool);
-			if (!packet) {
-				OS_sleep(1);
-				continue;
-			}
-			if(packetID == UINT32_MAX){
-				packetID = 0;
-			}
-			packet->id = packetID++;
-			return packet;
-	}		
+		// Wait for a packet to be freed if the pool is empty
+		packet_t *packet = pool_allocate_wait(&packetPool, POOL_WAIT_FOREVER);
+		if(packetID == UINT32_MAX){
+			packetID = 0;
+		}
+		packet->id = packetID++;
+		return packet;
 }
 /* Sends name chars to queue to be read by the animalsTask function*/
 void animalNamesTask(void const *const args) {
@@ -83,18 +81,21 @@ void animalNamesTask(void const *const args) {
 /* Print out animal names from queue to demostrate recieving a message from another task */
 void animalsTask(void const *const args) {
 	while (1) {
-		packet_t *packet = queueReceive(&animalQueue);
+		packet_t *packet;
+		queueReceive(&animalQueue, &packet);
 		packet_t *animalpacket = getPacket();
 		snprintf(animalpacket->data, packet_MAX_BUFFER, "animalsTask: The %s says 'Hello'!", packet->data);
 		pool_add(&packetPool, packet);
-		queueSend(&printQueue, &animalpacket);
+		// Sent urgently, so it overtakes any taskFib lines already waiting to be printed
+		pqueueSend(&printQueue, &animalpacket, PQUEUE_URGENT);
 	}
 }
 
 /* Print fibonacci numbers from other task */
 void printTask(void const *const args) {
 	while (1) {
-		packet_t* packet = queueReceive(&printQueue);
+		packet_t* packet;
+		pqueueReceive(&printQueue, &packet);
 		printf("> %u: %s\n", packet->id, packet->data);
 		pool_add(&packetPool, packet);
 	}
@@ -106,11 +107,6 @@ void taskFib(void const *const args) {
 	packet_t* packet;
 	while (1) {
 		packet = getPacket();
-		// Sleep until the next memory block is available
-		if(!packet) {
-			OS_sleep(10);
-			continue;
-		}
 		// Calculate Fib sequence
 		tmpFib = previousFib + currentFib;
 		previousFib = currentFib;
@@ -122,7 +118,7 @@ void taskFib(void const *const args) {
 		}
 		// Write data to packet to be sent via the queue
 		snprintf(packet->data, packet_MAX_BUFFER, "taskFib: %u", currentFib);
-		queueSend(&printQueue, &packet);
+		pqueueSend(&printQueue, &packet, 0);
 		OS_sleep(5);
 	}
 }
@@ -141,10 +137,18 @@ void populatePoolTask(void const * const args){
 	/* Set up core clock and initialise serial port */
 	config_init();
 	mutexInit(&mutexT); 
-	queueInit(&printQueue);
-	queueInit(&animalQueue);
+	// Two of the ten slots are kept free for urgent lines
+	pqueueInit(&printQueue, printQueueStorage, 10, sizeof(packet_t *), 2);
+	queueInit(&animalQueue, animalQueueStorage, 10, sizeof(packet_t *));
 	pool_init(&packetPool);
 
+	/* Contention profiling; these do nothing unless LOCKSTAT_ENABLED is set in lockstat.h */
+	lockstatInit();
+	lockstatRegister(&mutexT.stats, "mutexT");
+	lockstatRegister(&printQueue.mutex.stats, "printQueue");
+	lockstatRegister(&animalQueue.mutex.stats, "animalQueue");
+	lockstatRegister(&packetPool.mutex.stats, "packetPool");
+
 	printf("\r\nDocetOS Sleep and Mutex\r\n");
 
 	/* Reserve memory for five stacks and five TCBs.
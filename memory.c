@@ -1,16 +1,33 @@
 #include "memory.h"
+#include "timer.h"
 /* This is an implementation of a Memory Pool
 	 
 	 The Memory pool implemented as singly linked list.
 	 It is protected with a mutex which only allows one 
 	 task to write to the pool at a time
+
+	 Tasks waiting for a block queue up on the pool in
+	 priority order.  A block that is freed while anyone is
+	 waiting never goes back on the list: it is handed to
+	 the first waiter, and only that task is woken.
 */
 
+/* A task waiting in pool_allocate_wait().  Lives on the waiting task's stack, and is also
+   the reason it waits on, so each waiter can be woken on its own. */
+typedef struct {
+	OS_listNode_t node;
+	uint32_t priority;
+	void * volatile block;     // set by pool_deallocate() when it hands over a block
+} poolWaiter_t;
+
+#define WAITER_OF(n) OS_LIST_ENTRY(n, poolWaiter_t, node)
+
 /* Initialise the Memory Pool*/
 void pool_init(pool_t *pool) {
     // Initialise the pool
 		pool->head = NULL;
 	  mutexInit(&pool->mutex);
+		OS_listInit(&pool->waiters);
 }
 
 /* Allocate from the Memory Pool*/
@@ -19,15 +36,84 @@ void *pool_allocate(pool_t *pool) {
     // Update the head pointer
 		mutexAquire(&pool->mutex);
 		void* item = pool->head;
-		pool->head = *(void**)item;	
+		if (item) {
+			pool->head = *(void**)item;
+		}
 	 	mutexRelease(&pool->mutex);
 		return item;  
 }
 
+/* Timer callback: wakes a waiter whose time is up */
+static void pool_timeout(void *waiter) {
+	OS_notify(waiter);
+}
+
+/* Allocate from the Memory Pool, waiting if it is empty */
+void *pool_allocate_wait(pool_t *pool, uint32_t timeout) {
+		poolWaiter_t waiter;
+		OS_timer_t timer;
+		mutexAquire(&pool->mutex);
+		void* item = pool->head;
+		if (item || timeout == 0) {
+			if (item) {
+				pool->head = *(void**)item;
+			}
+			mutexRelease(&pool->mutex);
+			return item;
+		}
+		// Queue up behind every waiter of the same or higher priority
+		waiter.priority = OS_currentTCB()->priority;
+		waiter.block = NULL;
+		OS_listNode_t *position = pool->waiters.prev;
+		while (position != &pool->waiters && WAITER_OF(position)->priority < waiter.priority) {
+			position = position->prev;
+		}
+		OS_listInsertBefore(position->next, &waiter.node);
+		mutexRelease(&pool->mutex);
+
+		uint32_t const timed = timeout != POOL_WAIT_FOREVER;
+		if (timed) {
+			OS_timerInit(&timer, pool_timeout, &waiter);
+			OS_timerStart(&timer, timeout, 0);
+		}
+		while (1) {
+			// Take the check value before looking, so a hand-over in between isn't missed
+			uint32_t checkValue = currentCheckValue();
+			if (waiter.block) {
+				break;
+			}
+			if (timed && !OS_timerIsRunning(&timer)) {
+				// Timed out, unless a block was handed over just now
+				mutexAquire(&pool->mutex);
+				if (!waiter.block) {
+					OS_listRemove(&waiter.node);
+				}
+				mutexRelease(&pool->mutex);
+				break;
+			}
+			OS_wait((void *)&waiter, checkValue);
+		}
+		// The timer service copies a callback and its argument out when it takes an expiry, so the
+		// timer and the waiter can go out of scope once the timer is stopped
+		if (timed) {
+			OS_timerStop(&timer);
+		}
+		return waiter.block;
+}
+
 /* Deallocate to the Memory Pool*/
 void pool_deallocate(pool_t *pool, void *item) {
-    // Add the new item to the head of the list
 		mutexAquire(&pool->mutex);
+		if (!OS_listIsEmpty(&pool->waiters)) {
+			// Hand the block straight to the first waiter
+			poolWaiter_t *waiter = WAITER_OF(pool->waiters.next);
+			OS_listRemove(&waiter->node);
+			waiter->block = item;
+			mutexRelease(&pool->mutex);
+			OS_notify((void *)waiter);
+			return;
+		}
+    // Add the new item to the head of the list
 		*(void**) item = pool->head;
 		pool->head = item;
 		mutexRelease(&pool->mutex);
@@ -4,16 +4,28 @@
 #include <stddef.h>
 #include "mutex.h"
 #include "task.h"
+#include "list.h"
 #include "os.h"
 
+/* Timeout for pool_allocate_wait() that never expires */
+#define POOL_WAIT_FOREVER 0xFFFFFFFF
+
 typedef struct {
 	OS_mutex_t mutex;
 	int farts;
 	void *head;
+	OS_list_t waiters;    // tasks in pool_allocate_wait(), highest priority first
 } pool_t;
 
 void pool_init(pool_t *pool);
+/* Takes a block from the pool, or returns zero if the pool is empty */
 void *pool_allocate(pool_t *pool);
+/* Takes a block from the pool, waiting up to 'timeout' ticks for one to be freed if the pool is
+   empty (zero means don't wait, POOL_WAIT_FOREVER means no limit).  A freed block is handed
+	 straight to the highest-priority waiting task, first come first served within a priority.
+	 Returns zero if the timeout expired.  Timeouts need the timer service task (see
+	 OS_timerServiceStart()). */
+void *pool_allocate_wait(pool_t *pool, uint32_t timeout);
 void pool_deallocate(pool_t *pool, void *item);
 
 #define pool_add pool_deallocate
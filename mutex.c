@@ -13,12 +13,20 @@
 void mutexInit(OS_mutex_t * mutex){
 	mutex->counter = 0;
 	mutex->task = 0;
+#if LOCKSTAT_ENABLED
+	lockstatObjectInit(&mutex->stats);
+#endif
 }
 
 /* Aquire the mutex */
 void mutexAquire(OS_mutex_t * mutex){
 	uint32_t currentTCB;
+#if LOCKSTAT_ENABLED
+	lockstatWait_t wait = {0};
+#endif
 	while (1) {
+		// Take the check value before looking at the mutex, so a release in between isn't missed
+		uint32_t checkValue = currentCheckValue();
 		// Wrapper for assembly code to ensure processor doesn't interrupt task. Exclusive Load.
 		currentTCB = __LDREXW((uint32_t *) &(mutex->task));
 		if (currentTCB == 0) {
@@ -27,12 +35,25 @@ void mutexAquire(OS_mutex_t * mutex){
 				break;
 			}
 			// Put task into wait state if mutex isn't acquired 
-		} else if (currentTCB != (uint32_t) OS_currentTCB) {
-			OS_wait((void *) mutex, currentCheckValue());
+		} else if (currentTCB != (uint32_t) OS_currentTCB()) {
+			__CLREX();
+#if LOCKSTAT_ENABLED
+			lockstatWaiting(&wait, (OS_TCB_t *) currentTCB);
+#endif
+			OS_wait((void *) mutex, checkValue);
+		} else {
+			// This task already holds the mutex
+			__CLREX();
+			break;
 		}
 	}
 	// Else increase the mutex count - how many times this task has taken the mutex
 	mutex->counter++;
+#if LOCKSTAT_ENABLED
+	if (mutex->counter == 1) {
+		lockstatAcquired(&mutex->stats, &wait);
+	}
+#endif
 }
 
 /* Release the Mutex*/
@@ -42,6 +63,9 @@ void mutexRelease(OS_mutex_t * mutex){
 		mutex->counter--;
 			if(mutex->counter == 0){
 				//mutex has been released
+#if LOCKSTAT_ENABLED
+				lockstatReleased(&mutex->stats);
+#endif
 				mutex->task = 0;
 				// Notify tasks that they can now claim the mutex 
 				OS_notify((void *)mutex);
@@ -5,6 +5,7 @@
 #include <stddef.h>
 #include "task.h"
 #include "os.h"
+#include "lockstat.h"
 //#ifndef __STM32F3xx_H
 #include "stm32f3xx.h"
 //#endif
@@ -12,6 +13,9 @@
 typedef struct {
 	uint32_t counter;
 	OS_TCB_t * task;
+#if LOCKSTAT_ENABLED
+	lockstat_t stats;
+#endif
 } OS_mutex_t;
 
 void mutexInit(OS_mutex_t * mutex);
@@ -0,0 +1,150 @@
+#include "pqueue.h"
+#include "os_internal.h"
+#include <string.h>
+
+/* This is an implementation of a priority message queue.
+
+	 Every element lives in a slot, which starts with the
+	 index of the next slot in the same list.  Unused slots
+	 form a free list, and the elements of each priority
+	 form a FIFO list, so a send takes a slot off the free
+	 list and appends it to its priority's list, and a
+	 receive finds the highest non-empty list with one CLZ
+	 of the bitmap.  Neither ever searches.
+
+	 Locking and waiting work as in queue.c, except that
+	 urgent senders wait on their own condition variable.
+	 When a slot is freed they are woken first, because only
+	 they may be able to use it. */
+
+#define PQUEUE_NONE 0xFFFFFFFFUL
+
+/* Returns the link word at the start of a slot; the element follows it */
+static uint32_t *pqueueSlot(pqueue_t *queue, uint32_t slot) {
+	return (uint32_t *)(queue->buffer + slot * PQUEUE_SLOT_SIZE(queue->itemSize));
+}
+
+/* Initialise the Queue */
+void pqueueInit(pqueue_t *queue, void *buffer, uint32_t capacity, uint32_t itemSize, uint32_t reserve) {
+	// Otherwise senders below PQUEUE_URGENT could never send at all
+	ASSERT(reserve < capacity);
+	mutexInit(&queue->mutex);
+	condInit(&queue->notEmpty);
+	condInit(&queue->notFull);
+	condInit(&queue->urgentSpace);
+	queue->buffer = buffer;
+	queue->capacity = capacity;
+	queue->itemSize = itemSize;
+	queue->reserve = reserve;
+	queue->count = 0;
+	queue->levels = 0;
+	// Every slot starts on the free list
+	for (uint32_t slot = 0; slot < capacity; slot++) {
+		*pqueueSlot(queue, slot) = (slot + 1 < capacity) ? slot + 1 : PQUEUE_NONE;
+	}
+	queue->free = capacity ? 0 : PQUEUE_NONE;
+}
+
+/* Returns non-zero if an element of this priority may take a slot now */
+static uint32_t pqueueHasSpace(pqueue_t const *queue, uint32_t priority) {
+	uint32_t const limit = (priority == PQUEUE_URGENT) ? queue->capacity : queue->capacity - queue->reserve;
+	return queue->count < limit;
+}
+
+/* Appends an element to the list of its priority.  There must be a free slot. */
+static void pqueueInsert(pqueue_t *queue, void const *item, uint32_t priority) {
+	uint32_t const slot = queue->free;
+	uint32_t *link = pqueueSlot(queue, slot);
+	queue->free = *link;
+	*link = PQUEUE_NONE;
+	memcpy(link + 1, item, queue->itemSize);
+	if (queue->levels & (1UL << priority)) {
+		*pqueueSlot(queue, queue->tail[priority]) = slot;
+	} else {
+		queue->head[priority] = slot;
+		queue->levels |= 1UL << priority;
+	}
+	queue->tail[priority] = slot;
+	queue->count++;
+	condSignal(&queue->notEmpty);
+}
+
+/* Removes the oldest element of the highest priority present, and returns its priority.
+   The queue must not be empty. */
+static uint32_t pqueueRemove(pqueue_t *queue, void *item) {
+	uint32_t const priority = 31 - __CLZ(queue->levels);
+	uint32_t const slot = queue->head[priority];
+	uint32_t *link = pqueueSlot(queue, slot);
+	memcpy(item, link + 1, queue->itemSize);
+	if (slot == queue->tail[priority]) {
+		queue->levels &= ~(1UL << priority);
+	} else {
+		queue->head[priority] = *link;
+	}
+	*link = queue->free;
+	queue->free = slot;
+	queue->count--;
+	// Hand the slot to a waiting sender that is allowed to use it, urgent senders first
+	uint32_t claimed = 0;
+	if (queue->urgentSpace.waiting) {
+		condSignal(&queue->urgentSpace);
+		claimed = 1;
+	}
+	if (queue->count + claimed < queue->capacity - queue->reserve) {
+		condSignal(&queue->notFull);
+	}
+	return priority;
+}
+
+/* Send to the Queue */
+void pqueueSend(pqueue_t *queue, void const *item, uint32_t priority) {
+	if (priority > PQUEUE_URGENT) {
+		priority = PQUEUE_URGENT;
+	}
+	OS_cond_t * const space = (priority == PQUEUE_URGENT) ? &queue->urgentSpace : &queue->notFull;
+	mutexAquire(&queue->mutex);
+	while (!pqueueHasSpace(queue, priority)) {
+		condWait(space, &queue->mutex);
+	}
+	pqueueInsert(queue, item, priority);
+	mutexRelease(&queue->mutex);
+}
+
+/* Receive from the Queue */
+uint32_t pqueueReceive(pqueue_t *queue, void *item) {
+	mutexAquire(&queue->mutex);
+	while (queue->count == 0) {
+		condWait(&queue->notEmpty, &queue->mutex);
+	}
+	uint32_t const priority = pqueueRemove(queue, item);
+	mutexRelease(&queue->mutex);
+	return priority;
+}
+
+/* Send to the Queue if there is space */
+uint32_t pqueueTrySend(pqueue_t *queue, void const *item, uint32_t priority) {
+	if (priority > PQUEUE_URGENT) {
+		priority = PQUEUE_URGENT;
+	}
+	mutexAquire(&queue->mutex);
+	uint32_t const sent = pqueueHasSpace(queue, priority);
+	if (sent) {
+		pqueueInsert(queue, item, priority);
+	}
+	mutexRelease(&queue->mutex);
+	return sent;
+}
+
+/* Receive from the Queue if it isn't empty */
+uint32_t pqueueTryReceive(pqueue_t *queue, void *item, uint32_t *priority) {
+	mutexAquire(&queue->mutex);
+	uint32_t const received = queue->count != 0;
+	if (received) {
+		uint32_t const level = pqueueRemove(queue, item);
+		if (priority) {
+			*priority = level;
+		}
+	}
+	mutexRelease(&queue->mutex);
+	return received;
+}
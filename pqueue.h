@@ -0,0 +1,57 @@
+#ifndef PQUEUE_H
+#define PQUEUE_H
+
+#include <stdint.h>
+#include "mutex.h"
+#include "cond.h"
+#include "os.h"
+
+/* Number of message priorities.  0 is the lowest and PQUEUE_URGENT the highest.  At most 32. */
+#define PQUEUE_PRIORITIES 8
+#define PQUEUE_URGENT (PQUEUE_PRIORITIES - 1)
+
+/* Bytes of storage a priority queue needs for 'capacity' elements of 'itemSize' bytes.  Each
+   element is kept with a link word, so the storage must be word-aligned. */
+#define PQUEUE_SLOT_SIZE(itemSize) (sizeof(uint32_t) + (((itemSize) + 3) & ~3u))
+#define PQUEUE_BUFFER_SIZE(capacity, itemSize) ((capacity) * PQUEUE_SLOT_SIZE(itemSize))
+
+/* A queue of fixed-size elements, each sent with a priority.  Receivers always get the oldest
+   element of the highest priority present.  Elements of each priority are kept in their own
+	 FIFO list, and a bitmap records which lists are non-empty, so sending and receiving take
+	 constant time whatever the mix of priorities.
+
+	 'reserve' slots are kept for PQUEUE_URGENT elements: other senders wait once only that
+	 many slots are free, so routine traffic can never fill the queue against urgent traffic. */
+typedef struct {
+	OS_mutex_t mutex;
+	OS_cond_t notEmpty;         // receivers wait on this
+	OS_cond_t notFull;          // senders below PQUEUE_URGENT wait on this
+	OS_cond_t urgentSpace;      // PQUEUE_URGENT senders wait on this
+	uint8_t *buffer;            // PQUEUE_BUFFER_SIZE(capacity, itemSize) bytes
+	uint32_t capacity;          // maximum number of elements
+	uint32_t itemSize;          // size of one element in bytes
+	uint32_t reserve;           // slots only PQUEUE_URGENT elements may use
+	uint32_t volatile count;    // number of elements in the queue
+	uint32_t levels;            // bit n is set if there are elements of priority n
+	uint32_t free;              // first unused slot
+	uint32_t head[PQUEUE_PRIORITIES];
+	uint32_t tail[PQUEUE_PRIORITIES];
+} pqueue_t;
+
+/* Initialises a priority queue of 'capacity' elements of 'itemSize' bytes each, held in
+   'buffer' (see PQUEUE_BUFFER_SIZE), which must outlive the queue.  'reserve' must be less
+	 than 'capacity'. */
+void pqueueInit(pqueue_t *queue, void *buffer, uint32_t capacity, uint32_t itemSize, uint32_t reserve);
+/* Copies one element into the queue with the given priority, waiting for space if there is
+   none.  Priorities above PQUEUE_URGENT are treated as PQUEUE_URGENT. */
+void pqueueSend(pqueue_t *queue, void const *item, uint32_t priority);
+/* Copies the highest-priority element out of the queue into 'item', waiting for one if it
+   is empty, and returns its priority. */
+uint32_t pqueueReceive(pqueue_t *queue, void *item);
+/* Non-blocking send and receive.  They return zero, and do nothing, if there is no space
+   for the element or the queue is empty.  The receive puts the element's priority into
+	 'priority' if that isn't null. */
+uint32_t pqueueTrySend(pqueue_t *queue, void const *item, uint32_t priority);
+uint32_t pqueueTryReceive(pqueue_t *queue, void *item, uint32_t *priority);
+
+#endif /* PQUEUE_H */
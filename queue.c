@@ -1,57 +1,160 @@
 #include "queue.h"
+#include "isr.h"
+#include <string.h>
 
 #ifndef __STM32F3xx_H
 #include "stm32f3xx.h"
 #include <stdio.h>
 #endif
 
-/* This is an implementation of a Pointer Queue-Based Task
+/* This is an implementation of a Queue-Based Task
 	 communication system.
-	 
-	 The Queue uses a circular buffer to store pointers to 
-	 items in memory. 
-	 
-	 The queue is protected with a semaphore and a mutex. */
+
+	 The Queue uses a circular buffer to store copies of
+	 fixed-size elements, so small messages don't need to
+	 be allocated anywhere else.
+
+	 The queue is protected with a mutex.  Receivers wait on
+	 one condition variable and senders on another, so a send
+	 only wakes receivers and a receive only wakes senders.
+	 The N variants move a whole run of elements for the cost
+	 of one element. */
 
 /* Initialise the Queue */
-void queueInit(queue_t *queue){
+void queueInit(queue_t *queue, void *buffer, uint32_t capacity, uint32_t itemSize){
 	mutexInit(&queue->mutex);
-	semaphoreInit(&queue->semaphore, MAX_QUEUE_SIZE);
-	queue->insert=0;
-	queue->retrieve=0;
-	// Null all points int eh queue to protect from garbage
-	for(int i=0; i < MAX_QUEUE_SIZE; i++){
-		queue->data[i] = NULL;
+	condInit(&queue->notEmpty);
+	condInit(&queue->notFull);
+	queue->buffer = buffer;
+	queue->capacity = capacity;
+	queue->itemSize = itemSize;
+	queue->count = 0;
+	queue->insert = 0;
+	queue->retrieve = 0;
+	queue->set = 0;
+}
+
+/* Copies elements into the buffer at the insert position, wrapping around the end */
+static void queueCopyIn(queue_t *queue, uint8_t const *items, uint32_t count){
+	uint32_t first = queue->capacity - queue->insert;
+	if (first > count) {
+		first = count;
 	}
+	memcpy(queue->buffer + queue->insert * queue->itemSize, items, first * queue->itemSize);
+	memcpy(queue->buffer, items + first * queue->itemSize, (count - first) * queue->itemSize);
+	queue->insert = (queue->insert + count) % queue->capacity;
+	queue->count += count;
 }
 
-/* Send from the Queue */
-void queueSend(queue_t *queue, void* dataPtr) {
-	// Wait for space in the queue
-	semaphoreAquire(&queue->semaphore, 1);
-	void *dp = *(void **)dataPtr;
-	// Update the queue atomitcally
+/* Copies elements out of the buffer at the retrieve position, wrapping around the end */
+static void queueCopyOut(queue_t *queue, uint8_t *items, uint32_t count){
+	uint32_t first = queue->capacity - queue->retrieve;
+	if (first > count) {
+		first = count;
+	}
+	memcpy(items, queue->buffer + queue->retrieve * queue->itemSize, first * queue->itemSize);
+	memcpy(items + first * queue->itemSize, queue->buffer, (count - first) * queue->itemSize);
+	queue->retrieve = (queue->retrieve + count) % queue->capacity;
+	queue->count -= count;
+}
+
+/* Send to the Queue */
+void queueSendN(queue_t *queue, void const *items, uint32_t count) {
+	uint8_t const *next = items;
+	// Update the queue atomically
 	mutexAquire(&queue->mutex);
-	queue->data[queue->insert] = dp; 
-	queue->insert = (queue->insert + 1) % MAX_QUEUE_SIZE;
-	// Notify any readers that we have data
-	OS_notify((void *)queue);
-	mutexRelease(&queue->mutex);	
+	while (count) {
+		// Wait for space in the queue
+		while (queue->count == queue->capacity) {
+			condWait(&queue->notFull, &queue->mutex);
+		}
+		uint32_t space = queue->capacity - queue->count;
+		if (space > count) {
+			space = count;
+		}
+		queueCopyIn(queue, next, space);
+		next += space * queue->itemSize;
+		count -= space;
+		// Notify any readers that we have data
+		if (space == 1) {
+			condSignal(&queue->notEmpty);
+		} else {
+			condBroadcast(&queue->notEmpty);
+		}
+		if (queue->set) {
+			OS_notify((void *)queue->set);
+		}
+	}
+	mutexRelease(&queue->mutex);
+}
+
+void queueSend(queue_t *queue, void const *item) {
+	queueSendN(queue, item, 1);
 }
 
-/* Receive to the Queue*/
-void *queueReceive(queue_t *queue) {
-	// Check if there is data available
-	while(queue->insert == queue->retrieve){
-		OS_wait((void *)queue, currentCheckValue());
+/* Receive from the Queue */
+uint32_t queueReceiveN(queue_t *queue, void *items, uint32_t count) {
+	if (!count) {
+		return 0;
 	}
 	// Update the queue atomically
 	mutexAquire(&queue->mutex);
-	void* tmp = queue->data[queue->retrieve];
-	queue->data[queue->retrieve] = NULL;
-	// increase size based on max queue size. Prevents overflow
-	queue->retrieve = (queue->retrieve + 1) % MAX_QUEUE_SIZE;
-	semaphoreRelease(&queue->semaphore, 1);
+	// Wait for data to be available
+	while (queue->count == 0) {
+		condWait(&queue->notEmpty, &queue->mutex);
+	}
+	uint32_t available = queue->count;
+	if (available > count) {
+		available = count;
+	}
+	queueCopyOut(queue, items, available);
+	// Notify any senders that there is space
+	if (available == 1) {
+		condSignal(&queue->notFull);
+	} else {
+		condBroadcast(&queue->notFull);
+	}
+	mutexRelease(&queue->mutex);
+	return available;
+}
+
+void queueReceive(queue_t *queue, void *item) {
+	queueReceiveN(queue, item, 1);
+}
+
+/* Send to the Queue if there is space */
+uint32_t queueTrySend(queue_t *queue, void const *item) {
+	mutexAquire(&queue->mutex);
+	uint32_t const sent = queue->count != queue->capacity;
+	if (sent) {
+		queueCopyIn(queue, item, 1);
+		condSignal(&queue->notEmpty);
+		if (queue->set) {
+			OS_notify((void *)queue->set);
+		}
+	}
 	mutexRelease(&queue->mutex);
-	return tmp;
+	return sent;
+}
+
+/* Receive from the Queue if it isn't empty */
+uint32_t queueTryReceive(queue_t *queue, void *item) {
+	mutexAquire(&queue->mutex);
+	uint32_t const received = queue->count != 0;
+	if (received) {
+		queueCopyOut(queue, item, 1);
+		condSignal(&queue->notFull);
+	}
+	mutexRelease(&queue->mutex);
+	return received;
+}
+
+/* Send from an interrupt handler */
+uint32_t queueSendFromISR(queue_t *queue, void const *item) {
+	uint32_t value = 0;
+	if (queue->itemSize > sizeof(value)) {
+		return 0;
+	}
+	memcpy(&value, item, queue->itemSize);
+	return _isrPush(BATCH_QUEUE_SEND, (void *)queue, value);
 }
@@ -3,23 +3,48 @@
 
 #include <stddef.h>
 #include "mutex.h"
+#include "cond.h"
 #include "task.h"
 #include "os.h"
-#include "semaphore.h"
 
-#define MAX_QUEUE_SIZE 10
-	
+/* A queue of fixed-size elements, which are copied in and out by value.  The storage is
+   supplied by the caller when the queue is initialised, so each queue can have its own
+	 capacity and element size. */
 typedef struct {
 	OS_mutex_t mutex;
-	semaphore_t semaphore;
-	void *data[MAX_QUEUE_SIZE];
-	int insert;
-	int retrieve;
+	OS_cond_t notEmpty;         // receivers wait on this
+	OS_cond_t notFull;          // senders wait on this
+	uint8_t *buffer;            // capacity * itemSize bytes
+	uint32_t capacity;          // maximum number of elements
+	uint32_t itemSize;          // size of one element in bytes
+	uint32_t volatile count;    // number of elements in the queue
+	uint32_t insert;
+	uint32_t retrieve;
+	struct s_queueSet *set;     // queue set this queue belongs to, if any
 } queue_t;
 
-
-void queueInit(queue_t *queue);
-void *queueReceive(queue_t *queue);
-void queueSend(queue_t *queue, void* data);
+/* Initialises a queue of 'capacity' elements of 'itemSize' bytes each, held in 'buffer',
+   which must be at least capacity * itemSize bytes long and must outlive the queue. */
+void queueInit(queue_t *queue, void *buffer, uint32_t capacity, uint32_t itemSize);
+/* Copies one element into the queue, waiting for space if it is full */
+void queueSend(queue_t *queue, void const *item);
+/* Copies one element out of the queue into 'item', waiting for one if it is empty */
+void queueReceive(queue_t *queue, void *item);
+/* Copies 'count' elements into the queue.  As many as there is space for are added at a time,
+   with one lock and one wake-up, and the call waits for space until all have been added. */
+void queueSendN(queue_t *queue, void const *items, uint32_t count);
+/* Copies up to 'count' elements out of the queue with one lock and one wake-up.  Waits until
+   there is at least one element, and returns how many were received. */
+uint32_t queueReceiveN(queue_t *queue, void *items, uint32_t count);
+/* Non-blocking send and receive.  They return zero, and do nothing, if the queue is full or
+   empty.  They still take the queue's mutex, so they may wait briefly for another task to
+	 finish with the queue. */
+uint32_t queueTrySend(queue_t *queue, void const *item);
+uint32_t queueTryReceive(queue_t *queue, void *item);
+/* Interrupt-safe send; never blocks.  Only for queues whose elements are at most 4 bytes,
+   because the element is copied into the interrupt request.  The element is added by
+	 PendSV, and is dropped (see isrDropped()) if the queue is full by then.  Returns zero if
+	 the request couldn't be queued. */
+uint32_t queueSendFromISR(queue_t *queue, void const *item);
 
 #endif /* QUEUE_H */
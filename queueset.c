@@ -0,0 +1,68 @@
+#include "queueset.h"
+
+/* This is an implementation of Queue Sets.
+
+	 A task can only wait for one reason at a time, so every
+	 queue and semaphore that is in a set also notifies the
+	 set whenever it gains an element or a permit.  A task
+	 selecting from the set waits on the set itself, and
+	 when it is woken looks for a member that is ready.
+	 Nothing is polled: the task only runs when a member
+	 has changed. */
+
+/* Initialise the Queue Set */
+void queueSetInit(queueSet_t *set) {
+	set->count = 0;
+	set->next = 0;
+}
+
+static uint32_t queueSetAdd(queueSet_t *set, uint32_t type, void *object) {
+	if (set->count == QUEUE_SET_MAX_MEMBERS) {
+		return 0;
+	}
+	set->members[set->count].type = type;
+	set->members[set->count].object = object;
+	set->count++;
+	return 1;
+}
+
+uint32_t queueSetAddQueue(queueSet_t *set, queue_t *queue) {
+	if (queue->set || !queueSetAdd(set, QUEUE_SET_QUEUE, queue)) {
+		return 0;
+	}
+	queue->set = set;
+	return 1;
+}
+
+uint32_t queueSetAddSemaphore(queueSet_t *set, semaphore_t *semaphore) {
+	if (semaphore->set || !queueSetAdd(set, QUEUE_SET_SEMAPHORE, semaphore)) {
+		return 0;
+	}
+	semaphore->set = set;
+	return 1;
+}
+
+/* Returns non-zero if a member could be received from or acquired without waiting */
+static uint32_t queueSetMemberReady(queueSetMember_t const *member) {
+	if (member->type == QUEUE_SET_QUEUE) {
+		return ((queue_t *)member->object)->count != 0;
+	}
+	return ((semaphore_t *)member->object)->permits != 0;
+}
+
+/* Select from the Queue Set */
+void *queueSetSelect(queueSet_t *set) {
+	while (1) {
+		// Take the check value first, so a member that becomes ready during the search isn't missed
+		uint32_t checkValue = currentCheckValue();
+		for (uint32_t i = 0; i < set->count; i++) {
+			uint32_t index = (set->next + i) % set->count;
+			if (queueSetMemberReady(&set->members[index])) {
+				set->next = (index + 1) % set->count;
+				return set->members[index].object;
+			}
+		}
+		// Nothing is ready. Wait for any member to notify the set
+		OS_wait((void *)set, checkValue);
+	}
+}
@@ -0,0 +1,40 @@
+#ifndef QUEUESET_H
+#define QUEUESET_H
+
+#include <stdint.h>
+#include "queue.h"
+#include "semaphore.h"
+
+/* Maximum number of queues and semaphores in one set */
+#define QUEUE_SET_MAX_MEMBERS 8
+
+/* Kinds of object that can be members of a set */
+typedef enum {
+	QUEUE_SET_QUEUE,
+	QUEUE_SET_SEMAPHORE
+} queueSetMember_e;
+
+typedef struct {
+	uint32_t type;
+	void *object;
+} queueSetMember_t;
+
+/* A set of queues and semaphores that a task can wait on all at once */
+typedef struct s_queueSet {
+	queueSetMember_t members[QUEUE_SET_MAX_MEMBERS];
+	uint32_t count;
+	uint32_t next;   // member to look at first, so that a busy member can't starve the others
+} queueSet_t;
+
+void queueSetInit(queueSet_t *set);
+/* Add a queue or a semaphore to a set.  An object can be in at most one set, and should be
+   added before any task uses it.  Returns zero if the set is full or the object is already
+	 in a set. */
+uint32_t queueSetAddQueue(queueSet_t *set, queue_t *queue);
+uint32_t queueSetAddSemaphore(queueSet_t *set, semaphore_t *semaphore);
+/* Waits until a member has an element (queues) or a permit (semaphores), and returns that
+   member.  The caller then receives from or acquires it as normal, which won't block unless
+	 another task got there first. */
+void *queueSetSelect(queueSet_t *set);
+
+#endif /* QUEUESET_H */
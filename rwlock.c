@@ -0,0 +1,76 @@
+#include "rwlock.h"
+#ifndef __STM32F3xx_H
+#include "stm32f3xx.h"
+#endif
+
+/* This is an implementation of a Reader-Writer Lock
+	 with writer preference.
+
+	 The whole state of the lock is one word, changed with
+	 exclusive loads and stores, so taking and releasing it
+	 without contention never enters the kernel.  Tasks that
+	 can't have the lock wait on it with OS_wait(), and are
+	 woken with OS_notify() when the last reader or the
+	 writer lets go. */
+
+/* Initialise the Reader-Writer Lock */
+void rwlockInit(OS_rwlock_t *lock) {
+	lock->state = 0;
+}
+
+/* Atomically adds 'delta' to the state, and returns the new state */
+static uint32_t rwlockAdd(OS_rwlock_t *lock, uint32_t delta) {
+	uint32_t state;
+	do {
+		state = __LDREXW((uint32_t *) &lock->state) + delta;
+	} while (__STREXW(state, (uint32_t *) &lock->state));
+	return state;
+}
+
+/* Aquire the lock for reading */
+void rwlockReadAquire(OS_rwlock_t *lock) {
+	while (1) {
+		// Take the check value before looking at the lock, so a release in between isn't missed
+		uint32_t checkValue = currentCheckValue();
+		uint32_t state = __LDREXW((uint32_t *) &lock->state);
+		if (state & (RWLOCK_WRITER | RWLOCK_WAITING_MASK)) {
+			// A writer has the lock or is waiting for it, so it goes first
+			__CLREX();
+			OS_wait((void *) lock, checkValue);
+		} else if (__STREXW(state + 1, (uint32_t *) &lock->state) == 0) {
+			break;
+		}
+	}
+}
+
+/* Release the lock after reading */
+void rwlockReadRelease(OS_rwlock_t *lock) {
+	uint32_t state = rwlockAdd(lock, (uint32_t) -1);
+	// The last reader out lets a waiting writer in
+	if ((state & RWLOCK_READERS_MASK) == 0 && (state & RWLOCK_WAITING_MASK)) {
+		OS_notify((void *) lock);
+	}
+}
+
+/* Aquire the lock for writing */
+void rwlockWriteAquire(OS_rwlock_t *lock) {
+	// Registering as a waiting writer stops any more readers getting in
+	rwlockAdd(lock, RWLOCK_WAITING_ONE);
+	while (1) {
+		uint32_t checkValue = currentCheckValue();
+		uint32_t state = __LDREXW((uint32_t *) &lock->state);
+		if (state & (RWLOCK_WRITER | RWLOCK_READERS_MASK)) {
+			__CLREX();
+			OS_wait((void *) lock, checkValue);
+		} else if (__STREXW(state - RWLOCK_WAITING_ONE + RWLOCK_WRITER, (uint32_t *) &lock->state) == 0) {
+			break;
+		}
+	}
+}
+
+/* Release the lock after writing */
+void rwlockWriteRelease(OS_rwlock_t *lock) {
+	rwlockAdd(lock, (uint32_t) -RWLOCK_WRITER);
+	// Wake everyone: the next waiting writer gets the lock, or if there isn't one, all the readers
+	OS_notify((void *) lock);
+}
@@ -0,0 +1,27 @@
+#ifndef RWLOCK_H
+#define RWLOCK_H
+
+#include <stdint.h>
+#include "task.h"
+#include "os.h"
+
+/* Fields of the reader-writer lock state word */
+#define RWLOCK_READERS_MASK  0x0000FFFFUL   // number of tasks holding the lock for reading
+#define RWLOCK_WAITING_ONE   0x00010000UL   // one writer waiting for the lock
+#define RWLOCK_WAITING_MASK  0x7FFF0000UL
+#define RWLOCK_WRITER        0x80000000UL   // a task holds the lock for writing
+
+/* A reader-writer lock.  Any number of tasks can hold it for reading at once, or one task
+   can hold it for writing.  Writers take priority: once a writer is waiting, no more readers
+	 are let in.  Unlike OS_mutex_t it is not recursive. */
+typedef struct {
+	uint32_t volatile state;
+} OS_rwlock_t;
+
+void rwlockInit(OS_rwlock_t *lock);
+void rwlockReadAquire(OS_rwlock_t *lock);
+void rwlockReadRelease(OS_rwlock_t *lock);
+void rwlockWriteAquire(OS_rwlock_t *lock);
+void rwlockWriteRelease(OS_rwlock_t *lock);
+
+#endif /* RWLOCK_H */
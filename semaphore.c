@@ -1,4 +1,5 @@
 #include "semaphore.h"
+#include "isr.h"
 #ifndef __STM32F3xx_H
 #include "stm32f3xx.h"
 #include <stdio.h>
@@ -7,29 +8,58 @@
 /* This is an implementation of a Counting Semaphore.
 	 
 	 The semaphore initialises a set of permits which 
-	 are protected by a acquiring a mutex. */
+	 are protected by a acquiring a mutex.  Tasks wait for
+	 permits on a condition variable, so a release can't
+	 slip in between the test and the wait. */
 
 /* Initialise the Semaphore*/
 void semaphoreInit(semaphore_t *semaphore, uint32_t permits) {
 	semaphore->permits = permits;
 	mutexInit(&semaphore->mutex);
+	condInit(&semaphore->available);
+	semaphore->set = 0;
+#if LOCKSTAT_ENABLED
+	lockstatObjectInit(&semaphore->stats);
+#endif
 }
 
 /* Aquire the Semaphore*/
 void semaphoreAquire(semaphore_t *semaphore, uint32_t permits){
-	while(1){
-		// Check if there are enough permits for this acquire
-		if (semaphore->permits - permits <= 0){
-		// If there aren't any permits. Task will wait until a permit becomes avaliable
-			OS_wait((void *) semaphore, currentCheckValue());
-		}else {
-		// If there are enough permits. Remove permit and return
-			mutexAquire(&semaphore->mutex);
-			semaphore->permits -= permits;
-			mutexRelease(&semaphore->mutex);
-			break;
-		}	
+#if LOCKSTAT_ENABLED
+	lockstatWait_t wait = {0};
+#endif
+	// Test and take the permits under the mutex, so two tasks can't both take the last ones
+	mutexAquire(&semaphore->mutex);
+	while (semaphore->permits < permits) {
+		// If there aren't enough permits. Task will wait until a permit becomes avaliable
+#if LOCKSTAT_ENABLED
+		// Permits have no owner, so there is nobody to blame
+		lockstatWaiting(&wait, 0);
+#endif
+		condWait(&semaphore->available, &semaphore->mutex);
 	}
+	// If there are enough permits. Remove permit and return
+	semaphore->permits -= permits;
+#if LOCKSTAT_ENABLED
+	// Updated under the mutex, since several tasks can hold permits at once
+	lockstatAcquired(&semaphore->stats, &wait);
+#endif
+	mutexRelease(&semaphore->mutex);
+}
+
+/* Aquire the Semaphore without waiting for permits */
+uint32_t semaphoreTryAquire(semaphore_t *semaphore, uint32_t permits){
+	mutexAquire(&semaphore->mutex);
+	uint32_t const acquired = semaphore->permits >= permits;
+	if (acquired) {
+		semaphore->permits -= permits;
+#if LOCKSTAT_ENABLED
+		lockstatWait_t const wait = {0};
+		lockstatAcquired(&semaphore->stats, &wait);
+#endif
+	}
+	mutexRelease(&semaphore->mutex);
+	return acquired;
 }
 
 /* Release the Semaphore*/
@@ -37,7 +67,15 @@ void semaphoreRelease(semaphore_t *semaphore, uint32_t permits){
 	mutexAquire(&semaphore->mutex);
 	// Add a permit back to the semaphore
 	semaphore->permits += permits;
+	// Wake every waiting task, since each may want a different number of permits
+	condBroadcast(&semaphore->available);
 	mutexRelease(&semaphore->mutex);
-	// Notify any waiting tasks that there are permits available
-	OS_notify((void *) semaphore);
+	if (semaphore->set) {
+		OS_notify((void *) semaphore->set);
+	}
+}
+
+/* Release the Semaphore from an interrupt handler. The release is carried out by PendSV. */
+uint32_t semaphoreReleaseFromISR(semaphore_t *semaphore, uint32_t permits){
+	return _isrPush(BATCH_SEMAPHORE_RELEASE, (void *) semaphore, permits);
 }
@@ -3,16 +3,27 @@
 
 #include <stddef.h>
 #include "mutex.h"
+#include "cond.h"
 #include "task.h"
 #include "os.h"
 
 typedef struct {
 	uint32_t permits; 
 	OS_mutex_t mutex;
+	OS_cond_t available;      // broadcast when permits are released
+	struct s_queueSet *set;   // queue set this semaphore belongs to, if any
+#if LOCKSTAT_ENABLED
+	lockstat_t stats;         // waits for permits; the mutex has its own
+#endif
 } semaphore_t; 
 
 void semaphoreInit(semaphore_t *semaphore, uint32_t permits);
 void semaphoreAquire(semaphore_t *semaphore, uint32_t permits);
 void semaphoreRelease(semaphore_t *semaphore, uint32_t permits);
+/* Takes the permits if they are all available, and returns non-zero; otherwise returns zero
+   without waiting. */
+uint32_t semaphoreTryAquire(semaphore_t *semaphore, uint32_t permits);
+/* Interrupt-safe release; never blocks.  Returns zero if the request couldn't be queued. */
+uint32_t semaphoreReleaseFromISR(semaphore_t *semaphore, uint32_t permits);
 
 #endif /* SEMAPHORE_H */
@@ -0,0 +1,60 @@
+#include "seqlock.h"
+#include <string.h>
+#ifndef __STM32F3xx_H
+#include "stm32f3xx.h"
+#endif
+
+/* This is an implementation of a Sequence Lock.
+
+	 The writer increments the sequence number before and
+	 after each update, so it is odd while the data is
+	 changing.  Readers copy the data without any locking,
+	 and check afterwards that the sequence number was even
+	 and hasn't moved; if it has, they copy it again.  The
+	 barriers keep the data accesses between the two
+	 sequence number accesses. */
+
+/* Initialise the Seqlock */
+void seqlockInit(seqlock_t *lock) {
+	lock->sequence = 0;
+}
+
+void seqlockWriteBegin(seqlock_t *lock) {
+	lock->sequence = lock->sequence + 1;
+	__DMB();
+}
+
+void seqlockWriteEnd(seqlock_t *lock) {
+	__DMB();
+	lock->sequence = lock->sequence + 1;
+}
+
+uint32_t seqlockReadBegin(seqlock_t const *lock) {
+	uint32_t start = lock->sequence;
+	// A write is in progress.  The writer can't finish until it runs again, so let it
+	while (start & 1) {
+		OS_yield();
+		start = lock->sequence;
+	}
+	__DMB();
+	return start;
+}
+
+uint32_t seqlockReadRetry(seqlock_t const *lock, uint32_t start) {
+	__DMB();
+	return lock->sequence != start;
+}
+
+void seqlockWrite(seqlock_t *lock, void *shared, void const *data, size_t size) {
+	seqlockWriteBegin(lock);
+	memcpy(shared, data, size);
+	seqlockWriteEnd(lock);
+}
+
+void seqlockRead(seqlock_t const *lock, void *data, void const *shared, size_t size) {
+	uint32_t start;
+	do {
+		start = seqlockReadBegin(lock);
+		memcpy(data, shared, size);
+	} while (seqlockReadRetry(lock, start));
+}
@@ -0,0 +1,33 @@
+#ifndef SEQLOCK_H
+#define SEQLOCK_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include "os.h"
+
+/* A sequence lock, for data with one writer that is read far more often than it is written.
+   The sequence number is odd while a write is in progress. */
+typedef struct {
+	uint32_t volatile sequence;
+} seqlock_t;
+
+void seqlockInit(seqlock_t *lock);
+
+/* Writer side.  Never blocks.  There must only be one writer at a time (it may be an
+   interrupt handler); several writers need a mutex of their own to take turns. */
+void seqlockWriteBegin(seqlock_t *lock);
+void seqlockWriteEnd(seqlock_t *lock);
+
+/* Reader side.  Never blocks and never enters the kernel, unless a reader catches a task
+   part way through a write, in which case it yields to let the writer finish.  Readers must
+	 not run in interrupt handlers if the writer is a task.  Usage:
+	   do { start = seqlockReadBegin(&lock); copy = shared; } while (seqlockReadRetry(&lock, start)); */
+uint32_t seqlockReadBegin(seqlock_t const *lock);
+/* Returns non-zero if the data read since seqlockReadBegin() may be inconsistent */
+uint32_t seqlockReadRetry(seqlock_t const *lock, uint32_t start);
+
+/* Copy 'size' bytes between shared data protected by the lock and a private buffer */
+void seqlockWrite(seqlock_t *lock, void *shared, void const *data, size_t size);
+void seqlockRead(seqlock_t const *lock, void *data, void const *shared, size_t size);
+
+#endif /* SEQLOCK_H */
@@ -1,27 +1,34 @@
 #include "simpleRoundRobin.h"
+#include "waittable.h"
 #ifndef __STM32F3xx_H
 #include "stm32f3xx.h"
 #endif
-/* This is an implementation of an extremely simple (and inefficient!) round-robin scheduler.
+/* This is an implementation of an extremely simple round-robin scheduler.
 
-   An array of pointers to TCBs is declared, and when tasks are added they are inserted into
-	 this array.  When tasks finish, they are removed from the array (pointers are set back to
-	 zero).  When the scheduler is invoked, it simply looks for the next available non-zero
-	 pointer in the array, and returns it.  If there are no non-zero TCB pointers in the array,
-	 a pointer to the idle task is returned instead.
-	 
-	 The inefficiency in this implementation arises mainly from the way arrays are used for list
-	 storage.  If the array is large and the number of tasks is small, the scheduler will spend
-	 a lot of time looking through the array each time it is called. */
+   Tasks are kept on intrusive lists linked through their TCBs: a ready list, a sleep list
+	 in wake-up order, and a wait table (see waittable.h) where tasks are woken in the order
+	 they started waiting.  The task at the head of the ready list is the one
+	 that runs; each time the scheduler is invoked the running task is moved to the back of
+	 the list (or onto the sleep list) and the new head is returned.  If the ready list is
+	 empty, a pointer to the idle task is returned instead.
+
+	 No operation looks at more than the tasks it moves, so the cost of scheduling doesn't depend
+	 on how many tasks there are, and there is no fixed limit on the number of tasks. */
 
 /* Prototypes (functions are static, so these aren't in the header file) */
 static OS_TCB_t const * simpleRoundRobin_scheduler(void);
-static void simpleRoundRobin_addTask(OS_TCB_t * const tcb);
+static uint32_t simpleRoundRobin_addTask(OS_TCB_t * const tcb);
 static void simpleRoundRobin_taskExit(OS_TCB_t * const tcb);
 static void simpleRoundRobin_wait(void* const reason, uint32_t checkCode);
 static void simpleRoundRobin_notify(void* const reason);
+static uint32_t simpleRoundRobin_notifyOne(void* const reason);
+static uint32_t simpleRoundRobin_nextWake(uint32_t now);
+
+static OS_list_t readyList = OS_LIST_INIT(readyList);
+static OS_list_t sleepList = OS_LIST_INIT(sleepList);
+static OS_waitTable_t waitTable = OS_WAIT_TABLE_INIT;
 
-static OS_TCB_t * tasks[SIMPLE_RR_MAX_TASKS] = {0};
+#define TASK_OF(node) OS_LIST_ENTRY(node, OS_TCB_t, schedNode)
 
 /* Scheduler block for the simple round-robin */
 OS_Scheduler_t const simpleRoundRobinScheduler = {
@@ -30,55 +37,79 @@ OS_Scheduler_t const simpleRoundRobinScheduler = {
 	.addtask_callback = simpleRoundRobin_addTask,
 	.taskexit_callback = simpleRoundRobin_taskExit,
 	.wait_callback = simpleRoundRobin_wait,
-	.notify_callback = simpleRoundRobin_notify 
+	.notify_callback = simpleRoundRobin_notify,
+	.notifyone_callback = simpleRoundRobin_notifyOne,
+	.nextwake_callback = simpleRoundRobin_nextWake
 };
 
 
+/* Puts a task on the sleep list, behind any task that is due to wake at the same time or earlier */
+static void sleepListInsert(OS_TCB_t * const task) {
+	OS_listNode_t *position = sleepList.prev;
+	while (position != &sleepList && OS_tickBefore(task->data, TASK_OF(position)->data)) {
+		position = position->prev;
+	}
+	OS_listInsertBefore(position->next, &task->schedNode);
+}
+
 /* Round-robin scheduler callback */
 static OS_TCB_t const * simpleRoundRobin_scheduler(void) {
-	static int i = 0;
+	OS_TCB_t *current = OS_currentTCB();
 	// Clear the yield flag if it's set - we simply don't care
-	OS_currentTCB()->state &= ~TASK_STATE_YIELD;
-	for (int j = 1; j <= SIMPLE_RR_MAX_TASKS; j++) {
-		i = (i + 1) % SIMPLE_RR_MAX_TASKS;
-		if (tasks[i] != 0 && !(tasks[i]->state & TASK_STATE_WAIT)) {
-			//skip if in a wait state 
-		
-			if (tasks[i]->state & TASK_STATE_SLEEP) {
-				//check if the right amount of time has elapsed 
-				if (tasks[i]->data < OS_elapsedTicks()){
-						tasks[i]->state &= ~TASK_STATE_SLEEP;
-						return tasks[i];
-				}	
-			}
-			else {
-				return tasks[i];
-			}
+	current->state &= ~TASK_STATE_YIELD;
+	// Move the running task out of the way, unless it has already left the ready list
+	if (!OS_listIsEmpty(&readyList) && TASK_OF(readyList.next) == current) {
+		OS_listRemove(&current->schedNode);
+		if (current->state & TASK_STATE_SLEEP) {
+			sleepListInsert(current);
 		}
+		else {
+			OS_listPushBack(&readyList, &current->schedNode);
+		}
+	}
+	//check if the right amount of time has elapsed for the earliest sleepers
+	while (!OS_listIsEmpty(&sleepList) && OS_tickBefore(TASK_OF(sleepList.next)->data, OS_elapsedTicks())) {
+		OS_TCB_t *task = TASK_OF(sleepList.next);
+		OS_listRemove(&task->schedNode);
+		task->state &= ~TASK_STATE_SLEEP;
+		// Put it at the front of the ready list, so that it runs next
+		OS_listInsertBefore(readyList.next, &task->schedNode);
+	}
+	if (!OS_listIsEmpty(&readyList)) {
+		return TASK_OF(readyList.next);
 	}
 	// No tasks in the list, so return the idle task
 	return OS_idleTCB_p;
 }
 
+/* 'Next wake' callback: sleepers are woken on the first tick after their wake-up time */
+static uint32_t simpleRoundRobin_nextWake(uint32_t now) {
+	if (OS_listIsEmpty(&sleepList)) {
+		return 0xFFFFFFFF;
+	}
+	uint32_t const wake = TASK_OF(sleepList.next)->data;
+	return OS_tickBefore(wake, now) ? 0 : wake + 1 - now;
+}
+
 /* 'Add task' callback */
-static void simpleRoundRobin_addTask(OS_TCB_t * const tcb) {
-	for (int i = 0; i < SIMPLE_RR_MAX_TASKS; i++) {
-		if (tasks[i] == 0) {
-			tasks[i] = tcb;
-			return;
-		}
+static uint32_t simpleRoundRobin_addTask(OS_TCB_t * const tcb) {
+	// A task can only be added once
+	if (OS_listIsLinked(&tcb->schedNode)) {
+		return 0;
 	}
-	// If we get here, there are no free TCB slots, so the task just won't be added
+	OS_listPushBack(&readyList, &tcb->schedNode);
+	return 1;
 }
 
 /* 'Task exit' callback */
 static void simpleRoundRobin_taskExit(OS_TCB_t * const tcb) {
-	// Remove the given TCB from the list of tasks so it won't be run again
-	for (int i = 0; i < SIMPLE_RR_MAX_TASKS; i++) {
-		if (tasks[i] == tcb) {
-			tasks[i] = 0;
-		}
-	}	
+	// Remove the given TCB from whichever list it is on so it won't be run again
+	if (tcb->state & TASK_STATE_WAIT) {
+		OS_waitTableRemove(&waitTable, tcb);
+	}
+	else if (OS_listIsLinked(&tcb->schedNode)) {
+		OS_listRemove(&tcb->schedNode);
+	}
 }
 
 static void simpleRoundRobin_wait(void* const reason, uint32_t checkCode){
@@ -86,8 +117,11 @@ static void simpleRoundRobin_wait(void* const reason, uint32_t checkCode){
 	//check code 
 
 	if(checkCode == currentCheckValue()){
-		OS_currentTCB()->data = (uint32_t)reason; 
-		OS_currentTCB()->state |= TASK_STATE_WAIT; //Waiting state 
+		OS_TCB_t *task = OS_currentTCB();
+		task->data = (uint32_t)reason; 
+		task->state |= TASK_STATE_WAIT; //Waiting state 
+		OS_listRemove(&task->schedNode);
+		OS_waitTableInsert(&waitTable, task, 0);
 		SCB->ICSR = SCB_ICSR_PENDSVSET_Msk;
 	}
 	else {
@@ -95,13 +129,24 @@ static void simpleRoundRobin_wait(void* const reason, uint32_t checkCode){
 	}
 	
 }
+/* Moves a task taken from the wait table back to the ready list */
+static void waitTableWake(OS_TCB_t * const task) {
+	task->state &= ~TASK_STATE_WAIT;
+	task->data = 0;
+	OS_listPushBack(&readyList, &task->schedNode);
+}
+
 static void simpleRoundRobin_notify(void* const reason){
-		for (int i = 0; i < SIMPLE_RR_MAX_TASKS; i++) {
-		if (tasks[i] != 0) {
-			if ((tasks[i]->state & TASK_STATE_WAIT) && (tasks[i]->data == (uint32_t)reason)) {
-					tasks[i]->state &= ~TASK_STATE_WAIT;
-					tasks[i]->data = 0;
-				}
-		}
+	OS_TCB_t *task;
+	while ((task = OS_waitTableTake(&waitTable, reason)) != 0) {
+		waitTableWake(task);
+	}
+}
+static uint32_t simpleRoundRobin_notifyOne(void* const reason){
+	OS_TCB_t * const task = OS_waitTableTake(&waitTable, reason);
+	if (task) {
+		waitTableWake(task);
+		return 1;
 	}
+	return 0;
 }
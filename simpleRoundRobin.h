@@ -3,9 +3,6 @@
 
 #include "os.h"
 
-// How many tasks can this scheduler cope with?
-#define SIMPLE_RR_MAX_TASKS 8
-
 extern OS_Scheduler_t const simpleRoundRobinScheduler;
 
 #endif /* __simpleRoundRobin_h__ */
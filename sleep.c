@@ -8,3 +8,15 @@ void OS_sleep(uint32_t sleepTime){
 	OS_currentTCB()->state = TASK_STATE_SLEEP;
 	OS_yield(); 
 }
+
+void OS_sleepUs(uint32_t us){
+	uint64_t const deadline = OS_nowUs() + us;
+	uint32_t const ticks = us / OS_TICK_US;
+	// OS_sleep(n) returns on the first tick more than n ticks after it was called (unless
+	// another task woken on the same tick runs first), so this doesn't overshoot
+	if (ticks) {
+		OS_sleep(ticks - 1);
+	}
+	while (OS_nowUs() < deadline) {
+	}
+}
@@ -4,4 +4,9 @@
 
 void OS_sleep(uint32_t num); 
 
+/* Sleeps for at least 'us' microseconds.  Whole ticks are slept through; the final part of a
+   tick is waited out on OS_nowUs(), which keeps the CPU busy, so short delays are precise
+	 but not free. */
+void OS_sleepUs(uint32_t us);
+
 #endif /* SLEEP_H */
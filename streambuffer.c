@@ -0,0 +1,93 @@
+#include "streambuffer.h"
+#include "isr.h"
+
+/* This is an implementation of a Stream Buffer.
+
+	 The writer (usually a DMA channel in circular mode) fills
+	 the buffer on its own, and its interrupt handlers only
+	 report how far it has got.  The reader is given pointers
+	 straight into the buffer, so no byte is ever copied.
+
+	 The reader is only woken, with OS_notifyFromISR(), when
+	 it is blocked and there is enough data for it: at least
+	 the trigger level, or anything at all once the writer
+	 has gone idle. */
+
+/* Initialise the Stream Buffer */
+void streamBufferInit(streamBuffer_t *stream, uint8_t *buffer, uint32_t size, uint32_t trigger) {
+	stream->buffer = buffer;
+	stream->size = size;
+	stream->head = 0;
+	stream->tail = 0;
+	stream->trigger = trigger ? trigger : 1;
+	stream->flushed = 0;
+	stream->waiting = 0;
+	stream->overruns = 0;
+}
+
+void streamBufferSetTrigger(streamBuffer_t *stream, uint32_t trigger) {
+	stream->trigger = trigger ? trigger : 1;
+}
+
+/* Returns non-zero if the reader has enough to be woken for */
+static uint32_t streamBufferReady(streamBuffer_t const *stream) {
+	uint32_t const available = stream->head - stream->tail;
+	// The writer went idle after the oldest unread byte arrived
+	uint32_t const idle = (int32_t)(stream->flushed - stream->tail) > 0;
+	return available >= stream->trigger || (available && idle);
+}
+
+/* Peek at the Stream Buffer */
+uint32_t streamBufferPeek(streamBuffer_t *stream, uint8_t const **data) {
+	uint32_t available = stream->head - stream->tail;
+	if (available > stream->size) {
+		// The writer has overwritten bytes that weren't read yet
+		stream->overruns++;
+		stream->tail = stream->head;
+		available = 0;
+	}
+	uint32_t const offset = stream->tail & (stream->size - 1);
+	if (available > stream->size - offset) {
+		available = stream->size - offset;
+	}
+	*data = stream->buffer + offset;
+	return available;
+}
+
+/* Read from the Stream Buffer */
+uint32_t streamBufferRead(streamBuffer_t *stream, uint8_t const **data) {
+	while (1) {
+		// Take the check value first, so data arriving between the test and the wait isn't missed
+		uint32_t checkValue = currentCheckValue();
+		stream->waiting = 1;
+		if (streamBufferReady(stream)) {
+			stream->waiting = 0;
+			uint32_t available = streamBufferPeek(stream, data);
+			if (available) {
+				return available;
+			}
+			// Everything was lost to an overrun; wait for fresh data
+			continue;
+		}
+		OS_wait((void *)stream, checkValue);
+	}
+}
+
+/* Consume from the Stream Buffer */
+void streamBufferConsume(streamBuffer_t *stream, uint32_t count) {
+	uint32_t const available = stream->head - stream->tail;
+	stream->tail += (count < available) ? count : available;
+}
+
+/* Report progress from the writer */
+void streamBufferWritten(streamBuffer_t *stream, uint32_t position, uint32_t idle) {
+	uint32_t const mask = stream->size - 1;
+	stream->head += (position - stream->head) & mask;
+	if (idle) {
+		stream->flushed = stream->head;
+	}
+	if (stream->waiting && streamBufferReady(stream)) {
+		stream->waiting = 0;
+		OS_notifyFromISR((void *)stream);
+	}
+}
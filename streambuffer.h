@@ -0,0 +1,42 @@
+#ifndef STREAMBUFFER_H
+#define STREAMBUFFER_H
+
+#include <stdint.h>
+#include "os.h"
+
+/* A byte stream written by an interrupt handler or DMA, and read in place by one task.
+
+   'head' and 'tail' count every byte ever written and consumed, so they are free to wrap
+	 and the amount of data in the buffer is always head - tail. */
+typedef struct {
+	uint8_t *buffer;
+	uint32_t size;                // must be a power of two
+	uint32_t volatile head;       // bytes written
+	uint32_t tail;                // bytes consumed
+	uint32_t trigger;             // bytes needed to wake the reader
+	uint32_t volatile flushed;    // value of head when the writer last went idle
+	uint32_t volatile waiting;    // set while the reader is blocked
+	uint32_t overruns;            // number of times the writer overtook the reader
+} streamBuffer_t;
+
+/* Initialises a stream buffer over 'size' bytes at 'buffer'.  The reader is woken when at
+   least 'trigger' bytes are waiting, or when the writer goes idle with fewer. */
+void streamBufferInit(streamBuffer_t *stream, uint8_t *buffer, uint32_t size, uint32_t trigger);
+void streamBufferSetTrigger(streamBuffer_t *stream, uint32_t trigger);
+
+/* Reader side.  Peek and read give a pointer to the oldest unconsumed bytes, in place in the
+   buffer, and return how many contiguous bytes it points to (there may be more after the end
+	 of the buffer wraps around).  Peek never blocks; read waits until the trigger level is
+	 reached or the writer has gone idle.  The bytes stay in the buffer until they are consumed.
+	 If the writer has overtaken the reader, everything unread is discarded and 'overruns' is
+	 incremented. */
+uint32_t streamBufferPeek(streamBuffer_t *stream, uint8_t const **data);
+uint32_t streamBufferRead(streamBuffer_t *stream, uint8_t const **data);
+void streamBufferConsume(streamBuffer_t *stream, uint32_t count);
+
+/* Writer side, for interrupt handlers.  Reports that the writer has filled the buffer up to
+   (but not including) offset 'position', and whether it has now gone idle.  Must be called at
+	 least once for every half of the buffer that is filled. */
+void streamBufferWritten(streamBuffer_t *stream, uint32_t position, uint32_t idle);
+
+#endif /* STREAMBUFFER_H */
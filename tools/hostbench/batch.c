@@ -0,0 +1,114 @@
+/* Batched kernel calls (batchSubmit()) against the same operations called one at a time.
+
+   For every batch size N from 1 to BATCH_MAX, a task carries out N operations, taking turns
+	 between releasing a semaphore, sending to a queue and notifying a reason, each on its own
+	 object, first with the ordinary calls and then as one batch.  The median host time and
+	 the kernel entries for each round are printed.  A batch must take exactly one SVC when
+	 nothing blocks, whatever its size. */
+
+#include <stdio.h>
+#include "hostport.h"
+#include "FixedPriorityScheduler.h"
+#include "batch.h"
+#include "semaphore.h"
+#include "queue.h"
+
+#define BATCH_MAX 16
+#define BATCH_ROUNDS 5000
+
+static OS_TCB_t _benchTCB;
+static uint32_t _benchStack[512] __attribute__((aligned(8)));
+
+static semaphore_t _semaphores[BATCH_MAX];
+static queue_t _queues[BATCH_MAX];
+static uint32_t _queueStorage[BATCH_MAX][4];
+static uint32_t _reasons[BATCH_MAX];
+static batchOp_t _ops[BATCH_MAX];
+static uint64_t _samples[BATCH_ROUNDS];
+
+/* Empties the queues without going through the kernel, so every round sends to empty queues */
+static void batchResetQueues(uint32_t count) {
+	for (uint32_t i = 0; i < count; i++) {
+		queueInit(&_queues[i], _queueStorage[i], 4, sizeof(uint32_t));
+	}
+}
+
+static void batchIndividual(uint32_t count) {
+	for (uint32_t i = 0; i < count; i++) {
+		switch (i % 3) {
+			case 0:
+				semaphoreRelease(&_semaphores[i], 1);
+				break;
+			case 1:
+				queueSend(&_queues[i], &i);
+				break;
+			default:
+				OS_notify(&_reasons[i]);
+				break;
+		}
+	}
+}
+
+static void batchBatched(uint32_t count) {
+	batchSubmit(_ops, count);
+}
+
+/* Times BATCH_ROUNDS rounds of 'count' operations, and returns the median in ns and
+   the SVCs per round */
+static uint64_t batchMeasure(void (* round)(uint32_t), uint32_t count, double * svcs) {
+	hostSummary_t summary;
+	hostCounters_t before, after;
+	uint64_t roundSvcs = 0;
+	for (uint32_t i = 0; i < BATCH_ROUNDS; i++) {
+		batchResetQueues(count);
+		hostCounters(&before);
+		uint64_t const start = hostNs();
+		round(count);
+		_samples[i] = hostNs() - start;
+		hostCounters(&after);
+		roundSvcs += after.svcs - before.svcs;
+	}
+	hostSummarise(_samples, BATCH_ROUNDS, &summary);
+	*svcs = (double) roundSvcs / BATCH_ROUNDS;
+	return summary.p50;
+}
+
+static void batchBench(void const * const arg) {
+	(void) arg;
+	printf("batch: %4s %12s %10s %12s %10s %8s\n", "ops", "single ns", "SVCs", "batch ns", "SVCs", "speedup");
+	for (uint32_t count = 1; count <= BATCH_MAX; count++) {
+		for (uint32_t i = 0; i < count; i++) {
+			static uint32_t const kinds[] = { BATCH_SEMAPHORE_RELEASE, BATCH_QUEUE_SEND, BATCH_NOTIFY };
+			void * const objects[] = { &_semaphores[i], &_queues[i], &_reasons[i] };
+			_ops[i] = (batchOp_t) { kinds[i % 3], objects[i % 3], (i % 3 == 1) ? i : 1 };
+		}
+		double singleSvcs, batchSvcs;
+		uint64_t const single = batchMeasure(batchIndividual, count, &singleSvcs);
+		uint64_t const batched = batchMeasure(batchBatched, count, &batchSvcs);
+		printf("batch: %4u %12llu %10.1f %12llu %10.1f %7.2fx\n", count,
+			(unsigned long long) single, singleSvcs, (unsigned long long) batched, batchSvcs,
+			batched ? (double) single / batched : 0.0);
+		if (batchSvcs != 1.0) {
+			hostFail("a batch of %u operations took %.1f SVCs", count, batchSvcs);
+		}
+		// Everything sent in the last round must have arrived
+		for (uint32_t i = 1; i < count; i += 3) {
+			uint32_t value;
+			if (!queueTryReceive(&_queues[i], &value) || value != i) {
+				hostFail("batched queue send %u didn't arrive", i);
+			}
+		}
+	}
+	hostStop();
+}
+
+int main(void) {
+	for (uint32_t i = 0; i < BATCH_MAX; i++) {
+		semaphoreInit(&_semaphores[i], 0);
+	}
+	OS_initialiseTCB(&_benchTCB, _benchStack + 512, batchBench, 0, HIGH);
+	OS_init(&fixedPriorityScheduler);
+	OS_addTask(&_benchTCB);
+	OS_start();
+	return hostExitStatus();
+}
@@ -0,0 +1,106 @@
+/* Task churn benchmark for the task pool (OS_createTask() and OS_deleteTask()).
+
+   A spawner task repeatedly creates a worker from the pool and lets it run to completion,
+	 so every cycle is a create, a switch to the worker, the worker's exit and a switch back.
+	 A second run deletes each worker before it has run.  Both report cycles per second of
+	 host time and the kernel entries per cycle, which are what a cycle costs on the target.
+	 Finally the pool is filled to capacity, checked to refuse one more task, and emptied,
+	 many times over, to show that slots are never leaked. */
+
+#include <stdio.h>
+#include "hostport.h"
+#include "FixedPriorityScheduler.h"
+
+#define CHURN_CYCLES 200000
+#define CHURN_FILLS 10000
+
+static OS_TCB_t _spawnerTCB;
+static uint32_t _spawnerStack[256] __attribute__((aligned(8)));
+static uint32_t volatile _workerRuns = 0;
+
+static void churnWorker(void const * const arg) {
+	(void) arg;
+	_workerRuns++;
+}
+
+static void churnReport(char const * name, uint64_t ns, hostCounters_t const * before, hostCounters_t const * after) {
+	printf("%s: %u cycles in %.1f ms, %.0f cycles/s, %.2f SVCs and %.2f switches per cycle\n",
+		name, CHURN_CYCLES, ns / 1e6, CHURN_CYCLES / (ns / 1e9),
+		(double)(after->svcs - before->svcs) / CHURN_CYCLES,
+		(double)(after->switches - before->switches) / CHURN_CYCLES);
+}
+
+static void churnSpawner(void const * const arg) {
+	hostCounters_t before, after;
+	OS_TCB_t * workers[OS_TASK_POOL_SIZE];
+	(void) arg;
+
+	// Create, run to completion, exit
+	hostCounters(&before);
+	uint64_t start = hostNs();
+	for (uint32_t i = 0; i < CHURN_CYCLES; i++) {
+		if (!OS_createTask(churnWorker, 0, 0, HIGH)) {
+			hostFail("create/exit: OS_createTask() failed on cycle %u", i);
+			break;
+		}
+		// The worker is behind the spawner in the ready list
+		OS_yield();
+	}
+	uint64_t ns = hostNs() - start;
+	hostCounters(&after);
+	churnReport("create/exit", ns, &before, &after);
+	if (_workerRuns != CHURN_CYCLES) {
+		hostFail("create/exit: %u of %u workers ran", _workerRuns, CHURN_CYCLES);
+	}
+
+	// Create and delete before the worker has run
+	hostCounters(&before);
+	start = hostNs();
+	for (uint32_t i = 0; i < CHURN_CYCLES; i++) {
+		OS_TCB_t * const worker = OS_createTask(churnWorker, 0, 0, HIGH);
+		if (!worker) {
+			hostFail("create/delete: OS_createTask() failed on cycle %u", i);
+			break;
+		}
+		OS_deleteTask(worker);
+	}
+	ns = hostNs() - start;
+	hostCounters(&after);
+	churnReport("create/delete", ns, &before, &after);
+
+	// Fill the pool, check that it is full, and empty it again
+	for (uint32_t fill = 0; fill < CHURN_FILLS; fill++) {
+		for (uint32_t i = 0; i < OS_TASK_POOL_SIZE; i++) {
+			workers[i] = OS_createTask(churnWorker, 0, 0, LOW);
+			if (!workers[i]) {
+				hostFail("fill %u: the pool ran out after %u tasks", fill, i);
+				hostStop();
+			}
+		}
+		if (OS_createTask(churnWorker, 0, 0, LOW)) {
+			hostFail("fill %u: the pool gave out more than %u tasks", fill, OS_TASK_POOL_SIZE);
+		}
+		if (OS_createTask(churnWorker, 0, OS_TASK_POOL_STACK_SIZE + 8, LOW)) {
+			hostFail("fill %u: a stack larger than the pool's was accepted", fill);
+		}
+		// Delete half of them, and let the other half run and exit
+		for (uint32_t i = 0; i < OS_TASK_POOL_SIZE; i += 2) {
+			OS_deleteTask(workers[i]);
+		}
+		OS_yield();
+	}
+	if (_workerRuns != CHURN_CYCLES + CHURN_FILLS * (OS_TASK_POOL_SIZE / 2)) {
+		hostFail("fill/empty: %u of %u workers ran", _workerRuns - CHURN_CYCLES, CHURN_FILLS * (OS_TASK_POOL_SIZE / 2));
+	} else {
+		printf("fill/empty: %u rounds of %u tasks, no slots leaked\n", CHURN_FILLS, OS_TASK_POOL_SIZE);
+	}
+	hostStop();
+}
+
+int main(void) {
+	OS_initialiseTCB(&_spawnerTCB, _spawnerStack + 256, churnSpawner, 0, HIGH);
+	OS_init(&fixedPriorityScheduler);
+	OS_addTask(&_spawnerTCB);
+	OS_start();
+	return hostExitStatus();
+}
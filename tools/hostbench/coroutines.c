@@ -0,0 +1,146 @@
+/* Memory per activity and switch cost of stackless coroutines (coroutine.c), against tasks.
+
+   COROUTINES_COUNT coroutines run in one host task, each a small state machine with a
+	 counter.  The memory they take (their coroutine_t and state, plus one host task's TCB,
+	 stack and coroutineHost_t shared between all of them) is printed per activity next to
+	 what one task per activity would take (a TCB and an OS_TASK_POOL_STACK_SIZE stack).
+	 Sizes are as compiled for the host, where pointers are twice as big as on the target.
+
+	 Switch cost is then measured three ways: every coroutine yielding COROUTINES_ROUNDS times
+	 with CO_YIELD(), COROUTINES_TASKS tasks doing the same with OS_yield(), and every coroutine
+	 sleeping COROUTINES_SLEEPS times for 1 to 8 ticks with CO_SLEEP(), which has the host
+	 block until the timer service wakes it.  Host time, SVCs and context switches per switch
+	 (per wake-up, for the sleeps) are printed, and no coroutine may wake before its time or
+	 miss a round. */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include "hostport.h"
+#include "FixedPriorityScheduler.h"
+#include "coroutine.h"
+
+#define COROUTINES_COUNT 300
+#define COROUTINES_ROUNDS 2000
+#define COROUTINES_TASKS 8
+#define COROUTINES_SLEEPS 20
+
+/* One activity: a coroutine and its state */
+typedef struct {
+	coroutine_t co;
+	uint32_t count;
+	uint32_t due;
+} activity_t;
+
+static OS_TCB_t _benchTCB, _taskTCBs[COROUTINES_TASKS];
+static uint32_t _benchStack[OS_TASK_POOL_STACK_SIZE / 4] __attribute__((aligned(8)));
+static uint32_t _taskStacks[COROUTINES_TASKS][OS_TASK_POOL_STACK_SIZE / 4] __attribute__((aligned(8)));
+static coroutineHost_t _host;
+static activity_t _activities[COROUTINES_COUNT];
+static uint32_t volatile _tasksLeft;
+static uint32_t _early;
+
+static coroutineResult_e coroutinesYielder(coroutine_t * co) {
+	activity_t * const activity = (activity_t *) co;
+	CO_BEGIN(co);
+	for (activity->count = 0; activity->count < COROUTINES_ROUNDS; activity->count++) {
+		CO_YIELD(co);
+	}
+	CO_END(co);
+}
+
+static coroutineResult_e coroutinesSleeper(coroutine_t * co) {
+	activity_t * const activity = (activity_t *) co;
+	CO_BEGIN(co);
+	for (activity->count = 0; activity->count < COROUTINES_SLEEPS; activity->count++) {
+		activity->due = OS_elapsedTicks() + 1 + (uint32_t) rand() % 8;
+		CO_SLEEP(co, activity->due - OS_elapsedTicks());
+		if (OS_tickBefore(OS_elapsedTicks(), activity->due)) {
+			_early++;
+		}
+	}
+	CO_END(co);
+}
+
+static void coroutinesTask(void const * const arg) {
+	(void) arg;
+	for (uint32_t i = 0; i < COROUTINES_ROUNDS; i++) {
+		OS_yield();
+	}
+	_tasksLeft--;
+}
+
+static void coroutinesReport(char const * name, uint64_t ns, uint64_t switches, hostCounters_t const * before, hostCounters_t const * after) {
+	printf("coroutines %s: %.1f ns, %.3f SVCs and %.3f context switches per switch\n", name,
+		(double) ns / switches, (double)(after->svcs - before->svcs) / switches,
+		(double)(after->switches - before->switches) / switches);
+}
+
+/* Runs every activity with 'func' to completion, and returns the host time it took */
+static uint64_t coroutinesRun(coroutineFunc_t func) {
+	for (uint32_t i = 0; i < COROUTINES_COUNT; i++) {
+		coroutineStart(&_host, &_activities[i].co, func, &_activities[i]);
+	}
+	uint64_t const start = hostNs();
+	coroutineHostRun(&_host);
+	uint64_t const ns = hostNs() - start;
+	for (uint32_t i = 0; i < COROUTINES_COUNT; i++) {
+		if (_activities[i].count != (func == coroutinesYielder ? COROUTINES_ROUNDS : COROUTINES_SLEEPS)) {
+			hostFail("activity %u stopped after %u rounds", i, _activities[i].count);
+		}
+	}
+	return ns;
+}
+
+static void coroutinesBench(void const * const arg) {
+	hostCounters_t before, after;
+	(void) arg;
+	srand(1);
+
+	size_t const shared = sizeof(OS_TCB_t) + sizeof(_benchStack) + sizeof(coroutineHost_t);
+	printf("coroutines memory: %u activities take %zu bytes each as coroutines (%zu + %zu shared), %zu each as tasks\n",
+		COROUTINES_COUNT, sizeof(activity_t) + shared / COROUTINES_COUNT, sizeof(activity_t), shared,
+		sizeof(OS_TCB_t) + OS_TASK_POOL_STACK_SIZE + sizeof(activity_t) - sizeof(coroutine_t));
+
+	hostCounters(&before);
+	uint64_t ns = coroutinesRun(coroutinesYielder);
+	hostCounters(&after);
+	coroutinesReport("CO_YIELD", ns, (uint64_t) COROUTINES_COUNT * COROUTINES_ROUNDS, &before, &after);
+
+	_tasksLeft = COROUTINES_TASKS;
+	for (uint32_t i = 0; i < COROUTINES_TASKS; i++) {
+		OS_initialiseTCB(&_taskTCBs[i], _taskStacks[i] + OS_TASK_POOL_STACK_SIZE / 4, coroutinesTask, 0, HIGH);
+		OS_addTask(&_taskTCBs[i]);
+	}
+	// This task takes its turns in the ring too
+	uint64_t yields = COROUTINES_TASKS * COROUTINES_ROUNDS;
+	hostCounters(&before);
+	uint64_t const start = hostNs();
+	while (_tasksLeft) {
+		OS_yield();
+		yields++;
+	}
+	ns = hostNs() - start;
+	hostCounters(&after);
+	coroutinesReport("OS_yield", ns, yields, &before, &after);
+
+	hostCounters(&before);
+	ns = coroutinesRun(coroutinesSleeper);
+	hostCounters(&after);
+	coroutinesReport("CO_SLEEP", ns, (uint64_t) COROUTINES_COUNT * COROUTINES_SLEEPS, &before, &after);
+	if (_early) {
+		hostFail("%u sleeps ended early", _early);
+	}
+	hostStop();
+}
+
+int main(void) {
+	coroutineHostInit(&_host);
+	OS_initialiseTCB(&_benchTCB, _benchStack + OS_TASK_POOL_STACK_SIZE / 4, coroutinesBench, 0, HIGH);
+	OS_init(&fixedPriorityScheduler);
+	OS_addTask(&_benchTCB);
+	if (!OS_timerServiceStart(HIGH)) {
+		hostFail("timer service didn't start");
+	}
+	OS_start();
+	return hostExitStatus();
+}
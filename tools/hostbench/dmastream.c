@@ -0,0 +1,139 @@
+/* Host model of a UART receiving into a stream buffer (streambuffer.c) by circular DMA.
+
+   A host thread plays the DMA channel and the UART: in real time, at the chosen baud rate
+	 (10 bits per byte), it writes a known byte sequence into the buffer in frames of random
+	 length with idle gaps between them, and runs the handlers the hardware would raise: the
+	 half-transfer and transfer-complete interrupts at every half of the buffer, and the
+	 idle-line interrupt at the end of every frame.  The reader task reads in place and checks
+	 every byte against the sequence by its position in the stream, so it still knows what to
+	 expect after an overrun.
+
+	 For each rate, the throughput the reader achieved, how many reads it took per kilobyte and
+	 the number of overruns are printed.  No byte may ever be wrong unless the writer lapped the
+	 reader while it was checking it, and there must be no overruns at DMASTREAM_SAFE_BAUD,
+	 which leaves the reader plenty of time.  At higher rates, overruns also happen whenever
+	 the host deschedules the reader's thread for longer than half the buffer takes to fill. */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <pthread.h>
+#include <sched.h>
+#include "hostport.h"
+#include "FixedPriorityScheduler.h"
+#include "streambuffer.h"
+#include "critical.h"
+
+#define DMASTREAM_SIZE 1024
+#define DMASTREAM_TRIGGER 256
+#define DMASTREAM_RUN_NS 300000000ULL
+#define DMASTREAM_SAFE_BAUD 1000000
+
+static OS_TCB_t _readerTCB;
+static uint32_t _readerStack[512] __attribute__((aligned(8)));
+static streamBuffer_t _stream;
+static uint8_t _buffer[DMASTREAM_SIZE];
+
+static uint32_t const _bauds[] = { 1000000, 3000000, 12000000, 50000000 };
+#define DMASTREAM_RATES (sizeof(_bauds) / sizeof(_bauds[0]))
+
+static uint32_t _baud;
+static uint32_t volatile _written;    // bytes the DMA has written, ever
+static uint32_t volatile _finished;   // set by the DMA thread when the run is over
+
+/* The byte at a position in the stream */
+static uint8_t dmaByte(uint32_t position) {
+	return (uint8_t)((position * 2654435761u) >> 24);
+}
+
+/* The DMA channel and the UART.  The line is followed in byte times: each one either
+   carries a byte of the current frame or is part of the idle gap after it. */
+static void * dmaThread(void * arg) {
+	(void) arg;
+	hostInterruptThread(DMA1_Channel6_IRQn);
+	uint64_t const start = hostNs();
+	uint64_t now, byteTimes = 0;
+	uint32_t frameLeft = 0, gapLeft = 0;
+	srand(_baud);
+	while ((now = hostNs()) - start < DMASTREAM_RUN_NS) {
+		uint64_t const due = (now - start) * (_baud / 10) / 1000000000ULL;
+		for (; byteTimes < due; byteTimes++) {
+			if (gapLeft) {
+				gapLeft--;
+				continue;
+			}
+			if (!frameLeft) {
+				frameLeft = 16 + (uint32_t) rand() % 1024;
+			}
+			_buffer[_written % DMASTREAM_SIZE] = dmaByte(_written);
+			__atomic_store_n(&_written, _written + 1, __ATOMIC_RELEASE);
+			if (_written % (DMASTREAM_SIZE / 2) == 0) {
+				// Half-transfer or transfer-complete interrupt
+				streamBufferWritten(&_stream, _written % DMASTREAM_SIZE, 0);
+			}
+			if (--frameLeft == 0) {
+				// Idle-line interrupt, and a gap of a few byte times
+				hostInterruptThread(USART2_IRQn);
+				streamBufferWritten(&_stream, _written % DMASTREAM_SIZE, 1);
+				hostInterruptThread(DMA1_Channel6_IRQn);
+				gapLeft = 1 + (uint32_t) rand() % 8;
+			}
+		}
+		sched_yield();
+	}
+	hostInterruptThread(USART2_IRQn);
+	streamBufferWritten(&_stream, _written % DMASTREAM_SIZE, 1);
+	__atomic_store_n(&_finished, 1, __ATOMIC_RELEASE);
+	return 0;
+}
+
+static void dmaReader(void const * const arg) {
+	(void) arg;
+	hostAsync(1);
+	for (uint32_t rate = 0; rate < DMASTREAM_RATES; rate++) {
+		pthread_t thread;
+		uint64_t checked = 0, reads = 0, lapped = 0;
+		_baud = _bauds[rate];
+		_written = _finished = 0;
+		streamBufferInit(&_stream, _buffer, DMASTREAM_SIZE, DMASTREAM_TRIGGER);
+		uint64_t const start = hostNs();
+		pthread_create(&thread, 0, dmaThread, 0);
+		while (!__atomic_load_n(&_finished, __ATOMIC_ACQUIRE) || _stream.tail != _stream.head) {
+			uint8_t const * data;
+			uint32_t const count = __atomic_load_n(&_finished, __ATOMIC_ACQUIRE)
+				? streamBufferPeek(&_stream, &data) : streamBufferRead(&_stream, &data);
+			uint32_t const at = _stream.tail;
+			uint32_t wrong = 0;
+			for (uint32_t i = 0; i < count; i++) {
+				wrong += data[i] != dmaByte(at + i);
+			}
+			// Bytes overwritten while they were being checked don't count against the reader
+			if (wrong && __atomic_load_n(&_written, __ATOMIC_ACQUIRE) - at <= DMASTREAM_SIZE) {
+				hostFail("%u baud: %u wrong bytes at %u", _baud, wrong, at);
+			}
+			lapped += wrong != 0;
+			streamBufferConsume(&_stream, count);
+			checked += count;
+			reads++;
+		}
+		pthread_join(thread, 0);
+		uint64_t const ns = hostNs() - start;
+		printf("dmastream %u baud: %.2f MB/s, %llu bytes checked, %.2f reads/KB, %u overruns, %llu chunks lapped\n",
+			_baud, checked * 1e3 / ns, (unsigned long long) checked, reads * 1024.0 / (checked ? checked : 1),
+			_stream.overruns, (unsigned long long) lapped);
+		if (_baud <= DMASTREAM_SAFE_BAUD && _stream.overruns) {
+			hostFail("%u baud: the reader was overrun", _baud);
+		}
+	}
+	hostAsync(0);
+	hostStop();
+}
+
+int main(void) {
+	NVIC_SetPriority(DMA1_Channel6_IRQn, OS_MAX_SYSCALL_PRIORITY);
+	NVIC_SetPriority(USART2_IRQn, OS_MAX_SYSCALL_PRIORITY);
+	OS_initialiseTCB(&_readerTCB, _readerStack + 512, dmaReader, 0, HIGH);
+	OS_init(&fixedPriorityScheduler);
+	OS_addTask(&_readerTCB);
+	OS_start();
+	return hostExitStatus();
+}
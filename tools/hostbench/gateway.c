@@ -0,0 +1,149 @@
+/* Event latency through a gateway task that serves several queues and a semaphore, waiting
+   on a queue set (queueset.c) against polling them every tick.
+
+   A driver task raises GATEWAY_EVENTS events from an interrupt handler at random intervals of
+	 1 to 4 ticks, each sent to a random queue with queueSendFromISR() or given as a semaphore
+	 permit.  The gateway either waits in queueSetSelect(), or tries every member in turn and
+	 sleeps for a tick when none was ready.  Latency is in simulated nanoseconds (ticks, plus
+	 the SysTick count within the tick) from just before the interrupt to the gateway having
+	 the event, and the gateway's context switches per event show what polling costs while
+	 nothing is happening.  Every event must be handled once. */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include "hostport.h"
+#include "FixedPriorityScheduler.h"
+#include "queueset.h"
+#include "sleep.h"
+#include "critical.h"
+
+#define GATEWAY_QUEUES 4
+#define GATEWAY_EVENTS 2000
+
+static OS_TCB_t _driverTCB, _gatewayTCB;
+static uint32_t _driverStack[512] __attribute__((aligned(8)));
+static uint32_t _gatewayStack[512] __attribute__((aligned(8)));
+
+static queue_t _queues[GATEWAY_QUEUES];
+static uint32_t _queueStorage[GATEWAY_QUEUES][8];
+static semaphore_t _semaphore;
+static queueSet_t _set;
+
+static uint32_t _polling;
+static uint32_t volatile _handled;
+static uint32_t _pending;   // event carried by the semaphore (it has no payload)
+static uint32_t _member;    // where the interrupt sends the next event
+static uint32_t _event;
+static uint64_t _stamps[GATEWAY_EVENTS];
+static uint64_t _latencies[GATEWAY_EVENTS];
+static uint32_t _seen[GATEWAY_EVENTS];
+
+/* Simulated time in nanoseconds: one cycle is a nanosecond */
+static uint64_t gatewayNow(void) {
+	return OS_elapsedTicks64() * (SystemCoreClock / OS_TICK_HZ) + (SysTick->LOAD - SysTick->VAL);
+}
+
+static void gatewayInterrupt(void) {
+	if (_member < GATEWAY_QUEUES) {
+		queueSendFromISR(&_queues[_member], &_event);
+	} else {
+		_pending = _event;
+		semaphoreReleaseFromISR(&_semaphore, 1);
+	}
+}
+
+static void gatewayHandle(uint32_t event) {
+	if (event >= GATEWAY_EVENTS || _seen[event]) {
+		hostFail("%s: event %u handled twice", _polling ? "polling" : "queue set", event);
+		return;
+	}
+	_seen[event] = 1;
+	_latencies[_handled++] = gatewayNow() - _stamps[event];
+}
+
+/* Receives from a member that is known to be ready */
+static void gatewayReceive(void * member) {
+	uint32_t event;
+	if (member == &_semaphore) {
+		semaphoreAquire(&_semaphore, 1);
+		gatewayHandle(_pending);
+	} else {
+		queueReceive((queue_t *) member, &event);
+		gatewayHandle(event);
+	}
+}
+
+static void gatewayTask(void const * const arg) {
+	(void) arg;
+	while (1) {
+		if (!_polling) {
+			gatewayReceive(queueSetSelect(&_set));
+			continue;
+		}
+		uint32_t found = 0, event;
+		for (uint32_t i = 0; i < GATEWAY_QUEUES; i++) {
+			if (queueTryReceive(&_queues[i], &event)) {
+				gatewayHandle(event);
+				found = 1;
+			}
+		}
+		if (semaphoreTryAquire(&_semaphore, 1)) {
+			gatewayHandle(_pending);
+			found = 1;
+		}
+		if (!found) {
+			OS_sleep(1);
+		}
+	}
+}
+
+static void gatewayDriver(void const * const arg) {
+	(void) arg;
+	srand(1);
+	for (_polling = 0; _polling < 2; _polling++) {
+		hostCounters_t before, after;
+		hostSummary_t summary;
+		_handled = 0;
+		for (uint32_t i = 0; i < GATEWAY_EVENTS; i++) {
+			_seen[i] = 0;
+		}
+		hostCounters(&before);
+		for (_event = 0; _event < GATEWAY_EVENTS; _event++) {
+			OS_sleep(1 + rand() % 4);
+			// The semaphore carries one event at a time
+			_member = rand() % (GATEWAY_QUEUES + 1);
+			if (_member == GATEWAY_QUEUES && _semaphore.permits) {
+				_member = 0;
+			}
+			_stamps[_event] = gatewayNow();
+			hostInterrupt(USART2_IRQn, gatewayInterrupt);
+		}
+		while (_handled != GATEWAY_EVENTS) {
+			OS_sleep(1);
+		}
+		hostCounters(&after);
+		hostSummarise(_latencies, GATEWAY_EVENTS, &summary);
+		hostPrintSummary(_polling ? "gateway polling" : "gateway queue set", &summary, "ns");
+		printf("gateway %s: %.2f context switches per event\n", _polling ? "polling" : "queue set",
+			(double)(after.switches - before.switches) / GATEWAY_EVENTS);
+	}
+	hostStop();
+}
+
+int main(void) {
+	NVIC_SetPriority(USART2_IRQn, OS_MAX_SYSCALL_PRIORITY);
+	queueSetInit(&_set);
+	for (uint32_t i = 0; i < GATEWAY_QUEUES; i++) {
+		queueInit(&_queues[i], _queueStorage[i], 8, sizeof(uint32_t));
+		queueSetAddQueue(&_set, &_queues[i]);
+	}
+	semaphoreInit(&_semaphore, 0);
+	queueSetAddSemaphore(&_set, &_semaphore);
+	OS_initialiseTCB(&_driverTCB, _driverStack + 512, gatewayDriver, 0, HIGH);
+	OS_initialiseTCB(&_gatewayTCB, _gatewayStack + 512, gatewayTask, 0, HIGH);
+	OS_init(&fixedPriorityScheduler);
+	OS_addTask(&_driverTCB);
+	OS_addTask(&_gatewayTCB);
+	OS_start();
+	return hostExitStatus();
+}
@@ -0,0 +1,571 @@
+#include "hostport.h"
+#include "os_internal.h"
+#include "timer.h"
+#include "latency.h"
+#include "idle.h"
+#include "isr.h"
+#include "batch.h"
+#include "cond.h"
+#include "heap.h"
+#include "tasknotify.h"
+#include <stdio.h>
+#include <stdarg.h>
+#include <string.h>
+#include <time.h>
+#include <sched.h>
+
+/* This is the host kernel port: everything that os_asm.s and the Cortex-M core do for the
+   kernel, in C for Linux.
+
+	 Tasks run on host stacks taken from a static pool (so they are below 4 GiB, as the kernel
+	 needs).  The TCB's 'sp' field points at the task's context record once it has run, so a
+	 TCB whose 'sp' points anywhere else has just been initialised by OS_initialiseTCB(), and
+	 its function and argument are taken from the exception frame that was built for it.
+
+	 Exceptions are modelled by what they do to the running task: an SVC pseudo-function calls
+	 its handler with a frame holding its arguments, and then, as the exception return would,
+	 runs PendSV if anything pended it.  PendSV runs the same sequence as PendSV_Handler and
+	 switches host stacks instead of register sets.  SysTick and other interrupts only happen
+	 when a task asks for them, or when the idle task sleeps, which fast-forwards to the next
+	 tick. */
+
+#define HOST_CONTEXTS 64
+#define HOST_STACK_SIZE (64 * 1024)
+
+#define HOST_EXCEPTION_SVCALL 11
+#define HOST_EXCEPTION_PENDSV 14
+#define HOST_EXCEPTION_SYSTICK 15
+
+/* SVC handlers, as listed in os_asm.s */
+void _svc_OS_enable_systick(void);
+void _svc_OS_addTask(_OS_SVC_StackFrame_t * const stack);
+void _svc_OS_task_exit(void);
+void _svc_OS_yield(void);
+void _svc_OS_schedule(void);
+void _svc_OS_wait(_OS_SVC_StackFrame_t const * const stack, uint32_t checkCode);
+void _svc_OS_notify(_OS_SVC_StackFrame_t const * const stack);
+void _svc_OS_createTask(_OS_SVC_StackFrame_t * const stack);
+void _svc_OS_deleteTask(_OS_SVC_StackFrame_t const * const stack);
+void _svc_OS_batch(_OS_SVC_StackFrame_t * const stack);
+void _svc_OS_timerStart(_OS_SVC_StackFrame_t const * const stack);
+void _svc_OS_timerStop(_OS_SVC_StackFrame_t const * const stack);
+void _svc_OS_timerTake(_OS_SVC_StackFrame_t * const stack);
+void _svc_OS_nowUs(_OS_SVC_StackFrame_t * const stack);
+void _svc_OS_condWait(_OS_SVC_StackFrame_t * const stack);
+void _svc_OS_condSignal(_OS_SVC_StackFrame_t const * const stack);
+void _svc_OS_heapAlloc(_OS_SVC_StackFrame_t * const stack);
+void _svc_OS_heapFree(_OS_SVC_StackFrame_t const * const stack);
+void _svc_OS_heapResize(_OS_SVC_StackFrame_t * const stack);
+void _svc_OS_heapStats(_OS_SVC_StackFrame_t const * const stack);
+void _svc_OS_taskNotify(_OS_SVC_StackFrame_t * const stack);
+void _svc_OS_taskNotifyTake(_OS_SVC_StackFrame_t * const stack);
+void _svc_OS_latencyRead(_OS_SVC_StackFrame_t const * const stack);
+void _svc_OS_idlePrepare(_OS_SVC_StackFrame_t * const stack);
+void _svc_OS_idleStats(_OS_SVC_StackFrame_t const * const stack);
+void SysTick_Handler(void);
+OS_TCB_t const * _OS_scheduler(void);
+
+/* Every handler is called the same way, as the dispatch table in os_asm.s does */
+typedef void (* hostSvcHandler_t)(_OS_SVC_StackFrame_t * stack);
+
+/*********/
+/* Core  */
+/*********/
+
+SCB_Type hostSCB;
+uint32_t SystemCoreClock = 1000000000;
+__thread uint32_t hostIPSR = 0;
+__thread uint32_t hostBASEPRI = 0;
+__thread uint32_t hostCONTROL = 0;
+
+static SysTick_Type _sysTick;
+static uint8_t _priorities[16 + 96];
+static uint64_t volatile _tickNs = 0;
+static uint32_t volatile _async = 0;
+static hostCounters_t _counters;
+static uint32_t _failures = 0;
+
+/* Exclusive monitor of the calling thread */
+static __thread uint32_t volatile * _reservedAddress = 0;
+static __thread uint32_t _reservedValue = 0;
+
+uint64_t hostNs(void) {
+	static struct timespec start;
+	struct timespec now;
+	if (!start.tv_sec && !start.tv_nsec) {
+		clock_gettime(CLOCK_MONOTONIC, &start);
+	}
+	clock_gettime(CLOCK_MONOTONIC, &now);
+	return (uint64_t)(now.tv_sec - start.tv_sec) * 1000000000u + (uint64_t)now.tv_nsec - (uint64_t)start.tv_nsec;
+}
+
+uint32_t hostLdrex(uint32_t volatile * address) {
+	_reservedAddress = address;
+	_reservedValue = __atomic_load_n(address, __ATOMIC_SEQ_CST);
+	return _reservedValue;
+}
+
+uint32_t hostStrex(uint32_t value, uint32_t volatile * address) {
+	uint32_t expected = _reservedValue;
+	if (_reservedAddress != address) {
+		return 1;
+	}
+	_reservedAddress = 0;
+	return !__atomic_compare_exchange_n(address, &expected, value, 0, __ATOMIC_SEQ_CST, __ATOMIC_SEQ_CST);
+}
+
+void hostClrex(void) {
+	_reservedAddress = 0;
+}
+
+void NVIC_SetPriority(IRQn_Type irq, uint32_t priority) {
+	_priorities[irq + 16] = priority & ((1 << __NVIC_PRIO_BITS) - 1);
+}
+
+uint32_t NVIC_GetPriority(IRQn_Type irq) {
+	return _priorities[irq + 16];
+}
+
+void NVIC_EnableIRQ(IRQn_Type irq) {
+	(void) irq;
+}
+
+void NVIC_DisableIRQ(IRQn_Type irq) {
+	(void) irq;
+}
+
+void NVIC_ClearPendingIRQ(IRQn_Type irq) {
+	(void) irq;
+}
+
+void SystemCoreClockUpdate(void) {
+}
+
+uint32_t SysTick_Config(uint32_t ticks) {
+	_sysTick.LOAD = ticks - 1;
+	_sysTick.VAL = 0;
+	_sysTick.CTRL = 7;
+	_tickNs = hostNs();
+	return 0;
+}
+
+/* SysTick counts down from LOAD over a tick, here at one cycle per host nanosecond since the
+   last tick.  It stops at zero, because the next tick only comes when somebody asks for it. */
+SysTick_Type * hostSysTick(void) {
+	uint64_t elapsed = hostNs() - _tickNs;
+	if (elapsed > _sysTick.LOAD) {
+		elapsed = _sysTick.LOAD;
+	}
+	_sysTick.VAL = _sysTick.LOAD - (uint32_t) elapsed;
+	return &_sysTick;
+}
+
+RCC_TypeDef hostRCC;
+static TIM_TypeDef _tim2;
+
+/* TIM2 counts core cycles, one per host nanosecond, divided by the prescaler, while it is
+   enabled.  Its counter is 32 bits wide, so ARR is taken to be 0xFFFFFFFF. */
+TIM_TypeDef * hostTim2(void) {
+	if (_tim2.CR1 & TIM_CR1_CEN) {
+		_tim2.CNT = (uint32_t)(hostNs() / (_tim2.PSC + 1));
+	}
+	return &_tim2;
+}
+
+/* Converts a pointer into a register value, which only works below 4 GiB */
+static uint32_t hostWord(void const * pointer) {
+	uintptr_t const word = (uintptr_t) pointer;
+	if (word > 0xFFFFFFFFu) {
+		fprintf(stderr, "hostport: %p was passed to the kernel, but is above 4 GiB (main()'s stack?)\n", pointer);
+		abort();
+	}
+	return (uint32_t) word;
+}
+
+/************/
+/* Contexts */
+/************/
+
+typedef struct {
+	OS_TCB_t * tcb;                        // zero if the context is free
+	void (* func)(void const * const);     // task function, or zero for the idle task
+	void const * arg;
+	void * sp;                             // saved host stack pointer
+	uint8_t * stack;
+} hostContext_t;
+
+static hostContext_t _contexts[HOST_CONTEXTS];
+static uint8_t _stacks[HOST_CONTEXTS][HOST_STACK_SIZE] __attribute__((aligned(16)));
+static hostContext_t _mainContext;
+
+/* Saves the callee-saved registers on the current stack, stores the stack pointer in *save,
+   and carries on from the stack pointer 'load' */
+#if !defined(__x86_64__)
+#error "hostport.c switches stacks with x86-64 code"
+#endif
+void hostSwitchStacks(void ** save, void * load);
+__asm__(
+	".text\n"
+	".globl hostSwitchStacks\n"
+	".type hostSwitchStacks, @function\n"
+	"hostSwitchStacks:\n"
+	"\tpushq %rbp\n"
+	"\tpushq %rbx\n"
+	"\tpushq %r12\n"
+	"\tpushq %r13\n"
+	"\tpushq %r14\n"
+	"\tpushq %r15\n"
+	"\tmovq %rsp, (%rdi)\n"
+	"\tmovq %rsi, %rsp\n"
+	"\tpopq %r15\n"
+	"\tpopq %r14\n"
+	"\tpopq %r13\n"
+	"\tpopq %r12\n"
+	"\tpopq %rbx\n"
+	"\tpopq %rbp\n"
+	"\tret\n");
+
+static void hostPendSV(void);
+static void hostIdle(void);
+
+/* First function of every context */
+static void hostContextEntry(void) {
+	hostContext_t * const context = (hostContext_t *) _currentTCB->sp;
+	// Back in thread mode, unprivileged as os_asm.s leaves tasks, after anything else PendSV
+	// has been asked to do
+	hostIPSR = 0;
+	hostCONTROL = 1;
+	hostPendSV();
+	if (context->func) {
+		context->func(context->arg);
+		_OS_task_end();
+	} else {
+		hostIdle();
+	}
+	fprintf(stderr, "hostport: a task carried on after it ended\n");
+	abort();
+}
+
+/* Gives a TCB a new context, which will start at hostContextEntry() */
+static hostContext_t * hostContextNew(OS_TCB_t * tcb) {
+	hostContext_t * context = 0;
+	for (uint32_t i = 0; i < HOST_CONTEXTS; i++) {
+		// A context left by an earlier task with the same TCB is free now
+		if (_contexts[i].tcb == tcb) {
+			context = &_contexts[i];
+			break;
+		}
+		if (!context && !_contexts[i].tcb) {
+			context = &_contexts[i];
+		}
+	}
+	if (!context) {
+		fprintf(stderr, "hostport: more than %u TCBs have been used\n", HOST_CONTEXTS);
+		abort();
+	}
+	context->tcb = tcb;
+	context->stack = _stacks[context - _contexts];
+	uint64_t * top = (uint64_t *)(context->stack + HOST_STACK_SIZE);
+	*--top = 0;                                       // hostContextEntry()'s return address
+	*--top = (uint64_t)(uintptr_t) hostContextEntry;  // hostSwitchStacks()'s return address
+	for (uint32_t i = 0; i < 6; i++) {
+		*--top = 0;                                     // rbp, rbx, r12-r15
+	}
+	context->sp = top;
+	tcb->sp = context;
+	return context;
+}
+
+/* Returns the context of a TCB that is about to run */
+static hostContext_t * hostContextOf(OS_TCB_t * tcb) {
+	uintptr_t const sp = (uintptr_t) tcb->sp;
+	if (sp >= (uintptr_t) _contexts && sp < (uintptr_t) (_contexts + HOST_CONTEXTS)) {
+		return (hostContext_t *) sp;
+	}
+	// Initialised since it last ran: start the function in its exception frame
+	OS_StackFrame_t const * const frame = (OS_StackFrame_t const *) tcb->sp;
+	void (* const func)(void const * const) = (void (*)(void const * const))(uintptr_t) frame->pc;
+	void const * const arg = (void const *)(uintptr_t) frame->r0;
+	hostContext_t * const context = hostContextNew(tcb);
+	context->func = func;
+	context->arg = arg;
+	return context;
+}
+
+/* The end of _task_switch: makes 'next' the running task */
+static void hostSwitch(OS_TCB_t const * next) {
+	OS_TCB_t * const previous = _currentTCB;
+	if (next == previous) {
+		return;
+	}
+	hostContext_t * const from = (hostContext_t *) previous->sp;
+	hostContext_t * const to = hostContextOf((OS_TCB_t *) next);
+	_currentTCB = (OS_TCB_t *) next;
+	_OS_latencyResume();
+	hostClrex();
+	_counters.switches++;
+	hostSwitchStacks(&from->sp, to->sp);
+}
+
+/* PendSV_Handler.  Runs again straight away if it was pended while it ran, as the exception
+   would tail-chain. */
+static void hostPendSV(void) {
+	// Before OS_start() there is nothing to switch from, so it stays pending until then
+	if (!_currentTCB) {
+		return;
+	}
+	while (__atomic_fetch_and(&hostSCB.ICSR, ~SCB_ICSR_PENDSVSET_Msk, __ATOMIC_SEQ_CST) & SCB_ICSR_PENDSVSET_Msk) {
+		hostIPSR = HOST_EXCEPTION_PENDSV;
+		_counters.pendSVs++;
+		_OS_latencyPendSV();
+		_isrDrain();
+		hostSwitch(_OS_scheduler());
+		hostIPSR = 0;
+	}
+}
+
+/* Calls an SVC handler with the arguments in its frame, and returns r0 and r1 */
+static uint64_t hostSvc(hostSvcHandler_t handler, uint32_t r0, uint32_t r1, uint32_t r2, uint32_t r3) {
+	_OS_SVC_StackFrame_t frame = { r0, r1, r2, r3, 0, 0, 0, 0x01000000 };
+	_counters.svcs++;
+	hostIPSR = HOST_EXCEPTION_SVCALL;
+	handler(&frame);
+	hostIPSR = 0;
+	hostPendSV();
+	return ((uint64_t) frame.r1 << 32) | frame.r0;
+}
+
+#define HOST_SVC(handler, r0, r1, r2, r3) hostSvc((hostSvcHandler_t) (handler), (r0), (r1), (r2), (r3))
+
+/* The rest of _task_init_switch, on the idle task's context */
+static void hostIdle(void) {
+	HOST_SVC(_svc_OS_enable_systick, 0, 0, 0, 0);
+	HOST_SVC(_svc_OS_schedule, 0, 0, 0, 0);
+	_OS_idleTask();
+}
+
+void _task_init_switch(OS_TCB_t const * const idleTask) {
+	OS_TCB_t * const idle = (OS_TCB_t *) idleTask;
+	hostContext_t * const context = hostContextNew(idle);
+	context->func = 0;
+	_currentTCB = idle;
+	hostSwitchStacks(&_mainContext.sp, context->sp);
+}
+
+void _task_switch(void) {
+	fprintf(stderr, "hostport: _task_switch is only called from PendSV\n");
+	abort();
+}
+
+void hostStop(void) {
+	hostContext_t * const context = (hostContext_t *) _currentTCB->sp;
+	hostSwitchStacks(&context->sp, _mainContext.sp);
+}
+
+/**************/
+/* Interrupts */
+/**************/
+
+void hostTick(void) {
+	uint32_t const ipsr = hostIPSR;
+	hostIPSR = HOST_EXCEPTION_SYSTICK;
+	_tickNs = hostNs();
+	_counters.ticks++;
+	SysTick_Handler();
+	hostIPSR = ipsr;
+	if (!ipsr) {
+		hostPendSV();
+	}
+}
+
+void hostInterrupt(IRQn_Type irq, void (* handler)(void)) {
+	uint32_t const ipsr = hostIPSR;
+	hostIPSR = 16 + irq;
+	handler();
+	hostIPSR = ipsr;
+	if (!ipsr) {
+		hostPendSV();
+	}
+}
+
+void hostInterruptThread(IRQn_Type irq) {
+	hostIPSR = 16 + irq;
+}
+
+void hostAsync(uint32_t enable) {
+	_async = enable;
+}
+
+/* WFI in the idle task.  The next interrupt is the next tick, unless PendSV is already
+   pending, or (with hostAsync()) another thread pends it first. */
+void hostWFI(void) {
+	if (_async) {
+		while (!(hostSCB.ICSR & SCB_ICSR_PENDSVSET_Msk) && hostNs() - _tickNs < 1000000) {
+			sched_yield();
+		}
+		if (hostSCB.ICSR & SCB_ICSR_PENDSVSET_Msk) {
+			hostPendSV();
+		} else {
+			hostTick();
+		}
+		return;
+	}
+	if (hostSCB.ICSR & SCB_ICSR_PENDSVSET_Msk) {
+		hostPendSV();
+		return;
+	}
+	if (_OS_nextDeadline() == 0xFFFFFFFF) {
+		fprintf(stderr, "hostport: deadlock: every task is waiting, and no sleeper or timer is due\n");
+		abort();
+	}
+	hostTick();
+}
+
+void hostCounters(hostCounters_t * counters) {
+	*counters = _counters;
+}
+
+/***************************/
+/* SVC pseudo-functions    */
+/***************************/
+
+uint32_t OS_addTask(OS_TCB_t const * const task) {
+	return (uint32_t) HOST_SVC(_svc_OS_addTask, hostWord(task), 0, 0, 0);
+}
+
+OS_TCB_t * OS_createTask(void (* const func)(void const * const), void const * const data, uint32_t stackSize, uint32_t priority) {
+	return (OS_TCB_t *)(uintptr_t)(uint32_t) HOST_SVC(_svc_OS_createTask, hostWord((void const *)(uintptr_t) func), hostWord(data), stackSize, priority);
+}
+
+void OS_deleteTask(OS_TCB_t * const task) {
+	HOST_SVC(_svc_OS_deleteTask, hostWord(task), 0, 0, 0);
+}
+
+void OS_yield(void) {
+	HOST_SVC(_svc_OS_yield, 0, 0, 0, 0);
+}
+
+void OS_wait(void * reason, uint32_t checkCode) {
+	HOST_SVC(_svc_OS_wait, hostWord(reason), checkCode, 0, 0);
+}
+
+void OS_notify(void * reason) {
+	HOST_SVC(_svc_OS_notify, hostWord(reason), 0, 0, 0);
+}
+
+uint64_t OS_nowUs(void) {
+	return HOST_SVC(_svc_OS_nowUs, 0, 0, 0, 0);
+}
+
+void _OS_task_exit(void) {
+	HOST_SVC(_svc_OS_task_exit, 0, 0, 0, 0);
+}
+
+uint32_t _OS_batch(batchOp_t const * ops, uint32_t count) {
+	return (uint32_t) HOST_SVC(_svc_OS_batch, hostWord(ops), count, 0, 0);
+}
+
+void OS_timerStart(OS_timer_t * timer, uint32_t delay, uint32_t period) {
+	HOST_SVC(_svc_OS_timerStart, hostWord(timer), delay, period, 0);
+}
+
+void OS_timerStop(OS_timer_t * timer) {
+	HOST_SVC(_svc_OS_timerStop, hostWord(timer), 0, 0, 0);
+}
+
+_OS_timerExpiry_t _OS_timerTake(void) {
+	uint64_t const regs = HOST_SVC(_svc_OS_timerTake, 0, 0, 0, 0);
+	_OS_timerExpiry_t const expiry = { (OS_timerCallback_t)(uintptr_t)(uint32_t) regs, (void *)(uintptr_t)(uint32_t)(regs >> 32) };
+	return expiry;
+}
+
+uint32_t _OS_condWait(OS_cond_t * cond, OS_mutex_t * mutex) {
+	return (uint32_t) HOST_SVC(_svc_OS_condWait, hostWord(cond), hostWord(mutex), 0, 0);
+}
+
+void _OS_condSignal(OS_cond_t * cond, uint32_t all) {
+	HOST_SVC(_svc_OS_condSignal, hostWord(cond), all, 0, 0);
+}
+
+void * heapAlloc(size_t size) {
+	return (void *)(uintptr_t)(uint32_t) HOST_SVC(_svc_OS_heapAlloc, (uint32_t) size, 0, 0, 0);
+}
+
+void heapFree(void * ptr) {
+	HOST_SVC(_svc_OS_heapFree, hostWord(ptr), 0, 0, 0);
+}
+
+uint32_t _heapResize(void * ptr, size_t size) {
+	return (uint32_t) HOST_SVC(_svc_OS_heapResize, hostWord(ptr), (uint32_t) size, 0, 0);
+}
+
+void heapStats(heapStats_t * stats) {
+	HOST_SVC(_svc_OS_heapStats, hostWord(stats), 0, 0, 0);
+}
+
+uint32_t OS_taskNotify(OS_TCB_t * task, uint32_t value, uint32_t action) {
+	return (uint32_t) HOST_SVC(_svc_OS_taskNotify, hostWord(task), value, action, 0);
+}
+
+uint32_t _OS_taskNotifyTake(uint32_t decrement, uint32_t clearMask, uint32_t * value) {
+	return (uint32_t) HOST_SVC(_svc_OS_taskNotifyTake, decrement, clearMask, hostWord(value), 0);
+}
+
+void OS_latencyRead(uint32_t path, OS_latencyHistogram_t * histogram, uint32_t reset) {
+	HOST_SVC(_svc_OS_latencyRead, path, hostWord(histogram), reset, 0);
+}
+
+uint32_t _OS_idlePrepare(void) {
+	return (uint32_t) HOST_SVC(_svc_OS_idlePrepare, 0, 0, 0, 0);
+}
+
+void OS_idleStats(OS_idleStats_t * stats) {
+	HOST_SVC(_svc_OS_idleStats, hostWord(stats), 0, 0, 0);
+}
+
+/**********************/
+/* Benchmark helpers  */
+/**********************/
+
+static int hostCompareU64(void const * a, void const * b) {
+	uint64_t const x = *(uint64_t const *) a, y = *(uint64_t const *) b;
+	return (x > y) - (x < y);
+}
+
+void hostSummarise(uint64_t * samples, uint32_t count, hostSummary_t * summary) {
+	uint64_t total = 0;
+	memset(summary, 0, sizeof(*summary));
+	if (!count) {
+		return;
+	}
+	qsort(samples, count, sizeof(samples[0]), hostCompareU64);
+	for (uint32_t i = 0; i < count; i++) {
+		total += samples[i];
+	}
+	summary->count = count;
+	summary->min = samples[0];
+	summary->p50 = samples[(count - 1) / 2];
+	summary->p99 = samples[(uint32_t)((uint64_t)(count - 1) * 99 / 100)];
+	summary->max = samples[count - 1];
+	summary->mean = (double) total / count;
+}
+
+void hostPrintSummary(char const * name, hostSummary_t const * summary, char const * unit) {
+	printf("%s: n %u min %llu p50 %llu p99 %llu max %llu mean %.1f %s\n", name, summary->count,
+		(unsigned long long) summary->min, (unsigned long long) summary->p50,
+		(unsigned long long) summary->p99, (unsigned long long) summary->max, summary->mean, unit);
+}
+
+void hostFail(char const * format, ...) {
+	va_list args;
+	va_start(args, format);
+	printf("FAIL: ");
+	vprintf(format, args);
+	printf("\n");
+	va_end(args);
+	_failures++;
+}
+
+int hostExitStatus(void) {
+	return _failures ? 1 : 0;
+}
@@ -0,0 +1,79 @@
+#ifndef HOSTPORT_H
+#define HOSTPORT_H
+
+#include <stdint.h>
+#include "os.h"
+#include "stm32f3xx.h"
+
+/* Host kernel port.
+
+   hostport.c stands in for os_asm.s and the Cortex-M core, so the kernel sources build and
+	 run unmodified as a Linux program, for benchmarks and tests that need real tasks.  Each
+	 task runs on its own host stack.  An SVC pseudo-function is an ordinary call that builds
+	 an exception frame, calls the handler in "handler mode" and then runs PendSV if it was
+	 pended, exactly as the exception return would.  Time only moves when a task calls
+	 hostTick() or the idle task sleeps, so tasks are never preempted part way through a
+	 computation, and a test runs the same way every time.
+
+	 The kernel passes pointers around as 32-bit words, so everything it is given must live
+	 below 4 GiB: build with -no-pie, and keep kernel objects in static storage or on a task's
+	 stack, never on main()'s stack or in memory from mmap().
+
+	 Cycle counts are host nanoseconds (SystemCoreClock is 1 GHz), and a tick is 1 ms of
+	 cycles, however long it really took. */
+
+/* Runs one SysTick interrupt, and then PendSV if it asked for it.  Call it from a task to
+   let time pass while the task is busy. */
+void hostTick(void);
+
+/* Runs 'handler' as the handler of interrupt 'irq', and then PendSV if it asked for it.
+   Must be called from a task. */
+void hostInterrupt(IRQn_Type irq, void (* handler)(void));
+
+/* Marks the calling host thread as the handler of interrupt 'irq', for threads that stand in
+   for interrupts on another core.  Such threads may only use the FromISR functions. */
+void hostInterruptThread(IRQn_Type irq);
+
+/* If non-zero, the idle task waits in real time for other host threads to pend PendSV,
+   with ticks every real millisecond, instead of fast-forwarding to the next deadline. */
+void hostAsync(uint32_t enable);
+
+/* Stops the kernel and returns from OS_start() */
+void hostStop(void);
+
+/* Host time in nanoseconds since the program started */
+uint64_t hostNs(void);
+
+/* Kernel activity since the program started */
+typedef struct {
+	uint64_t svcs;       // SVC pseudo-function calls
+	uint64_t pendSVs;    // PendSV runs
+	uint64_t switches;   // context switches
+	uint64_t ticks;      // SysTick interrupts
+} hostCounters_t;
+
+void hostCounters(hostCounters_t * counters);
+
+/* Benchmark helpers */
+
+/* Summary of a set of samples */
+typedef struct {
+	uint32_t count;
+	uint64_t min;
+	uint64_t p50;
+	uint64_t p99;
+	uint64_t max;
+	double mean;
+} hostSummary_t;
+
+/* Sorts the samples and summarises them */
+void hostSummarise(uint64_t * samples, uint32_t count, hostSummary_t * summary);
+
+/* Prints a summary as one line: "<name>: n <count> min <min> p50 ... max <max> <unit>" */
+void hostPrintSummary(char const * name, hostSummary_t const * summary, char const * unit);
+
+/* Prints a failure and counts it.  hostExitStatus() is non-zero if there were any. */
+void hostFail(char const * format, ...);
+int hostExitStatus(void);
+
+#endif /* HOSTPORT_H */
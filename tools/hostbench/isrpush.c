@@ -0,0 +1,173 @@
+/* Interrupt-to-task latency through the deferred request ring (isr.c), with several
+   interrupts pushing at once.
+
+   Each interrupt is a host thread marked with hostInterruptThread(), and the kernel runs with
+	 hostAsync(), so pushes really do race each other and PendSV's drain.  Every pusher sends
+	 numbered messages to one queue with queueSendFromISR(), and waits for the receiving task
+	 to see each one before it sends the next, so there are never more requests in flight than
+	 pushers.  The time from just before the push to the receiving task having the message is
+	 summarised, along with the time the push itself took, for 1 to ISRPUSH_MAX_PUSHERS
+	 pushers.  Every message must arrive exactly once and in order for its pusher, and none may
+	 be dropped.  On a host with fewer CPUs than threads, the latency includes the host
+	 switching threads, so it is the growth with the number of pushers that matters.
+
+	 Then the receiving task locks a second queue, and one pusher sends it two messages,
+	 which PendSV has to hold back, before sending ISRPUSH_HELD_MESSAGES more to the first
+	 queue as above.  Those must all arrive, with their latency summarised, while the second
+	 queue is still locked: a held request only holds back the requests for its own object.
+	 The ring can't free slots past a held request, so that is as many as fit on the ring
+	 alongside the two.  Once the lock is let go the two held messages must arrive in order. */
+
+#include <stdio.h>
+#include <pthread.h>
+#include <sched.h>
+#include "hostport.h"
+#include "FixedPriorityScheduler.h"
+#include "queue.h"
+#include "isr.h"
+#include "critical.h"
+
+#define ISRPUSH_MAX_PUSHERS 8
+#define ISRPUSH_MESSAGES 20000
+#define ISRPUSH_HELD_MESSAGES (ISR_QUEUE_SIZE - 2)
+
+static OS_TCB_t _receiverTCB;
+static uint32_t _receiverStack[512] __attribute__((aligned(8)));
+static queue_t _queue, _held;
+static uint32_t _queueStorage[ISRPUSH_MAX_PUSHERS];
+static uint32_t _heldStorage[2];
+
+static IRQn_Type const _irqs[ISRPUSH_MAX_PUSHERS] = {
+	TIM2_IRQn, USART2_IRQn, DMA1_Channel6_IRQn, TIM2_IRQn, USART2_IRQn, DMA1_Channel6_IRQn, TIM2_IRQn, USART2_IRQn
+};
+
+/* Per pusher: when its latest message was pushed, and how many of its messages have arrived */
+static uint64_t volatile _stamps[ISRPUSH_MAX_PUSHERS];
+static uint32_t volatile _received[ISRPUSH_MAX_PUSHERS];
+static uint32_t _perPusher;
+static uint64_t _latencies[ISRPUSH_MESSAGES];
+static uint64_t _pushes[ISRPUSH_MESSAGES];
+
+static void * isrPusher(void * arg) {
+	uint32_t const pusher = (uint32_t)(uintptr_t) arg;
+	hostInterruptThread(_irqs[pusher]);
+	for (uint32_t sequence = 0; sequence < _perPusher; sequence++) {
+		uint32_t const message = (pusher << 24) | sequence;
+		uint64_t const start = hostNs();
+		_stamps[pusher] = start;
+		if (!queueSendFromISR(&_queue, &message)) {
+			hostFail("pusher %u's message %u was dropped", pusher, sequence);
+			break;
+		}
+		_pushes[pusher * _perPusher + sequence] = hostNs() - start;
+		while (__atomic_load_n(&_received[pusher], __ATOMIC_ACQUIRE) == sequence) {
+			sched_yield();
+		}
+	}
+	return 0;
+}
+
+/* Sends two messages to the held queue, then carries on as pusher 0 */
+static void * isrHeldPusher(void * arg) {
+	(void) arg;
+	hostInterruptThread(_irqs[0]);
+	for (uint32_t message = 1; message <= 2; message++) {
+		if (!queueSendFromISR(&_held, &message)) {
+			hostFail("held message %u was dropped", message);
+		}
+	}
+	return isrPusher(0);
+}
+
+/* Receives from the first queue while the second is locked */
+static void isrReceiveHeld(void) {
+	pthread_t thread;
+	hostSummary_t summary;
+	uint32_t const dropped = isrDropped();
+	_perPusher = ISRPUSH_HELD_MESSAGES;
+	_received[0] = 0;
+	mutexAquire(&_held.mutex);
+	pthread_create(&thread, 0, isrHeldPusher, 0);
+	for (uint32_t i = 0; i < ISRPUSH_HELD_MESSAGES; i++) {
+		uint32_t message;
+		queueReceive(&_queue, &message);
+		_latencies[i] = hostNs() - _stamps[0];
+		if (message != i) {
+			hostFail("held: got message %u out of turn", message);
+			break;
+		}
+		__atomic_store_n(&_received[0], i + 1, __ATOMIC_RELEASE);
+	}
+	pthread_join(thread, 0);
+	mutexRelease(&_held.mutex);
+	for (uint32_t expected = 1; expected <= 2; expected++) {
+		uint32_t message;
+		queueReceive(&_held, &message);
+		if (message != expected) {
+			hostFail("held: got held message %u when %u was due", message, expected);
+		}
+	}
+	if (isrDropped() != dropped) {
+		hostFail("held: %u requests dropped", isrDropped() - dropped);
+	}
+	hostSummarise(_pushes, ISRPUSH_HELD_MESSAGES, &summary);
+	hostPrintSummary("isrpush held push", &summary, "ns");
+	hostSummarise(_latencies, ISRPUSH_HELD_MESSAGES, &summary);
+	hostPrintSummary("isrpush held to task", &summary, "ns");
+}
+
+static void isrReceiver(void const * const arg) {
+	(void) arg;
+	pthread_t threads[ISRPUSH_MAX_PUSHERS];
+	hostSummary_t summary;
+	char name[32];
+	hostAsync(1);
+	for (uint32_t pushers = 1; pushers <= ISRPUSH_MAX_PUSHERS; pushers *= 2) {
+		uint32_t const dropped = isrDropped();
+		_perPusher = ISRPUSH_MESSAGES / pushers;
+		for (uint32_t i = 0; i < pushers; i++) {
+			_received[i] = 0;
+			pthread_create(&threads[i], 0, isrPusher, (void *)(uintptr_t) i);
+		}
+		for (uint32_t i = 0; i < _perPusher * pushers; i++) {
+			uint32_t message;
+			queueReceive(&_queue, &message);
+			uint32_t const pusher = message >> 24, sequence = message & 0xFFFFFF;
+			_latencies[i] = hostNs() - _stamps[pusher];
+			if (pusher >= pushers || sequence != _received[pusher]) {
+				hostFail("%u pushers: got message %u from pusher %u out of turn", pushers, sequence, pusher);
+				break;
+			}
+			__atomic_store_n(&_received[pusher], sequence + 1, __ATOMIC_RELEASE);
+		}
+		for (uint32_t i = 0; i < pushers; i++) {
+			pthread_join(threads[i], 0);
+		}
+		if (isrDropped() != dropped) {
+			hostFail("%u pushers: %u requests dropped", pushers, isrDropped() - dropped);
+		}
+		snprintf(name, sizeof(name), "isrpush %u push", pushers);
+		hostSummarise(_pushes, _perPusher * pushers, &summary);
+		hostPrintSummary(name, &summary, "ns");
+		snprintf(name, sizeof(name), "isrpush %u to task", pushers);
+		hostSummarise(_latencies, _perPusher * pushers, &summary);
+		hostPrintSummary(name, &summary, "ns");
+	}
+	isrReceiveHeld();
+	hostAsync(0);
+	hostStop();
+}
+
+int main(void) {
+	// Interrupts that may use the FromISR functions
+	NVIC_SetPriority(TIM2_IRQn, OS_MAX_SYSCALL_PRIORITY);
+	NVIC_SetPriority(USART2_IRQn, OS_MAX_SYSCALL_PRIORITY + 1);
+	NVIC_SetPriority(DMA1_Channel6_IRQn, OS_MAX_SYSCALL_PRIORITY + 2);
+	queueInit(&_queue, _queueStorage, ISRPUSH_MAX_PUSHERS, sizeof(uint32_t));
+	queueInit(&_held, _heldStorage, 2, sizeof(uint32_t));
+	OS_initialiseTCB(&_receiverTCB, _receiverStack + 512, isrReceiver, 0, HIGH);
+	OS_init(&fixedPriorityScheduler);
+	OS_addTask(&_receiverTCB);
+	OS_start();
+	return hostExitStatus();
+}
@@ -0,0 +1,154 @@
+/* The kernel's own latency histograms (latency.h), with the kernel built with them enabled.
+
+   First a task sleeps for one tick KERNLAT_TICKS times, so every wake is a switch from the
+	 idle task caused by a tick.  Then an interrupt thread, run with hostAsync(), releases a
+	 semaphore KERNLAT_IRQS times, each time once the task waiting on it has been switched out,
+	 so every release is a switch from the idle task caused by an interrupt request.  The
+	 host's time from just before each release to the task running is summarised alongside.
+
+	 Every path's bins must add up to its count, and its minimum, mean and maximum must be in
+	 order.  There must be a PendSV sample and a scheduler sample for every PendSV run, at
+	 least one tick-to-task sample per sleep, with a mean under one tick, and exactly one
+	 interrupt-to-task sample per release, none of them longer than the longest the host saw
+	 (the host port's core clock runs at 1 GHz, so a cycle is a nanosecond). */
+
+// cflags: -DOS_LATENCY_ENABLED=1
+
+#include <stdio.h>
+#include <pthread.h>
+#include <sched.h>
+#include "hostport.h"
+#include "FixedPriorityScheduler.h"
+#include "semaphore.h"
+#include "latency.h"
+#include "critical.h"
+#include "sleep.h"
+
+#define KERNLAT_TICKS 5000
+#define KERNLAT_IRQS 20000
+#define KERNLAT_SETTLE_NS 2000
+
+#if !OS_LATENCY_ENABLED
+#error "kernlat needs the kernel built with OS_LATENCY_ENABLED"
+#endif
+
+static OS_TCB_t _taskTCB;
+static uint32_t _taskStack[512] __attribute__((aligned(8)));
+static semaphore_t _semaphore;
+
+static uint32_t volatile _waiting;   // releases the task is ready for
+static uint64_t volatile _releaseNs;
+static uint64_t _latencies[KERNLAT_IRQS];
+
+static char const * const _names[OS_LATENCY_PATHS] = { "tick to task", "irq to task", "pendsv", "scheduler" };
+
+/* Checks one path's histogram, prints it and returns its count */
+static uint32_t kernlatCheck(uint32_t path) {
+	OS_latencyHistogram_t histogram;
+	uint32_t total = 0;
+	OS_latencyRead(path, &histogram, 1);
+	for (uint32_t bin = 0; bin < OS_LATENCY_BINS; bin++) {
+		total += histogram.bins[bin];
+	}
+	if (total != histogram.count) {
+		hostFail("%s: the bins add up to %u, not %u", _names[path], total, histogram.count);
+	}
+	if (!histogram.count) {
+		hostFail("%s: no samples", _names[path]);
+		return 0;
+	}
+	double const mean = (double) histogram.total / histogram.count;
+	if (histogram.min > mean || mean > histogram.max) {
+		hostFail("%s: min %u, mean %.0f and max %u are out of order", _names[path], histogram.min, mean, histogram.max);
+	}
+	printf("kernlat %s: n %u min %u mean %.0f max %u cycles\n", _names[path], histogram.count, histogram.min, mean, histogram.max);
+	return histogram.count;
+}
+
+/* Clears every histogram */
+static void kernlatReset(void) {
+	OS_latencyHistogram_t histogram;
+	for (uint32_t path = 0; path < OS_LATENCY_PATHS; path++) {
+		OS_latencyRead(path, &histogram, 1);
+	}
+}
+
+static void * kernlatInterrupt(void * arg) {
+	(void) arg;
+	hostInterruptThread(TIM2_IRQn);
+	for (uint32_t release = 0; release < KERNLAT_IRQS; release++) {
+		// Wait for the task to be waiting and switched out, then let the kernel settle
+		while (_waiting == release || OS_currentTCB() == &_taskTCB) {
+			sched_yield();
+		}
+		uint64_t const settle = hostNs();
+		while (hostNs() - settle < KERNLAT_SETTLE_NS) {
+		}
+		_releaseNs = hostNs();
+		semaphoreReleaseFromISR(&_semaphore, 1);
+	}
+	return 0;
+}
+
+static void kernlatTask(void const * const arg) {
+	(void) arg;
+	hostCounters_t before, after;
+	OS_latencyHistogram_t histogram;
+	hostSummary_t summary;
+	pthread_t thread;
+
+	// Ticks
+	kernlatReset();
+	hostCounters(&before);
+	for (uint32_t i = 0; i < KERNLAT_TICKS; i++) {
+		OS_sleep(1);
+	}
+	hostCounters(&after);
+	OS_latencyRead(OS_LATENCY_TICK_TO_TASK, &histogram, 0);
+	if (histogram.count < KERNLAT_TICKS) {
+		hostFail("ticks: %u tick-to-task samples for %u sleeps", histogram.count, KERNLAT_TICKS);
+	} else if (histogram.total / histogram.count >= OS_tickCycles()) {
+		hostFail("ticks: tick-to-task takes %u cycles on average, longer than a tick", (uint32_t)(histogram.total / histogram.count));
+	}
+	kernlatCheck(OS_LATENCY_TICK_TO_TASK);
+	// Read before the SVCs for the other two, whose PendSVs would be counted
+	uint32_t const pendSVs = kernlatCheck(OS_LATENCY_PENDSV);
+	uint32_t const schedules = kernlatCheck(OS_LATENCY_SCHEDULER);
+	if (pendSVs != after.pendSVs - before.pendSVs || schedules != pendSVs) {
+		hostFail("ticks: %u PendSV and %u scheduler samples for %u PendSV runs", pendSVs, schedules,
+			(uint32_t)(after.pendSVs - before.pendSVs));
+	}
+
+	// Interrupt requests
+	kernlatReset();
+	hostAsync(1);
+	pthread_create(&thread, 0, kernlatInterrupt, 0);
+	for (uint32_t i = 0; i < KERNLAT_IRQS; i++) {
+		_waiting = i + 1;
+		semaphoreAquire(&_semaphore, 1);
+		_latencies[i] = hostNs() - _releaseNs;
+	}
+	pthread_join(thread, 0);
+	hostAsync(0);
+	OS_latencyRead(OS_LATENCY_IRQ_TO_TASK, &histogram, 0);
+	hostSummarise(_latencies, KERNLAT_IRQS, &summary);
+	if (kernlatCheck(OS_LATENCY_IRQ_TO_TASK) != KERNLAT_IRQS) {
+		hostFail("irqs: %u interrupt-to-task samples for %u releases", histogram.count, KERNLAT_IRQS);
+	}
+	if (histogram.max > summary.max) {
+		hostFail("irqs: the kernel's longest interrupt-to-task sample, %u cycles, is longer than the host's %u ns",
+			histogram.max, (uint32_t) summary.max);
+	}
+	hostPrintSummary("kernlat irq to task, host", &summary, "ns");
+	hostStop();
+}
+
+int main(void) {
+	NVIC_SetPriority(TIM2_IRQn, OS_MAX_SYSCALL_PRIORITY);
+	semaphoreInit(&_semaphore, 0);
+	OS_initialiseTCB(&_taskTCB, _taskStack + 512, kernlatTask, 0, HIGH);
+	OS_init(&fixedPriorityScheduler);
+	OS_addTask(&_taskTCB);
+	OS_start();
+	return hostExitStatus();
+}
@@ -0,0 +1,171 @@
+/* What the lock contention profiler (lockstat.c) costs the objects it watches.
+
+   As it stands the profiler is compiled out; the lockstat variant builds the kernel with
+	 LOCKSTAT_ENABLED, and the difference between the two runs is its overhead, with
+	 lockstatInit()'s own measurement of a hook pair printed alongside.  One task takes and
+	 releases a mutex, a semaphore permit and a queue slot LOCKCOST_BATCHES times
+	 LOCKCOST_BATCH times each, uncontended, and the host time per pair is summarised over the
+	 batches.  Then two tasks take turns LOCKCOST_HANDOFFS times each with the mutex and then
+	 with a one-permit semaphore, yielding while they hold it and again after letting go, so
+	 nearly every acquire finds the object taken.
+
+	 With the profiler on, every acquire must have been counted, none of the uncontended ones
+	 may count as contended, and at least one in two of the contended ones must.  The report
+	 is printed at the end.  TIM2, the profiler's clock, counts host microseconds. */
+
+// variant: lockstat -DLOCKSTAT_ENABLED=1
+
+#include <stdio.h>
+#include "hostport.h"
+#include "FixedPriorityScheduler.h"
+#include "mutex.h"
+#include "semaphore.h"
+#include "queue.h"
+#include "lockstat.h"
+
+#define LOCKCOST_BATCHES 200
+#define LOCKCOST_BATCH 1000
+#define LOCKCOST_HANDOFFS 5000
+
+typedef enum {
+	LOCKCOST_MUTEX,
+	LOCKCOST_SEMAPHORE,
+	LOCKCOST_QUEUE,
+	LOCKCOST_OBJECTS
+} lockcostObject_e;
+
+static OS_TCB_t _benchTCB, _peerTCB;
+static uint32_t _benchStack[512] __attribute__((aligned(8)));
+static uint32_t _peerStack[512] __attribute__((aligned(8)));
+
+static OS_mutex_t _mutex;
+static semaphore_t _semaphore;
+static queue_t _queue;
+static uint32_t _queueStorage[4];
+
+static uint32_t volatile _contended;   // the object the tasks are taking turns with
+static uint32_t volatile _peerDone;
+static uint64_t _samples[LOCKCOST_BATCHES];
+
+/* Takes and releases one object once */
+static void lockcostPair(uint32_t object) {
+	uint32_t item = 0;
+	switch (object) {
+		case LOCKCOST_MUTEX:
+			mutexAquire(&_mutex);
+			mutexRelease(&_mutex);
+			break;
+		case LOCKCOST_SEMAPHORE:
+			semaphoreAquire(&_semaphore, 1);
+			semaphoreRelease(&_semaphore, 1);
+			break;
+		default:
+			queueSend(&_queue, &item);
+			queueReceive(&_queue, &item);
+			break;
+	}
+}
+
+/* Takes turns with the other task, LOCKCOST_HANDOFFS times */
+static void lockcostTurns(uint32_t object) {
+	for (uint32_t i = 0; i < LOCKCOST_HANDOFFS; i++) {
+		if (object == LOCKCOST_MUTEX) {
+			mutexAquire(&_mutex);
+			OS_yield();
+			mutexRelease(&_mutex);
+		} else {
+			semaphoreAquire(&_semaphore, 1);
+			OS_yield();
+			semaphoreRelease(&_semaphore, 1);
+		}
+		OS_yield();
+	}
+}
+
+static void lockcostPeer(void const * const arg) {
+	(void) arg;
+	lockcostTurns(_contended);
+	_peerDone = 1;
+}
+
+#if LOCKSTAT_ENABLED
+/* Checks the acquires and contended acquires counted since before was copied from stats */
+static void lockcostCheck(char const * name, lockstat_t const * stats, lockstat_t const * before,
+		uint32_t acquires, uint32_t minContended, uint32_t maxContended) {
+	uint32_t const counted = stats->acquires - before->acquires;
+	uint32_t const contended = stats->contended - before->contended;
+	if (counted != acquires) {
+		hostFail("%s: %u acquires counted, not %u", name, counted, acquires);
+	}
+	if (contended < minContended || contended > maxContended) {
+		hostFail("%s: %u contended acquires counted, expected %u to %u", name, contended, minContended, maxContended);
+	}
+}
+#endif
+
+static void lockcostBench(void const * const arg) {
+	static char const * const names[LOCKCOST_OBJECTS] = { "mutex", "semaphore", "queue" };
+	(void) arg;
+	char label[48];
+	hostSummary_t summary;
+
+	for (uint32_t object = 0; object < LOCKCOST_OBJECTS; object++) {
+		for (uint32_t batch = 0; batch < LOCKCOST_BATCHES; batch++) {
+			uint64_t const start = hostNs();
+			for (uint32_t i = 0; i < LOCKCOST_BATCH; i++) {
+				lockcostPair(object);
+			}
+			_samples[batch] = (hostNs() - start) / LOCKCOST_BATCH;
+		}
+		snprintf(label, sizeof(label), "lockcost %s", names[object]);
+		hostSummarise(_samples, LOCKCOST_BATCHES, &summary);
+		hostPrintSummary(label, &summary, "ns/pair");
+	}
+#if LOCKSTAT_ENABLED
+	lockstat_t const none = { 0 };
+	lockcostCheck("uncontended mutex", &_mutex.stats, &none, LOCKCOST_BATCHES * LOCKCOST_BATCH, 0, 0);
+	lockcostCheck("uncontended semaphore", &_semaphore.stats, &none, LOCKCOST_BATCHES * LOCKCOST_BATCH, 0, 0);
+	lockcostCheck("uncontended queue", &_queue.mutex.stats, &none, 2 * LOCKCOST_BATCHES * LOCKCOST_BATCH, 0, 0);
+#endif
+
+	for (_contended = LOCKCOST_MUTEX; _contended <= LOCKCOST_SEMAPHORE; _contended++) {
+#if LOCKSTAT_ENABLED
+		lockstat_t * const stats = _contended == LOCKCOST_MUTEX ? &_mutex.stats : &_semaphore.stats;
+		lockstat_t const before = *stats;
+#endif
+		_peerDone = 0;
+		OS_initialiseTCB(&_peerTCB, _peerStack + 512, lockcostPeer, 0, HIGH);
+		OS_addTask(&_peerTCB);
+		uint64_t const start = hostNs();
+		lockcostTurns(_contended);
+		while (!_peerDone) {
+			OS_yield();
+		}
+		printf("lockcost %s turns: %.0f ns per acquire\n", names[_contended],
+			(double)(hostNs() - start) / (2 * LOCKCOST_HANDOFFS));
+#if LOCKSTAT_ENABLED
+		lockcostCheck(_contended == LOCKCOST_MUTEX ? "mutex turns" : "semaphore turns", stats, &before,
+			2 * LOCKCOST_HANDOFFS, LOCKCOST_HANDOFFS, 2 * LOCKCOST_HANDOFFS);
+#endif
+	}
+
+#if LOCKSTAT_ENABLED
+	lockstatReport();
+#endif
+	hostStop();
+}
+
+int main(void) {
+	mutexInit(&_mutex);
+	semaphoreInit(&_semaphore, 1);
+	queueInit(&_queue, _queueStorage, 4, sizeof(uint32_t));
+	lockstatInit();
+	lockstatRegister(&_mutex.stats, "mutex");
+	lockstatRegister(&_semaphore.stats, "semaphore");
+	lockstatRegister(&_queue.mutex.stats, "queue");
+	OS_initialiseTCB(&_benchTCB, _benchStack + 512, lockcostBench, 0, HIGH);
+	OS_init(&fixedPriorityScheduler);
+	OS_addTask(&_benchTCB);
+	OS_start();
+	return hostExitStatus();
+}
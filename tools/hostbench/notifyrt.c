@@ -0,0 +1,108 @@
+/* Round trip between two tasks through direct-to-task notifications (OS/tasknotify.c),
+   against the same round trip through a pair of one-word queues (queue.c).
+
+   A client passes a number to a server and waits for the server to pass back one more,
+	 NOTIFYRT_TRIPS times: with OS_taskNotify(OS_NOTIFY_OVERWRITE) and OS_taskNotifyWait() as a
+	 one-word mailbox each way, with OS_taskNotify(OS_NOTIFY_INCREMENT) and OS_taskNotifyTake()
+	 as a semaphore each way (no payload), and with queueSend() and queueReceive().  Host time,
+	 SVCs and context switches per round trip are printed for each, and every reply must be
+	 the number that was sent plus one. */
+
+#include <stdio.h>
+#include "hostport.h"
+#include "FixedPriorityScheduler.h"
+#include "tasknotify.h"
+#include "queue.h"
+
+#define NOTIFYRT_TRIPS 200000
+
+typedef enum {
+	NOTIFYRT_MAILBOX,
+	NOTIFYRT_SEMAPHORE,
+	NOTIFYRT_QUEUE,
+	NOTIFYRT_KINDS
+} notifyrtKind_e;
+
+static OS_TCB_t _clientTCB, _serverTCBs[NOTIFYRT_KINDS];
+static uint32_t _clientStack[512] __attribute__((aligned(8)));
+static uint32_t _serverStacks[NOTIFYRT_KINDS][512] __attribute__((aligned(8)));
+static queue_t _requests, _replies;
+static uint32_t _requestStorage[1], _replyStorage[1];
+
+static char const * const _names[NOTIFYRT_KINDS] = { "notify mailbox", "notify semaphore", "queue" };
+
+/* One server for each kind, so none is left waiting the wrong way when the kind changes */
+static void notifyrtServer(void const * const arg) {
+	notifyrtKind_e const kind = (notifyrtKind_e)(uintptr_t) arg;
+	while (1) {
+		uint32_t value;
+		switch (kind) {
+		case NOTIFYRT_MAILBOX:
+			value = OS_taskNotifyWait(0xFFFFFFFF);
+			OS_taskNotify(&_clientTCB, value + 1, OS_NOTIFY_OVERWRITE);
+			break;
+		case NOTIFYRT_SEMAPHORE:
+			OS_taskNotifyTake();
+			OS_taskNotify(&_clientTCB, 0, OS_NOTIFY_INCREMENT);
+			break;
+		default:
+			queueReceive(&_requests, &value);
+			value++;
+			queueSend(&_replies, &value);
+			break;
+		}
+	}
+}
+
+static void notifyrtClient(void const * const arg) {
+	(void) arg;
+	for (notifyrtKind_e kind = 0; kind < NOTIFYRT_KINDS; kind++) {
+		OS_TCB_t * const server = &_serverTCBs[kind];
+		hostCounters_t before, after;
+		hostCounters(&before);
+		uint64_t const start = hostNs();
+		for (uint32_t i = 0; i < NOTIFYRT_TRIPS; i++) {
+			uint32_t reply = i + 1;
+			switch (kind) {
+			case NOTIFYRT_MAILBOX:
+				OS_taskNotify(server, i, OS_NOTIFY_OVERWRITE);
+				reply = OS_taskNotifyWait(0xFFFFFFFF);
+				break;
+			case NOTIFYRT_SEMAPHORE:
+				OS_taskNotify(server, 0, OS_NOTIFY_INCREMENT);
+				if (OS_taskNotifyTake() != 1) {
+					hostFail("%s: more than one reply was pending", _names[kind]);
+				}
+				break;
+			default:
+				queueSend(&_requests, &i);
+				queueReceive(&_replies, &reply);
+				break;
+			}
+			if (reply != i + 1) {
+				hostFail("%s: sent %u, got %u back", _names[kind], i, reply);
+				break;
+			}
+		}
+		uint64_t const ns = hostNs() - start;
+		hostCounters(&after);
+		printf("notifyrt %s: %.1f ns, %.2f SVCs and %.2f switches per round trip\n", _names[kind],
+			(double) ns / NOTIFYRT_TRIPS, (double)(after.svcs - before.svcs) / NOTIFYRT_TRIPS,
+			(double)(after.switches - before.switches) / NOTIFYRT_TRIPS);
+	}
+	hostStop();
+}
+
+int main(void) {
+	queueInit(&_requests, _requestStorage, 1, sizeof(uint32_t));
+	queueInit(&_replies, _replyStorage, 1, sizeof(uint32_t));
+	OS_initialiseTCB(&_clientTCB, _clientStack + 512, notifyrtClient, 0, HIGH);
+	OS_init(&fixedPriorityScheduler);
+	OS_addTask(&_clientTCB);
+	for (uint32_t kind = 0; kind < NOTIFYRT_KINDS; kind++) {
+		OS_initialiseTCB(&_serverTCBs[kind], _serverStacks[kind] + 512, notifyrtServer, (void const *)(uintptr_t) kind, HIGH);
+		OS_addTask(&_serverTCBs[kind]);
+	}
+	OS_start();
+	return hostExitStatus();
+}
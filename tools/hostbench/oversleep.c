@@ -0,0 +1,56 @@
+/* How late OS_sleep() returns while another task is using the CPU.
+
+   A busy task of the same priority runs ticks back to back with hostTick(), never yielding,
+	 while a sleeper sleeps for 1 to OVERSLEEP_MAX ticks.  OS_sleep(n) must return on the first
+	 tick more than n ticks after the call, however much of its time slice the busy task has
+	 left.  (OS_sleepUs() isn't covered: its final spin on OS_nowUs() would never see the host's
+	 clock reach the next tick.) */
+
+#include <stdio.h>
+#include "hostport.h"
+#include "FixedPriorityScheduler.h"
+#include "sleep.h"
+
+#define OVERSLEEP_MAX 40
+
+static OS_TCB_t _busyTCB, _sleeperTCB;
+static uint32_t _busyStack[512] __attribute__((aligned(8)));
+static uint32_t _sleeperStack[512] __attribute__((aligned(8)));
+static uint32_t volatile _done = 0;
+
+static void oversleepBusy(void const * const arg) {
+	(void) arg;
+	while (!_done) {
+		hostTick();
+	}
+}
+
+static void oversleepSleeper(void const * const arg) {
+	(void) arg;
+	uint32_t worst = 0;
+	for (uint32_t n = 1; n <= OVERSLEEP_MAX; n++) {
+		uint32_t const start = OS_elapsedTicks();
+		OS_sleep(n);
+		uint32_t const slept = OS_elapsedTicks() - start;
+		if (slept != n + 1) {
+			hostFail("OS_sleep(%u) took %u ticks", n, slept);
+		}
+		if (slept - n > worst) {
+			worst = slept - n;
+		}
+	}
+	printf("oversleep: OS_sleep(n) took at most n + %u ticks\n", worst);
+
+	_done = 1;
+	hostStop();
+}
+
+int main(void) {
+	OS_initialiseTCB(&_busyTCB, _busyStack + 512, oversleepBusy, 0, HIGH);
+	OS_initialiseTCB(&_sleeperTCB, _sleeperStack + 512, oversleepSleeper, 0, HIGH);
+	OS_init(&fixedPriorityScheduler);
+	OS_addTask(&_busyTCB);
+	OS_addTask(&_sleeperTCB);
+	OS_start();
+	return hostExitStatus();
+}
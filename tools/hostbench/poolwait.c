@@ -0,0 +1,135 @@
+/* How soon a task waiting for a memory pool block (memory.c) gets one, blocking in
+   pool_allocate_wait() against polling pool_allocate() with OS_sleep() in between.
+
+   The pool has one block.  A releaser task holds it for 1 to POOLWAIT_MAX_HOLD ticks, frees
+	 it and takes it back from an allocator task through a second pool, POOLWAIT_ROUNDS times
+	 after a first round that isn't counted, in which the allocator is still waiting the old way.
+	 The allocator waits with POOL_WAIT_FOREVER, which is the cost of waiting itself; waits
+	 with a timeout of POOLWAIT_TIMEOUT ticks, shorter than some of the holds, which checks
+	 the timeout path, as the timer on its stack often fires and is stopped and reused; or
+	 polls every POOLWAIT_POLL ticks.  The time from the free to the allocator having the block
+	 is summarised in ticks and in host nanoseconds, with SVCs per allocation (both tasks'
+	 SVCs for the round, the releaser's sleep included).  A waiting allocator must have the
+	 block within the tick it was freed in, a wait forever must never time out, and a
+	 timed-out wait must never have been shorter than its timeout. */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include "hostport.h"
+#include "FixedPriorityScheduler.h"
+#include "memory.h"
+#include "timer.h"
+#include "sleep.h"
+
+#define POOLWAIT_ROUNDS 20000
+#define POOLWAIT_MAX_HOLD 6
+#define POOLWAIT_TIMEOUT 3
+#define POOLWAIT_POLL 1
+
+/* How the allocator waits for the block */
+typedef enum {
+	POOLWAIT_FOREVER,
+	POOLWAIT_TIMED,
+	POOLWAIT_POLLING,
+	POOLWAIT_MODES
+} poolwaitMode_e;
+
+static OS_TCB_t _releaserTCB, _allocatorTCB;
+static uint32_t _releaserStack[512] __attribute__((aligned(8)));
+static uint32_t _allocatorStack[512] __attribute__((aligned(8)));
+static pool_t _pool, _returns;
+static uint32_t _block[4] __attribute__((aligned(8)));
+
+static uint32_t volatile _mode;
+static uint32_t _round;
+static uint32_t _releaseTick;
+static uint64_t _releaseNs;
+static uint64_t _ticks[POOLWAIT_ROUNDS + 1], _ns[POOLWAIT_ROUNDS + 1];
+static uint32_t _timeouts;
+
+static void poolwaitAllocator(void const * const arg) {
+	(void) arg;
+	while (1) {
+		void * block;
+		if (_mode == POOLWAIT_POLLING) {
+			while (!(block = pool_allocate(&_pool))) {
+				OS_sleep(POOLWAIT_POLL);
+			}
+		} else if (_mode == POOLWAIT_FOREVER) {
+			if (!(block = pool_allocate_wait(&_pool, POOL_WAIT_FOREVER))) {
+				hostFail("round %u: a wait forever timed out", _round);
+				continue;
+			}
+		} else {
+			uint32_t start = OS_elapsedTicks();
+			while (!(block = pool_allocate_wait(&_pool, POOLWAIT_TIMEOUT))) {
+				if (OS_elapsedTicks() - start < POOLWAIT_TIMEOUT) {
+					hostFail("a wait timed out after %u ticks", OS_elapsedTicks() - start);
+				}
+				_timeouts++;
+				start = OS_elapsedTicks();
+			}
+		}
+		uint64_t const ns = hostNs();
+		if (block != _block) {
+			hostFail("round %u: got %p, not the pool's block", _round, block);
+		}
+		_ticks[_round] = OS_elapsedTicks() - _releaseTick;
+		_ns[_round] = ns - _releaseNs;
+		pool_deallocate(&_returns, block);
+	}
+}
+
+static void poolwaitReleaser(void const * const arg) {
+	void * block = _block;
+	(void) arg;
+	srand(1);
+	for (_mode = 0; _mode < POOLWAIT_MODES; _mode++) {
+		static char const * const names[POOLWAIT_MODES] = { "wait", "timed wait", "poll" };
+		char const * const name = names[_mode];
+		char label[48];
+		hostCounters_t before, after;
+		hostSummary_t summary;
+		for (_round = 0; _round <= POOLWAIT_ROUNDS; _round++) {
+			if (_round == 1) {
+				_timeouts = 0;
+				hostCounters(&before);
+			}
+			OS_sleep(1 + (uint32_t) rand() % POOLWAIT_MAX_HOLD);
+			_releaseTick = OS_elapsedTicks();
+			_releaseNs = hostNs();
+			pool_deallocate(&_pool, block);
+			block = pool_allocate_wait(&_returns, POOL_WAIT_FOREVER);
+		}
+		hostCounters(&after);
+		for (uint32_t round = 1; _mode != POOLWAIT_POLLING && round <= POOLWAIT_ROUNDS; round++) {
+			if (_ticks[round]) {
+				hostFail("%s, round %u: the block took %u ticks to arrive", name, round, (uint32_t) _ticks[round]);
+				break;
+			}
+		}
+		printf("poolwait %s: %.3f SVCs per allocation, %u timeouts\n", name,
+			(double)(after.svcs - before.svcs) / POOLWAIT_ROUNDS, _timeouts);
+		snprintf(label, sizeof(label), "poolwait %s latency", name);
+		hostSummarise(_ticks + 1, POOLWAIT_ROUNDS, &summary);
+		hostPrintSummary(label, &summary, "ticks");
+		hostSummarise(_ns + 1, POOLWAIT_ROUNDS, &summary);
+		hostPrintSummary(label, &summary, "ns");
+	}
+	hostStop();
+}
+
+int main(void) {
+	pool_init(&_pool);
+	pool_init(&_returns);
+	OS_initialiseTCB(&_releaserTCB, _releaserStack + 512, poolwaitReleaser, 0, HIGH);
+	OS_initialiseTCB(&_allocatorTCB, _allocatorStack + 512, poolwaitAllocator, 0, HIGH);
+	OS_init(&fixedPriorityScheduler);
+	OS_addTask(&_releaserTCB);
+	OS_addTask(&_allocatorTCB);
+	if (!OS_timerServiceStart(HIGH)) {
+		hostFail("timer service didn't start");
+	}
+	OS_start();
+	return hostExitStatus();
+}
@@ -0,0 +1,149 @@
+/* Latency of urgent messages mixed into bulk traffic, through a priority queue (pqueue.c)
+   against the same traffic through a FIFO queue (queue.c).
+
+   A bulk task sends messages as fast as the queue takes them, and an urgent task sends one
+	 every 1 to PQLAT_URGENT_GAP ticks.  The bench task receives everything and does a tick's
+	 work every PQLAT_PER_TICK messages.  For PQLAT_URGENTS urgent messages the time from the
+	 urgent task calling send (so including any wait for space) to the message being received
+	 is summarised in ticks and host nanoseconds, with the number of messages received in
+	 between.  The priority queue has PQLAT_CAPACITY slots with PQLAT_RESERVE kept for urgent
+	 messages, and the FIFO the same PQLAT_CAPACITY.  Through the priority queue at most one
+	 bulk message, one already on its way out, may be received before an urgent one, and the
+	 messages of each kind must arrive in the order they were sent. */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include "hostport.h"
+#include "FixedPriorityScheduler.h"
+#include "pqueue.h"
+#include "queue.h"
+#include "sleep.h"
+
+#define PQLAT_CAPACITY 10
+#define PQLAT_RESERVE 2
+#define PQLAT_URGENTS 5000
+#define PQLAT_URGENT_GAP 5
+#define PQLAT_PER_TICK 2
+
+typedef enum {
+	PQLAT_BULK,
+	PQLAT_URGENT,
+	PQLAT_END
+} pqlatKind_e;
+
+typedef struct {
+	uint32_t kind;
+	uint32_t seq;
+	uint32_t tick;        // when the sender called send
+	uint32_t received;    // messages the bench task had received by then
+	uint64_t ns;
+} pqlatMessage_t;
+
+static OS_TCB_t _benchTCB, _bulkTCB, _urgentTCB;
+static uint32_t _benchStack[512] __attribute__((aligned(8)));
+static uint32_t _bulkStack[512] __attribute__((aligned(8)));
+static uint32_t _urgentStack[512] __attribute__((aligned(8)));
+
+static pqueue_t _pqueue;
+static queue_t _queue;
+static uint32_t _pqueueStorage[PQUEUE_BUFFER_SIZE(PQLAT_CAPACITY, sizeof(pqlatMessage_t)) / sizeof(uint32_t)];
+static pqlatMessage_t _queueStorage[PQLAT_CAPACITY];
+
+static uint32_t _usePqueue;
+static uint32_t volatile _received;
+static uint32_t volatile _stop;
+static uint64_t _ticks[PQLAT_URGENTS], _ns[PQLAT_URGENTS], _ahead[PQLAT_URGENTS];
+
+static void pqlatSend(pqlatKind_e kind, uint32_t seq) {
+	pqlatMessage_t message = { kind, seq, OS_elapsedTicks(), _received, hostNs() };
+	if (_usePqueue) {
+		pqueueSend(&_pqueue, &message, kind == PQLAT_URGENT ? PQUEUE_URGENT : 0);
+	} else {
+		queueSend(&_queue, &message);
+	}
+}
+
+static void pqlatBulk(void const * const arg) {
+	(void) arg;
+	uint32_t seq = 0;
+	while (!_stop) {
+		pqlatSend(PQLAT_BULK, seq++);
+	}
+	pqlatSend(PQLAT_END, seq);
+}
+
+static void pqlatUrgent(void const * const arg) {
+	(void) arg;
+	for (uint32_t seq = 0; seq < PQLAT_URGENTS; seq++) {
+		OS_sleep(1 + (uint32_t) rand() % PQLAT_URGENT_GAP);
+		pqlatSend(PQLAT_URGENT, seq);
+	}
+	_stop = 1;
+}
+
+static void pqlatBench(void const * const arg) {
+	(void) arg;
+	srand(1);
+	pqueueInit(&_pqueue, _pqueueStorage, PQLAT_CAPACITY, sizeof(pqlatMessage_t), PQLAT_RESERVE);
+	queueInit(&_queue, _queueStorage, PQLAT_CAPACITY, sizeof(pqlatMessage_t));
+	for (_usePqueue = 0; _usePqueue < 2; _usePqueue++) {
+		char const * const name = _usePqueue ? "pqueue" : "queue";
+		uint32_t expected[2] = { 0, 0 }, worstAhead = 0;
+		hostSummary_t summary;
+		_stop = 0;
+		_received = 0;
+		OS_initialiseTCB(&_bulkTCB, _bulkStack + 512, pqlatBulk, 0, HIGH);
+		OS_initialiseTCB(&_urgentTCB, _urgentStack + 512, pqlatUrgent, 0, HIGH);
+		OS_addTask(&_bulkTCB);
+		OS_addTask(&_urgentTCB);
+		while (1) {
+			pqlatMessage_t message;
+			if (_usePqueue) {
+				pqueueReceive(&_pqueue, &message);
+			} else {
+				queueReceive(&_queue, &message);
+			}
+			if (message.kind == PQLAT_END) {
+				break;
+			}
+			if (message.seq != expected[message.kind]) {
+				hostFail("%s: %s message %u arrived when %u was due", name,
+					message.kind == PQLAT_URGENT ? "urgent" : "bulk", message.seq, expected[message.kind]);
+			}
+			expected[message.kind] = message.seq + 1;
+			if (message.kind == PQLAT_URGENT) {
+				_ticks[message.seq] = OS_elapsedTicks() - message.tick;
+				_ns[message.seq] = hostNs() - message.ns;
+				_ahead[message.seq] = _received - message.received;
+				if (_ahead[message.seq] > worstAhead) {
+					worstAhead = (uint32_t) _ahead[message.seq];
+				}
+			}
+			if (++_received % PQLAT_PER_TICK == 0) {
+				hostTick();
+			}
+		}
+		if (expected[PQLAT_URGENT] != PQLAT_URGENTS) {
+			hostFail("%s: only %u urgent messages arrived", name, expected[PQLAT_URGENT]);
+		}
+		if (_usePqueue && worstAhead > 1) {
+			hostFail("%s: %u messages were received before an urgent one", name, worstAhead);
+		}
+		printf("pqlatency %s: %u urgent and %u bulk messages\n", name, expected[PQLAT_URGENT], expected[PQLAT_BULK]);
+		hostSummarise(_ticks, PQLAT_URGENTS, &summary);
+		hostPrintSummary(_usePqueue ? "pqlatency pqueue urgent latency" : "pqlatency queue urgent latency", &summary, "ticks");
+		hostSummarise(_ns, PQLAT_URGENTS, &summary);
+		hostPrintSummary(_usePqueue ? "pqlatency pqueue urgent latency" : "pqlatency queue urgent latency", &summary, "ns");
+		hostSummarise(_ahead, PQLAT_URGENTS, &summary);
+		hostPrintSummary(_usePqueue ? "pqlatency pqueue received first" : "pqlatency queue received first", &summary, "messages");
+	}
+	hostStop();
+}
+
+int main(void) {
+	OS_initialiseTCB(&_benchTCB, _benchStack + 512, pqlatBench, 0, HIGH);
+	OS_init(&fixedPriorityScheduler);
+	OS_addTask(&_benchTCB);
+	OS_start();
+	return hostExitStatus();
+}
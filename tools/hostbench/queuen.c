@@ -0,0 +1,113 @@
+/* Queue throughput against the number of elements moved per call (queueSendN() and
+   queueReceiveN()), and the batch path's handling of queues it can't serve.
+
+   A producer sends QUEUEN_ELEMENTS numbered elements to a consumer through a queue of
+	 QUEUEN_CAPACITY, in runs of 1, 2, 4 ... QUEUEN_CAPACITY elements per call on both sides.
+	 Elements per second of host time and SVCs per element are printed for each run length, and
+	 every element must arrive once and in order.  Finally a batched send to a queue of 8-byte
+	 elements, which an operation's 4-byte value can't carry, must be skipped, leaving the
+	 queue empty, while the operations around it are carried out. */
+
+#include <stdio.h>
+#include "hostport.h"
+#include "FixedPriorityScheduler.h"
+#include "queue.h"
+#include "batch.h"
+
+#define QUEUEN_CAPACITY 64
+#define QUEUEN_ELEMENTS 200000
+
+static OS_TCB_t _producerTCB, _consumerTCB;
+static uint32_t _producerStack[512] __attribute__((aligned(8)));
+static uint32_t _consumerStack[512] __attribute__((aligned(8)));
+static queue_t _queue;
+static uint32_t _queueStorage[QUEUEN_CAPACITY];
+static uint32_t _run;
+static uint32_t volatile _consumed;
+
+static queue_t _wideQueue, _narrowQueue;
+static uint64_t _wideStorage[4];
+static uint32_t _narrowStorage[4];
+
+static void queuenProducer(void const * const arg) {
+	uint32_t items[QUEUEN_CAPACITY];
+	(void) arg;
+	for (_run = 1; _run <= QUEUEN_CAPACITY; _run *= 2) {
+		hostCounters_t before, after;
+		_consumed = 0;
+		hostCounters(&before);
+		uint64_t const start = hostNs();
+		for (uint32_t sent = 0; sent < QUEUEN_ELEMENTS; sent += _run) {
+			for (uint32_t i = 0; i < _run; i++) {
+				items[i] = sent + i;
+			}
+			queueSendN(&_queue, items, _run);
+		}
+		// Wait for the consumer to take the last of them
+		while (_consumed != QUEUEN_ELEMENTS) {
+			OS_yield();
+		}
+		uint64_t const ns = hostNs() - start;
+		hostCounters(&after);
+		printf("queuen: %2u per call: %.2f M elements/s, %.2f SVCs and %.3f switches per element\n",
+			_run, QUEUEN_ELEMENTS / (ns / 1e3),
+			(double)(after.svcs - before.svcs) / QUEUEN_ELEMENTS,
+			(double)(after.switches - before.switches) / QUEUEN_ELEMENTS);
+	}
+
+	// A batch with a send that doesn't fit in an operation between two that do
+	batchOp_t const ops[] = {
+		{ BATCH_QUEUE_SEND, &_narrowQueue, 1 },
+		{ BATCH_QUEUE_SEND, &_wideQueue, 2 },
+		{ BATCH_QUEUE_SEND, &_narrowQueue, 3 }
+	};
+	hostCounters_t before, after;
+	hostCounters(&before);
+	batchSubmit(ops, 3);
+	hostCounters(&after);
+	uint32_t first = 0, second = 0;
+	uint64_t wide;
+	if (!queueTryReceive(&_narrowQueue, &first) || !queueTryReceive(&_narrowQueue, &second) || first != 1 || second != 3) {
+		hostFail("batch: the sends around the skipped one gave %u and %u", first, second);
+	}
+	if (queueTryReceive(&_wideQueue, &wide)) {
+		hostFail("batch: an 8-byte element was sent from a 4-byte value");
+	}
+	if (after.svcs - before.svcs != 1) {
+		hostFail("batch: skipping a send took %llu SVCs", (unsigned long long)(after.svcs - before.svcs));
+	}
+	hostStop();
+}
+
+static void queuenConsumer(void const * const arg) {
+	uint32_t items[QUEUEN_CAPACITY];
+	uint32_t expected = 0;
+	(void) arg;
+	while (1) {
+		uint32_t const received = queueReceiveN(&_queue, items, _run);
+		for (uint32_t i = 0; i < received; i++) {
+			if (items[i] != expected) {
+				hostFail("%u per call: got element %u where %u was due", _run, items[i], expected);
+				hostStop();
+			}
+			expected++;
+		}
+		if (expected == QUEUEN_ELEMENTS) {
+			expected = 0;
+		}
+		_consumed += received;
+	}
+}
+
+int main(void) {
+	queueInit(&_queue, _queueStorage, QUEUEN_CAPACITY, sizeof(uint32_t));
+	queueInit(&_wideQueue, _wideStorage, 4, sizeof(uint64_t));
+	queueInit(&_narrowQueue, _narrowStorage, 4, sizeof(uint32_t));
+	OS_initialiseTCB(&_producerTCB, _producerStack + 512, queuenProducer, 0, HIGH);
+	OS_initialiseTCB(&_consumerTCB, _consumerStack + 512, queuenConsumer, 0, HIGH);
+	OS_init(&fixedPriorityScheduler);
+	OS_addTask(&_producerTCB);
+	OS_addTask(&_consumerTCB);
+	OS_start();
+	return hostExitStatus();
+}
@@ -0,0 +1,65 @@
+#!/bin/sh
+# Builds the kernel for the host with the port in hostport.c, and runs the benchmarks.
+#
+#   tools/hostbench/run.sh              build and run every benchmark
+#   tools/hostbench/run.sh smoke churn  only these ones
+#
+# A benchmark that needs the kernel built differently says so in a line of its own, such as
+#   // cflags: -DOS_LATENCY_ENABLED=1
+# and those flags are added for the kernel and the benchmark alike.  A line such as
+#   // variant: wrap -DOS_INITIAL_TICKS=0xFFFFF000u
+# has it built and run a second time as <bench>.wrap, with those flags as well.
+#
+# Binaries go to $OUT (default /tmp/hostbench).  The exit status is non-zero if anything fails
+# to build, or any benchmark reports a failure.
+
+set -e
+
+root=$(cd "$(dirname "$0")/../.." && pwd)
+out=${OUT:-/tmp/hostbench}
+cc=${CC:-gcc}
+mkdir -p "$out"
+
+# The kernel only works with pointers below 4 GiB, hence -no-pie (see hostport.h).  heap.c's
+# end-of-arena sentinel is only a block header, which GCC takes for an overrun.
+cflags="-std=gnu99 -O2 -g -no-pie -fno-pie -Wall -Wno-pointer-to-int-cast -Wno-int-to-pointer-cast -Wno-array-bounds \
+	-I$root/tools/hostbench -I$root/OS -I$root -include stm32f3xx.h"
+
+kernel="OS/os.c OS/timer.c OS/idle.c OS/latency.c OS/tasknotify.c \
+	isr.c batch.c mutex.c cond.c semaphore.c lockstat.c queue.c queueset.c pqueue.c sleep.c memory.c heap.c \
+	seqlock.c rwlock.c streambuffer.c coroutine.c \
+	FixedPriorityScheduler.c simpleRoundRobin.c OS/waittable.c tools/hostbench/hostport.c"
+
+if [ $# -eq 0 ]; then
+	set -- $(cd "$root/tools/hostbench" && ls *.c | grep -v '^hostport\.c$' | sed 's/\.c$//')
+fi
+
+# Builds and runs one benchmark: its name, the binary's name and any extra flags
+run() {
+	echo "== $2"
+	sources=""
+	for source in $kernel tools/hostbench/$1.c; do
+		sources="$sources $root/$source"
+	done
+	$cc $cflags $3 -o "$out/$2" $sources -lm -lpthread
+	if ! "$out/$2"; then
+		echo "== $2 FAILED"
+		status=1
+	fi
+}
+
+status=0
+for bench in "$@"; do
+	extra=$(sed -n 's|^// cflags: ||p' "$root/tools/hostbench/$bench.c")
+	run "$bench" "$bench" "$extra"
+	# Not a pipe: the loop must run in this shell to set status
+	variants=$(sed -n 's|^// variant: ||p' "$root/tools/hostbench/$bench.c")
+	while read -r variant flags; do
+		if [ -n "$variant" ]; then
+			run "$bench" "$bench.$variant" "$extra $flags" < /dev/null
+		fi
+	done <<-EOF
+		$variants
+	EOF
+done
+exit $status
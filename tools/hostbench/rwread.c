@@ -0,0 +1,134 @@
+/* Read-heavy throughput of a table behind a reader-writer lock (rwlock.c), against the same
+   table behind the recursive mutex (mutex.c), with one writer and 1, 2, 4 or 8 readers.
+
+   Readers look the whole table up over and over, calling hostTick() every
+	 RWREAD_READS_PER_TICK lookups.  A random half of those ticks are taken with the lock held,
+	 as in a long table walk, so the writer can be woken while a reader holds the lock.  The
+	 rest are taken between lookups and followed by OS_yield(), as if the reader were waiting
+	 for its next request, which is where the writer gets its chance at the mutex.  The writer
+	 rewrites the table every RWREAD_WRITE_EVERY ticks.  Lookups per second of host time, the
+	 SVCs and context switches per lookup and the number of updates are printed for each case:
+	 readers of the mutex queue up behind each other and the writer, readers of the rwlock only
+	 behind the writer.  Every lookup must see the table as one update left it. */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include "hostport.h"
+#include "FixedPriorityScheduler.h"
+#include "rwlock.h"
+#include "mutex.h"
+#include "sleep.h"
+
+#define RWREAD_MAX_READERS 8
+#define RWREAD_WORDS 16
+#define RWREAD_TICKS 4000
+#define RWREAD_READS_PER_TICK 50
+#define RWREAD_WRITE_EVERY 10
+
+static OS_TCB_t _writerTCB, _readerTCBs[RWREAD_MAX_READERS];
+static uint32_t _writerStack[512] __attribute__((aligned(8)));
+static uint32_t _readerStacks[RWREAD_MAX_READERS][512] __attribute__((aligned(8)));
+
+static OS_rwlock_t _rwlock;
+static OS_mutex_t _mutex;
+static uint32_t _table[RWREAD_WORDS];
+
+static uint32_t _useMutex;
+static uint32_t volatile _stop;
+static uint32_t volatile _running;
+static uint64_t _reads;
+
+static void rwreadReader(void const * const arg) {
+	uint32_t copy[RWREAD_WORDS];
+	uint64_t reads = 0;
+	(void) arg;
+	while (!_stop) {
+		if (_useMutex) {
+			mutexAquire(&_mutex);
+		} else {
+			rwlockReadAquire(&_rwlock);
+		}
+		for (uint32_t i = 0; i < RWREAD_WORDS; i++) {
+			copy[i] = _table[i];
+		}
+		// 1 for a tick with the lock held, 2 for one after it, 0 for none
+		uint32_t const tick = ++reads % RWREAD_READS_PER_TICK ? 0 : 1 + (uint32_t) rand() % 2;
+		if (tick == 1) {
+			hostTick();
+		}
+		for (uint32_t i = 1; i < RWREAD_WORDS; i++) {
+			if (copy[i] != copy[0] || _table[i] != copy[0]) {
+				hostFail("%s: the table changed under a reader (%u and %u)", _useMutex ? "mutex" : "rwlock", copy[0], copy[i]);
+				break;
+			}
+		}
+		if (_useMutex) {
+			mutexRelease(&_mutex);
+		} else {
+			rwlockReadRelease(&_rwlock);
+		}
+		if (tick == 2) {
+			hostTick();
+			OS_yield();
+		}
+	}
+	_reads += reads;
+	_running--;
+}
+
+static void rwreadWriter(void const * const arg) {
+	(void) arg;
+	srand(1);
+	rwlockInit(&_rwlock);
+	mutexInit(&_mutex);
+	for (_useMutex = 0; _useMutex < 2; _useMutex++) {
+		for (uint32_t readers = 1; readers <= RWREAD_MAX_READERS; readers *= 2) {
+			hostCounters_t before, after;
+			_stop = 0;
+			_reads = 0;
+			_running = readers;
+			for (uint32_t i = 0; i < readers; i++) {
+				OS_initialiseTCB(&_readerTCBs[i], _readerStacks[i] + 512, rwreadReader, 0, HIGH);
+				OS_addTask(&_readerTCBs[i]);
+			}
+			hostCounters(&before);
+			uint64_t const start = hostNs();
+			uint32_t const began = OS_elapsedTicks();
+			uint32_t update;
+			for (update = 1; OS_elapsedTicks() - began < RWREAD_TICKS; update++) {
+				OS_sleep(RWREAD_WRITE_EVERY);
+				if (_useMutex) {
+					mutexAquire(&_mutex);
+				} else {
+					rwlockWriteAquire(&_rwlock);
+				}
+				for (uint32_t i = 0; i < RWREAD_WORDS; i++) {
+					_table[i] = update;
+				}
+				if (_useMutex) {
+					mutexRelease(&_mutex);
+				} else {
+					rwlockWriteRelease(&_rwlock);
+				}
+			}
+			_stop = 1;
+			while (_running) {
+				OS_yield();
+			}
+			uint64_t const ns = hostNs() - start;
+			hostCounters(&after);
+			printf("rwread %s, readers %u: %.2f M lookups/s, %.3f SVCs and %.4f switches per lookup, %u updates\n",
+				_useMutex ? "mutex" : "rwlock", readers, _reads / (ns / 1e3),
+				(double)(after.svcs - before.svcs) / _reads, (double)(after.switches - before.switches) / _reads, update - 1);
+		}
+	}
+	hostStop();
+}
+
+int main(void) {
+	OS_initialiseTCB(&_writerTCB, _writerStack + 512, rwreadWriter, 0, HIGH);
+	OS_init(&fixedPriorityScheduler);
+	OS_addTask(&_writerTCB);
+	OS_start();
+	return hostExitStatus();
+}
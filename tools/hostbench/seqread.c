@@ -0,0 +1,136 @@
+/* Read throughput of a small snapshot shared through a sequence lock (seqlock.c), against the
+   same snapshot behind a mutex (mutex.c), with one writer and 1, 2, 4 or 8 readers.
+
+   The writer updates SEQREAD_WORDS words on every tick, and every SEQREAD_PREEMPT_EVERY-th
+	 update it yields half way through, as if it had been preempted, so readers do meet a write
+	 in progress.  Readers copy the snapshot over and over and call hostTick() every
+	 SEQREAD_READS_PER_TICK reads.  Reads per second of host time, SVCs per read and (for the
+	 sequence lock) retries per read are printed for each case; on the target an SVC costs far
+	 more than a host call, so SVCs per read are the figure to compare.  Every copy a reader
+	 ends up with must be consistent, with all of its words from the same update. */
+
+#include <stdio.h>
+#include "hostport.h"
+#include "FixedPriorityScheduler.h"
+#include "seqlock.h"
+#include "mutex.h"
+#include "sleep.h"
+
+#define SEQREAD_MAX_READERS 8
+#define SEQREAD_WORDS 8
+#define SEQREAD_TICKS 2000
+#define SEQREAD_READS_PER_TICK 100
+#define SEQREAD_PREEMPT_EVERY 8
+
+static OS_TCB_t _writerTCB, _readerTCBs[SEQREAD_MAX_READERS];
+static uint32_t _writerStack[512] __attribute__((aligned(8)));
+static uint32_t _readerStacks[SEQREAD_MAX_READERS][512] __attribute__((aligned(8)));
+
+static seqlock_t _seqlock;
+static OS_mutex_t _mutex;
+static uint32_t _shared[SEQREAD_WORDS];
+
+static uint32_t _useMutex;
+static uint32_t volatile _stop;
+static uint32_t volatile _running;
+static uint64_t _reads, _retries;
+
+/* Writes 'value' to every word, yielding half way through if 'preempt' */
+static void seqreadUpdate(uint32_t value, uint32_t preempt) {
+	for (uint32_t i = 0; i < SEQREAD_WORDS; i++) {
+		if (preempt && i == SEQREAD_WORDS / 2) {
+			OS_yield();
+		}
+		_shared[i] = value;
+	}
+}
+
+static void seqreadReader(void const * const arg) {
+	uint32_t copy[SEQREAD_WORDS];
+	uint64_t reads = 0, retries = 0;
+	(void) arg;
+	while (!_stop) {
+		if (_useMutex) {
+			mutexAquire(&_mutex);
+			for (uint32_t i = 0; i < SEQREAD_WORDS; i++) {
+				copy[i] = _shared[i];
+			}
+			mutexRelease(&_mutex);
+		} else {
+			uint32_t start;
+			while (1) {
+				start = seqlockReadBegin(&_seqlock);
+				for (uint32_t i = 0; i < SEQREAD_WORDS; i++) {
+					copy[i] = _shared[i];
+				}
+				if (!seqlockReadRetry(&_seqlock, start)) {
+					break;
+				}
+				retries++;
+			}
+		}
+		for (uint32_t i = 1; i < SEQREAD_WORDS; i++) {
+			if (copy[i] != copy[0]) {
+				hostFail("%s: read a torn snapshot (%u and %u)", _useMutex ? "mutex" : "seqlock", copy[0], copy[i]);
+				break;
+			}
+		}
+		if (++reads % SEQREAD_READS_PER_TICK == 0) {
+			hostTick();
+		}
+	}
+	_reads += reads;
+	_retries += retries;
+	_running--;
+}
+
+static void seqreadWriter(void const * const arg) {
+	(void) arg;
+	seqlockInit(&_seqlock);
+	mutexInit(&_mutex);
+	for (_useMutex = 0; _useMutex < 2; _useMutex++) {
+		for (uint32_t readers = 1; readers <= SEQREAD_MAX_READERS; readers *= 2) {
+			hostCounters_t before, after;
+			_stop = 0;
+			_reads = _retries = 0;
+			_running = readers;
+			for (uint32_t i = 0; i < readers; i++) {
+				OS_initialiseTCB(&_readerTCBs[i], _readerStacks[i] + 512, seqreadReader, 0, HIGH);
+				OS_addTask(&_readerTCBs[i]);
+			}
+			hostCounters(&before);
+			uint64_t const start = hostNs();
+			for (uint32_t update = 1; update <= SEQREAD_TICKS; update++) {
+				OS_sleep(1);
+				uint32_t const preempt = update % SEQREAD_PREEMPT_EVERY == 0;
+				if (_useMutex) {
+					mutexAquire(&_mutex);
+					seqreadUpdate(update, preempt);
+					mutexRelease(&_mutex);
+				} else {
+					seqlockWriteBegin(&_seqlock);
+					seqreadUpdate(update, preempt);
+					seqlockWriteEnd(&_seqlock);
+				}
+			}
+			_stop = 1;
+			while (_running) {
+				OS_yield();
+			}
+			uint64_t const ns = hostNs() - start;
+			hostCounters(&after);
+			printf("seqread %s, readers %u: %.2f M reads/s, %.3f SVCs and %.4f retries per read\n",
+				_useMutex ? "mutex" : "seqlock", readers, _reads / (ns / 1e3),
+				(double)(after.svcs - before.svcs) / _reads, (double) _retries / _reads);
+		}
+	}
+	hostStop();
+}
+
+int main(void) {
+	OS_initialiseTCB(&_writerTCB, _writerStack + 512, seqreadWriter, 0, HIGH);
+	OS_init(&fixedPriorityScheduler);
+	OS_addTask(&_writerTCB);
+	OS_start();
+	return hostExitStatus();
+}
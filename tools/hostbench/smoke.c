@@ -0,0 +1,150 @@
+/* Smoke test for the host kernel port.
+
+   Boots the kernel with the fixed-priority scheduler and checks that the basics behave as
+	 they do on the target: sleeping, a mutex handed between tasks, a queue, a timer callback,
+	 pooled task creation, the microsecond clock and OS_sleepUs().  Every other benchmark relies
+	 on these.  The clock must never go back and must agree with OS_elapsedTicks64() over
+	 SMOKE_CLOCK_TICKS ticks, and OS_sleepUs() must sleep at least as long as asked and at
+	 most a tick longer.  The wrap variant starts the tick count just below 0xFFFFFFFF, so all
+	 of this happens across the 32-bit wrap. */
+
+// variant: wrap -DOS_INITIAL_TICKS=0xFFFFFFF0u
+
+#include <stdio.h>
+#include "hostport.h"
+#include "FixedPriorityScheduler.h"
+#include "sleep.h"
+#include "mutex.h"
+#include "queue.h"
+#include "timer.h"
+
+#define SMOKE_MESSAGES 100
+#define SMOKE_CLOCK_TICKS 40
+
+static OS_TCB_t _producerTCB, _consumerTCB;
+static uint32_t _producerStack[128] __attribute__((aligned(8)));
+static uint32_t _consumerStack[128] __attribute__((aligned(8)));
+
+static OS_mutex_t _mutex;
+static queue_t _queue;
+static uint32_t _queueStorage[4];
+static OS_timer_t _timer;
+static uint32_t volatile _timerTick = 0;
+static uint32_t volatile _workerRan = 0;
+static uint32_t _shared = 0;
+
+static void smokeTimer(void * arg) {
+	(void) arg;
+	_timerTick = OS_elapsedTicks();
+}
+
+static void smokeWorker(void const * const arg) {
+	_workerRan = (uint32_t)(uintptr_t) arg;
+}
+
+static void smokeProducer(void const * const arg) {
+	(void) arg;
+	for (uint32_t i = 0; i < SMOKE_MESSAGES; i++) {
+		mutexAquire(&_mutex);
+		_shared++;
+		mutexRelease(&_mutex);
+		queueSend(&_queue, &i);
+	}
+}
+
+static void smokeConsumer(void const * const arg) {
+	(void) arg;
+	uint32_t const start = OS_elapsedTicks();
+	uint64_t const startUs = OS_nowUs();
+	OS_sleep(5);
+	uint32_t const slept = OS_elapsedTicks() - start;
+	if (slept < 5 || slept > 6) {
+		hostFail("OS_sleep(5) took %u ticks", slept);
+	}
+	if (OS_nowUs() - startUs < 5000) {
+		hostFail("OS_nowUs() moved %llu us over 5 ticks", (unsigned long long)(OS_nowUs() - startUs));
+	}
+
+	for (uint32_t i = 0; i < SMOKE_MESSAGES; i++) {
+		uint32_t value;
+		queueReceive(&_queue, &value);
+		if (value != i) {
+			hostFail("queue delivered %u where %u was sent", value, i);
+			break;
+		}
+	}
+	if (_shared != SMOKE_MESSAGES) {
+		hostFail("mutex-protected counter is %u, not %u", _shared, SMOKE_MESSAGES);
+	}
+
+	OS_timerInit(&_timer, smokeTimer, 0);
+	uint32_t const timerStart = OS_elapsedTicks();
+	OS_timerStart(&_timer, 10, 0);
+	OS_sleep(20);
+	if (_timerTick != timerStart + 10) {
+		hostFail("timer started at tick %u for 10 ticks ran at %u", timerStart, _timerTick);
+	}
+
+	if (!OS_createTask(smokeWorker, (void const *) 42, 0, HIGH)) {
+		hostFail("OS_createTask() failed");
+	}
+	OS_yield();
+	if (_workerRan != 42) {
+		hostFail("pooled task didn't run");
+	}
+
+	// Ticks only come from the idle task or hostTick(), so nothing ticks between two reads here
+	uint64_t lastUs = OS_nowUs();
+	for (uint32_t i = 0; i < SMOKE_CLOCK_TICKS; i++) {
+		for (uint32_t j = 0; j < 10; j++) {
+			uint64_t const us = OS_nowUs();
+			uint64_t const ticks = OS_elapsedTicks64();
+			if (us < lastUs || us / OS_TICK_US != ticks) {
+				hostFail("OS_nowUs() read %llu us after %llu us, at tick %llu", (unsigned long long) us,
+					(unsigned long long) lastUs, (unsigned long long) ticks);
+				break;
+			}
+			lastUs = us;
+		}
+		hostTick();
+	}
+
+	static uint32_t const sleeps[] = { 300, 2500 };
+	for (uint32_t i = 0; i < sizeof(sleeps) / sizeof(sleeps[0]); i++) {
+		// Start from the beginning of a tick, as the host port's clock stops at the end of one
+		OS_sleep(1);
+		uint64_t const before = OS_nowUs();
+		OS_sleepUs(sleeps[i]);
+		uint64_t const slept = OS_nowUs() - before;
+		if (slept < sleeps[i] || slept > sleeps[i] + OS_TICK_US) {
+			hostFail("OS_sleepUs(%u) took %llu us", sleeps[i], (unsigned long long) slept);
+		}
+	}
+
+	if (OS_INITIAL_TICKS && !(OS_elapsedTicks64() >> 32)) {
+		hostFail("the tick count started at %u and never wrapped", OS_INITIAL_TICKS);
+	}
+
+	hostCounters_t counters;
+	hostCounters(&counters);
+	printf("smoke: %llu SVCs, %llu PendSVs, %llu switches, %llu ticks\n",
+		(unsigned long long) counters.svcs, (unsigned long long) counters.pendSVs,
+		(unsigned long long) counters.switches, (unsigned long long) counters.ticks);
+	hostStop();
+}
+
+int main(void) {
+	mutexInit(&_mutex);
+	queueInit(&_queue, _queueStorage, 4, sizeof(uint32_t));
+	OS_initialiseTCB(&_producerTCB, _producerStack + 128, smokeProducer, 0, MEDIUM);
+	OS_initialiseTCB(&_consumerTCB, _consumerStack + 128, smokeConsumer, 0, HIGH);
+	OS_init(&fixedPriorityScheduler);
+	OS_addTask(&_producerTCB);
+	OS_addTask(&_consumerTCB);
+	if (!OS_timerServiceStart(HIGH)) {
+		hostFail("timer service didn't start");
+	}
+	OS_start();
+	printf("smoke: %s\n", hostExitStatus() ? "FAILED" : "passed");
+	return hostExitStatus();
+}
@@ -0,0 +1,152 @@
+#ifndef __STM32F3xx_H
+#define __STM32F3xx_H
+
+/* Host stand-in for the device header, used by the host kernel port (see hostport.c).
+
+   The kernel sources are built with -Itools/hostbench -include stm32f3xx.h, so this file is
+	 seen before anything else.  The core registers the kernel touches are plain structures
+	 that hostport.c keeps up to date, the ARM compiler keywords are mapped onto GCC, and the
+	 intrinsics that depend on the processor's state (the exclusive monitor, IPSR, BASEPRI,
+	 CONTROL and WFI) call into the port.  IPSR, BASEPRI and CONTROL are per host thread, so
+	 threads that stand in for interrupt handlers (see hostInterruptThread()) can be told apart
+	 from the kernel. */
+
+#include <stdint.h>
+#include <stdlib.h>
+
+/* ARM compiler keywords */
+#define __svc(x)
+#define __align(x) __attribute__((aligned(x)))
+#define __value_in_regs
+#define __inline inline
+#define __breakpoint(x) abort()
+
+/* Exclusive monitor, emulated with compare-and-swap: a store-exclusive succeeds if the word
+   still holds the value that the load-exclusive read */
+uint32_t hostLdrex(uint32_t volatile * address);
+uint32_t hostStrex(uint32_t value, uint32_t volatile * address);
+void hostClrex(void);
+#define __LDREXW(p) hostLdrex((uint32_t volatile *)(p))
+#define __STREXW(v, p) hostStrex((v), (uint32_t volatile *)(p))
+#define __CLREX() hostClrex()
+
+/* Barriers and hints */
+#define __DMB() __atomic_thread_fence(__ATOMIC_SEQ_CST)
+#define __DSB() __atomic_thread_fence(__ATOMIC_SEQ_CST)
+#define __ISB() __atomic_thread_fence(__ATOMIC_SEQ_CST)
+#define __NOP() do {} while (0)
+void hostWFI(void);
+#define __WFI() hostWFI()
+
+static inline uint32_t __CLZ(uint32_t value) {
+	return value ? (uint32_t)__builtin_clz(value) : 32;
+}
+
+/* Special registers */
+extern __thread uint32_t hostIPSR;
+extern __thread uint32_t hostBASEPRI;
+extern __thread uint32_t hostCONTROL;
+#define __get_IPSR() hostIPSR
+#define __get_CONTROL() hostCONTROL
+#define __get_BASEPRI() hostBASEPRI
+#define __set_BASEPRI(x) (hostBASEPRI = (x))
+#define __set_BASEPRI_MAX(x) do { uint32_t const _basepri = (x); \
+		if (_basepri && (!hostBASEPRI || _basepri < hostBASEPRI)) hostBASEPRI = _basepri; } while (0)
+
+/* Interrupt numbers.  The device interrupts are the ones the sources name. */
+typedef enum {
+	NonMaskableInt_IRQn = -14,
+	HardFault_IRQn = -13,
+	MemoryManagement_IRQn = -12,
+	BusFault_IRQn = -11,
+	UsageFault_IRQn = -10,
+	SVCall_IRQn = -5,
+	DebugMonitor_IRQn = -4,
+	PendSV_IRQn = -2,
+	SysTick_IRQn = -1,
+	DMA1_Channel6_IRQn = 16,
+	TIM2_IRQn = 28,
+	USART2_IRQn = 38
+} IRQn_Type;
+
+#define __NVIC_PRIO_BITS 4
+
+void NVIC_SetPriority(IRQn_Type irq, uint32_t priority);
+uint32_t NVIC_GetPriority(IRQn_Type irq);
+void NVIC_EnableIRQ(IRQn_Type irq);
+void NVIC_DisableIRQ(IRQn_Type irq);
+void NVIC_ClearPendingIRQ(IRQn_Type irq);
+
+/* System control block */
+typedef struct {
+	volatile uint32_t ICSR;
+	volatile uint32_t CCR;
+	volatile uint32_t SCR;
+	volatile uint32_t SHCSR;
+	volatile uint8_t SHP[12];
+} SCB_Type;
+
+extern SCB_Type hostSCB;
+#define SCB (&hostSCB)
+
+#define SCB_ICSR_PENDSVSET_Msk (1UL << 28)
+#define SCB_ICSR_PENDSTSET_Msk (1UL << 26)
+#define SCB_ICSR_VECTACTIVE_Msk 0x1FFUL
+#define SCB_CCR_STKALIGN_Msk (1UL << 9)
+#define SCB_SCR_SLEEPDEEP_Msk (1UL << 2)
+
+/* SysTick.  Its counter is worked out from the host clock whenever it is read. */
+typedef struct {
+	volatile uint32_t CTRL;
+	volatile uint32_t LOAD;
+	volatile uint32_t VAL;
+	volatile uint32_t CALIB;
+} SysTick_Type;
+
+SysTick_Type * hostSysTick(void);
+#define SysTick (hostSysTick())
+
+#define SysTick_CTRL_COUNTFLAG_Msk (1UL << 16)
+#define SysTick_LOAD_RELOAD_Msk 0xFFFFFFUL
+
+uint32_t SysTick_Config(uint32_t ticks);
+
+/* Reset and clock control: only what lockstatInit() reads and writes.  It reads as reset,
+   so the timers run at the core clock. */
+typedef struct {
+	volatile uint32_t CFGR;
+	volatile uint32_t APB1ENR;
+} RCC_TypeDef;
+
+extern RCC_TypeDef hostRCC;
+#define RCC (&hostRCC)
+
+#define RCC_CFGR_HPRE_Pos 4
+#define RCC_CFGR_HPRE_Msk (0xFUL << RCC_CFGR_HPRE_Pos)
+#define RCC_CFGR_PPRE1_Pos 8
+#define RCC_CFGR_PPRE1_Msk (0x7UL << RCC_CFGR_PPRE1_Pos)
+#define RCC_APB1ENR_TIM2EN (1UL << 0)
+
+/* General-purpose timer, for lockstat's clock (LOCKSTAT_TIMER).  Like SysTick, its counter is
+   worked out from the host clock whenever it is read. */
+typedef struct {
+	volatile uint32_t CR1;
+	volatile uint32_t DIER;
+	volatile uint32_t SR;
+	volatile uint32_t EGR;
+	volatile uint32_t CNT;
+	volatile uint32_t PSC;
+	volatile uint32_t ARR;
+} TIM_TypeDef;
+
+TIM_TypeDef * hostTim2(void);
+#define TIM2 (hostTim2())
+
+#define TIM_CR1_CEN (1UL << 0)
+#define TIM_EGR_UG (1UL << 0)
+
+/* The host core runs at one cycle per nanosecond */
+extern uint32_t SystemCoreClock;
+void SystemCoreClockUpdate(void);
+
+#endif /* __STM32F3xx_H */
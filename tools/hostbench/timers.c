@@ -0,0 +1,100 @@
+/* Cost of a tick with TIMERS_ACTIVE software timers running (timer.c).
+
+   A task starts TIMERS_ACTIVE periodic timers with periods spread from 1 tick to well beyond
+	 the span of the timing wheel, then drives TIMERS_TICKS ticks with hostTick() and times each
+	 one, which covers SysTick_Handler (including the wheel) and the PendSV that follows it.
+	 Ticks on which PendSV switched to the timer service task are left out, since they include
+	 its callbacks.  The same number of ticks with no timers running is timed first, as the
+	 baseline.  The timer service task counts the callbacks, and every timer must have expired
+	 exactly as often as its period says.  The wrap variant starts the tick count so that the
+	 32-bit wrap falls half way through the run with the timers. */
+
+// variant: wrap -DOS_INITIAL_TICKS=0xFFFDB610u
+
+#include <stdio.h>
+#include <stdlib.h>
+#include "hostport.h"
+#include "FixedPriorityScheduler.h"
+#include "timer.h"
+
+#define TIMERS_ACTIVE 1000
+#define TIMERS_TICKS 100000
+#define TIMERS_MAX_PERIOD 2000
+/* Every this many timers has a period beyond the wheel, so it waits on the overflow list */
+#define TIMERS_OVERFLOW_EVERY 20
+
+static OS_TCB_t _benchTCB;
+static uint32_t _benchStack[512] __attribute__((aligned(8)));
+static OS_timer_t _timers[TIMERS_ACTIVE];
+static uint32_t _periods[TIMERS_ACTIVE];
+static uint32_t _expiries[TIMERS_ACTIVE];
+static uint64_t _samples[TIMERS_TICKS];
+
+static void timersCallback(void * arg) {
+	_expiries[(OS_timer_t *) arg - _timers]++;
+}
+
+/* Times TIMERS_TICKS ticks and prints a summary of the ones that didn't switch tasks */
+static void timersRun(char const * name) {
+	hostSummary_t summary;
+	hostCounters_t before, after;
+	uint32_t count = 0;
+	for (uint32_t i = 0; i < TIMERS_TICKS; i++) {
+		hostCounters(&before);
+		uint64_t const start = hostNs();
+		hostTick();
+		uint64_t const ns = hostNs() - start;
+		hostCounters(&after);
+		if (after.switches == before.switches) {
+			_samples[count++] = ns;
+		}
+	}
+	hostSummarise(_samples, count, &summary);
+	hostPrintSummary(name, &summary, "ns/tick");
+}
+
+static void timersBench(void const * const arg) {
+	(void) arg;
+	srand(1);
+	timersRun("timers 0");
+
+	uint32_t const start = OS_elapsedTicks();
+	for (uint32_t i = 0; i < TIMERS_ACTIVE; i++) {
+		_periods[i] = (i % TIMERS_OVERFLOW_EVERY == 0)
+			? (1UL << (TIMER_WHEEL_BITS * TIMER_WHEEL_LEVELS)) + (uint32_t) rand() % 100000
+			: 1 + (uint32_t) rand() % TIMERS_MAX_PERIOD;
+		OS_timerInit(&_timers[i], timersCallback, &_timers[i]);
+		OS_timerStart(&_timers[i], _periods[i], _periods[i]);
+	}
+	char name[32];
+	snprintf(name, sizeof(name), "timers %u", TIMERS_ACTIVE);
+	timersRun(name);
+	// Time stands still until this task sleeps or ticks, so the service task catches up
+	OS_yield();
+
+	uint32_t const elapsed = OS_elapsedTicks() - start;
+	uint64_t callbacks = 0;
+	for (uint32_t i = 0; i < TIMERS_ACTIVE; i++) {
+		callbacks += _expiries[i];
+		if (_expiries[i] != elapsed / _periods[i]) {
+			hostFail("timer %u with period %u expired %u times in %u ticks", i, _periods[i], _expiries[i], elapsed);
+		}
+		OS_timerStop(&_timers[i]);
+	}
+	printf("timers: %llu callbacks over %u ticks\n", (unsigned long long) callbacks, elapsed);
+	if (OS_INITIAL_TICKS && OS_elapsedTicks() > start) {
+		hostFail("the tick count didn't wrap between ticks %u and %u", start, OS_elapsedTicks());
+	}
+	hostStop();
+}
+
+int main(void) {
+	OS_initialiseTCB(&_benchTCB, _benchStack + 512, timersBench, 0, MEDIUM);
+	OS_init(&fixedPriorityScheduler);
+	OS_addTask(&_benchTCB);
+	if (!OS_timerServiceStart(HIGH)) {
+		hostFail("timer service didn't start");
+	}
+	OS_start();
+	return hostExitStatus();
+}
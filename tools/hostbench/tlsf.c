@@ -0,0 +1,183 @@
+/* Long randomized run of the TLSF heap (heap.c): latency of every operation, and how
+   fragmented the arena gets.
+
+   A task makes TLSF_OPS random operations on TLSF_SLOTS slots: an empty slot is allocated
+	 with a random size (mostly small, sometimes large), a full one is freed or, now and then,
+	 resized with heapRealloc().  Every operation is timed in host nanoseconds, including the
+	 SVC and the clock read (the cost of an empty timed region is printed as well), and the
+	 distribution for each kind is printed at the end: the max is the worst case over the whole
+	 run, though on the host it also catches the odd page fault or descheduling, so the number
+	 of operations that took over TLSF_SLOW_NS is printed too.  Every TLSF_STATS_EVERY operations the heap statistics are sampled for fragmentation,
+	 1 - largestFree / free, and a line is printed for each TLSF_REPORT_EVERY operations so
+	 any drift over the run shows.  Blocks are filled with a pattern that must survive until
+	 they are freed, and an allocation may only fail if no free block is twice its size. */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "hostport.h"
+#include "FixedPriorityScheduler.h"
+#include "heap.h"
+
+#define TLSF_OPS 5000000
+#define TLSF_SLOTS 64
+#define TLSF_STATS_EVERY 1000
+#define TLSF_REPORT_EVERY 1000000
+#define TLSF_SLOW_NS 1000
+
+static OS_TCB_t _benchTCB;
+static uint32_t _benchStack[512] __attribute__((aligned(8)));
+
+typedef struct {
+	uint8_t * block;
+	uint32_t size;
+} tlsfSlot_t;
+
+static tlsfSlot_t _slots[TLSF_SLOTS];
+static uint64_t * _samples[3];
+static uint32_t _counts[3];
+static uint32_t _slow;
+
+enum { TLSF_ALLOC, TLSF_FREE, TLSF_REALLOC };
+
+/* Mostly small requests, some medium and a few large */
+static uint32_t tlsfSize(void) {
+	uint32_t const pick = (uint32_t) rand() % 100;
+	if (pick < 70) {
+		return 1 + (uint32_t) rand() % 64;
+	}
+	if (pick < 95) {
+		return 64 + (uint32_t) rand() % 448;
+	}
+	return 512 + (uint32_t) rand() % 1536;
+}
+
+static void tlsfFill(tlsfSlot_t const * slot, uint32_t index) {
+	memset(slot->block, (uint8_t)(index * 37 + slot->size), slot->size);
+}
+
+static void tlsfCheck(tlsfSlot_t const * slot, uint32_t index, uint32_t size) {
+	uint8_t const expected = (uint8_t)(index * 37 + slot->size);
+	for (uint32_t i = 0; i < size; i++) {
+		if (slot->block[i] != expected) {
+			hostFail("slot %u: byte %u of %u was overwritten", index, i, size);
+			return;
+		}
+	}
+}
+
+static void tlsfRecord(uint32_t kind, uint64_t ns) {
+	_samples[kind][_counts[kind]++] = ns;
+	_slow += ns > TLSF_SLOW_NS;
+}
+
+static void tlsfBench(void const * const arg) {
+	(void) arg;
+	heapStats_t stats;
+	hostSummary_t summary;
+	double fragmentation = 0, worstFragmentation = 0, periodFragmentation = 0;
+	uint32_t samples = 0, periodSamples = 0, mostFreeBlocks = 0, failures = 0;
+	srand(1);
+
+	// Cost of the timing itself
+	for (uint32_t i = 0; i < 100000; i++) {
+		uint64_t const start = hostNs();
+		tlsfRecord(TLSF_ALLOC, hostNs() - start);
+	}
+	hostSummarise(_samples[TLSF_ALLOC], _counts[TLSF_ALLOC], &summary);
+	hostPrintSummary("tlsf empty", &summary, "ns");
+	_counts[TLSF_ALLOC] = 0;
+	_slow = 0;
+
+	for (uint32_t op = 1; op <= TLSF_OPS; op++) {
+		uint32_t const index = (uint32_t) rand() % TLSF_SLOTS;
+		tlsfSlot_t * const slot = &_slots[index];
+		if (!slot->block) {
+			uint32_t const size = tlsfSize();
+			uint64_t const start = hostNs();
+			slot->block = heapAlloc(size);
+			tlsfRecord(TLSF_ALLOC, hostNs() - start);
+			if (!slot->block) {
+				failures++;
+				heapStats(&stats);
+				if (stats.largestFree >= 2 * size) {
+					hostFail("op %u: %u bytes refused with a %u-byte block free", op, size, stats.largestFree);
+				}
+			} else {
+				slot->size = size;
+				tlsfFill(slot, index);
+			}
+		} else if (rand() % 8) {
+			tlsfCheck(slot, index, slot->size);
+			uint64_t const start = hostNs();
+			heapFree(slot->block);
+			tlsfRecord(TLSF_FREE, hostNs() - start);
+			slot->block = 0;
+		} else {
+			uint32_t const size = tlsfSize();
+			uint64_t const start = hostNs();
+			uint8_t * const block = heapRealloc(slot->block, size);
+			tlsfRecord(TLSF_REALLOC, hostNs() - start);
+			// The contents must have come along, as far as they fit.  Failing means a move was needed.
+			failures += !block;
+			if (block) {
+				slot->block = block;
+				tlsfCheck(slot, index, size < slot->size ? size : slot->size);
+				slot->size = size;
+				tlsfFill(slot, index);
+			}
+		}
+
+		if (op % TLSF_STATS_EVERY == 0) {
+			heapStats(&stats);
+			double const sample = stats.free ? 1.0 - (double) stats.largestFree / stats.free : 0;
+			fragmentation += sample;
+			periodFragmentation += sample;
+			samples++;
+			periodSamples++;
+			if (sample > worstFragmentation) {
+				worstFragmentation = sample;
+			}
+			if (stats.freeBlocks > mostFreeBlocks) {
+				mostFreeBlocks = stats.freeBlocks;
+			}
+		}
+		if (op % TLSF_REPORT_EVERY == 0) {
+			printf("tlsf %u ops: used %u, free %u in %u blocks, largest %u, fragmentation %.1f%% (mean since last)\n",
+				op, stats.used, stats.free, stats.freeBlocks, stats.largestFree, 100.0 * periodFragmentation / periodSamples);
+			periodFragmentation = 0;
+			periodSamples = 0;
+		}
+	}
+
+	hostSummarise(_samples[TLSF_ALLOC], _counts[TLSF_ALLOC], &summary);
+	hostPrintSummary("tlsf heapAlloc", &summary, "ns");
+	hostSummarise(_samples[TLSF_FREE], _counts[TLSF_FREE], &summary);
+	hostPrintSummary("tlsf heapFree", &summary, "ns");
+	hostSummarise(_samples[TLSF_REALLOC], _counts[TLSF_REALLOC], &summary);
+	hostPrintSummary("tlsf heapRealloc", &summary, "ns");
+	printf("tlsf: %u of %u operations took over %u ns\n", _slow, TLSF_OPS, TLSF_SLOW_NS);
+	heapStats(&stats);
+	printf("tlsf: fragmentation mean %.1f%%, worst %.1f%%, at most %u free blocks, high water %u of %u bytes, %u failed allocations\n",
+		100.0 * fragmentation / samples, 100.0 * worstFragmentation, mostFreeBlocks, stats.highWater, stats.arenaSize, failures);
+	if (stats.failures != failures) {
+		hostFail("the heap counted %u failures, not %u", stats.failures, failures);
+	}
+	hostStop();
+}
+
+int main(void) {
+	// Host memory: the samples are never handed to the kernel
+	for (uint32_t kind = 0; kind < 3; kind++) {
+		_samples[kind] = malloc(TLSF_OPS * sizeof(uint64_t));
+		if (!_samples[kind]) {
+			perror("malloc");
+			return 1;
+		}
+	}
+	OS_initialiseTCB(&_benchTCB, _benchStack + 512, tlsfBench, 0, HIGH);
+	OS_init(&fixedPriorityScheduler);
+	OS_addTask(&_benchTCB);
+	OS_start();
+	return hostExitStatus();
+}
@@ -0,0 +1,187 @@
+/* Worst-case latency of an interrupt more urgent than OS_MAX_SYSCALL_PRIORITY, with the
+   kernel stopped and under heavy kernel activity, on QEMU.
+
+   Build and run it with tools/qemu/run.sh, which links it with the kernel sources in place
+	 of main.c and without utils/ (retarget.c turns semihosting off, and QEMU has no RCC for
+	 config_init() to wait on), and runs it on QEMU's netduinoplus2, an STM32F405 whose memory
+	 map, TIM3, TIM4 and NVIC match the STM32F303 as far as this program goes.
+
+   TIM4 interrupts every ISRLAT_URGENT_PERIOD counts at ISRLAT_URGENT_PRIORITY, and its
+	 handler reads the counter, which is the time since the update event that raised the
+	 interrupt.  TIM3 does the same every ISRLAT_KERNEL_PERIOD counts at
+	 OS_MAX_SYSCALL_PRIORITY, where the kernel's critical sections do mask it, and releases a
+	 semaphore from its handler.  TIM2 is left alone, as it is lockstat's clock
+	 (LOCKSTAT_TIMER).  ISRLAT_SAMPLES TIM4 interrupts are first taken with main() spinning
+	 before OS_start(), then as many again with tasks ping-ponging through a queue, contending
+	 for a mutex, allocating from the heap and waiting for TIM3.  The worst latency of each
+	 interrupt is printed for both phases.
+
+	 -icount makes QEMU's clock count instructions, so runs are repeatable.  QEMU only takes
+	 an interrupt at the end of a translation block, which adds a few instructions' jitter
+	 whatever the kernel does, and ISRLAT_MARGIN allows for that; a kernel critical section
+	 that masked TIM4 would add the whole section.  The program prints PASS or FAIL and exits
+	 through semihosting with a non-zero status if TIM4's worst latency under load is more
+	 than ISRLAT_MARGIN counts above its worst with the kernel stopped. */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include "os.h"
+#include "critical.h"
+#include "FixedPriorityScheduler.h"
+#include "sleep.h"
+#include "mutex.h"
+#include "queue.h"
+#include "semaphore.h"
+#include "heap.h"
+
+#define ISRLAT_SAMPLES 20000
+#define ISRLAT_URGENT_PRIORITY 1
+#define ISRLAT_URGENT_PERIOD 997
+#define ISRLAT_KERNEL_PERIOD 1499
+#define ISRLAT_MARGIN 16
+
+#if ISRLAT_URGENT_PRIORITY >= OS_MAX_SYSCALL_PRIORITY
+#error "ISRLAT_URGENT_PRIORITY must be more urgent than OS_MAX_SYSCALL_PRIORITY"
+#endif
+
+/* Latencies seen by one timer's handler since the counts were last reset */
+typedef struct {
+	uint32_t volatile count;
+	uint32_t volatile worst;
+} isrlatStats_t;
+
+static isrlatStats_t _urgent, _kernel;
+
+static OS_mutex_t _mutex;
+static queue_t _ping, _pong;
+static uint32_t _pingStorage[1], _pongStorage[1];
+static semaphore_t _tim3;
+static uint32_t volatile _shared;
+
+static void isrlatRecord(isrlatStats_t * stats, uint32_t latency) {
+	if (latency > stats->worst) {
+		stats->worst = latency;
+	}
+	stats->count = stats->count + 1;
+}
+
+/* More urgent than OS_MAX_SYSCALL_PRIORITY, so it must not call the kernel at all */
+void TIM4_IRQHandler(void) {
+	uint32_t const latency = TIM4->CNT;
+	TIM4->SR = ~TIM_SR_UIF;
+	isrlatRecord(&_urgent, latency);
+}
+
+void TIM3_IRQHandler(void) {
+	uint32_t const latency = TIM3->CNT;
+	TIM3->SR = ~TIM_SR_UIF;
+	isrlatRecord(&_kernel, latency);
+	semaphoreReleaseFromISR(&_tim3, 1);
+}
+
+static void isrlatTimerStart(TIM_TypeDef * timer, IRQn_Type irq, uint32_t period, uint32_t priority) {
+	timer->CR1 = 0;
+	timer->PSC = 0;
+	timer->ARR = period - 1;
+	timer->CNT = 0;
+	timer->SR = 0;
+	timer->DIER = TIM_DIER_UIE;
+	NVIC_SetPriority(irq, priority);
+	NVIC_EnableIRQ(irq);
+	timer->CR1 = TIM_CR1_CEN;
+}
+
+static void isrlatPing(void const * const arg) {
+	(void) arg;
+	for (uint32_t value = 0; ; value++) {
+		queueSend(&_ping, &value);
+		queueReceive(&_pong, &value);
+	}
+}
+
+static void isrlatPong(void const * const arg) {
+	(void) arg;
+	while (1) {
+		uint32_t value;
+		queueReceive(&_ping, &value);
+		value++;
+		queueSend(&_pong, &value);
+	}
+}
+
+static void isrlatLocker(void const * const arg) {
+	(void) arg;
+	while (1) {
+		mutexAquire(&_mutex);
+		_shared = _shared + 1;
+		OS_yield();
+		mutexRelease(&_mutex);
+	}
+}
+
+static void isrlatAllocator(void const * const arg) {
+	void * blocks[8] = { 0 };
+	(void) arg;
+	for (uint32_t i = 0; ; i++) {
+		void ** const slot = &blocks[(i * 5) % 8];
+		if (*slot) {
+			heapFree(*slot);
+		}
+		*slot = heapAlloc(16 + (i * 37) % 400);
+	}
+}
+
+static void isrlatWaiter(void const * const arg) {
+	(void) arg;
+	while (1) {
+		semaphoreAquire(&_tim3, 1);
+	}
+}
+
+static void isrlatReporter(void const * const arg) {
+	uint32_t const idleWorst = *(uint32_t const *) arg;
+	while (_urgent.count < ISRLAT_SAMPLES) {
+		OS_sleep(10);
+	}
+	uint32_t const loadedWorst = _urgent.worst;
+	printf("isrlatency: priority %u interrupt, kernel stopped: worst %u counts\n", ISRLAT_URGENT_PRIORITY, idleWorst);
+	printf("isrlatency: priority %u interrupt, kernel loaded: worst %u counts\n", ISRLAT_URGENT_PRIORITY, loadedWorst);
+	printf("isrlatency: priority %u interrupt, kernel loaded: worst %u counts over %u interrupts\n",
+		OS_MAX_SYSCALL_PRIORITY, _kernel.worst, _kernel.count);
+	if (loadedWorst > idleWorst + ISRLAT_MARGIN) {
+		printf("isrlatency: FAIL\n");
+		exit(1);
+	}
+	printf("isrlatency: PASS\n");
+	exit(0);
+}
+
+int main(void) {
+	static uint32_t idleWorst;
+	mutexInit(&_mutex);
+	queueInit(&_ping, _pingStorage, 1, sizeof(uint32_t));
+	queueInit(&_pong, _pongStorage, 1, sizeof(uint32_t));
+	semaphoreInit(&_tim3, 0);
+	OS_init(&fixedPriorityScheduler);
+
+	// With the kernel stopped
+	RCC->APB1ENR |= RCC_APB1ENR_TIM3EN | RCC_APB1ENR_TIM4EN;
+	isrlatTimerStart(TIM4, TIM4_IRQn, ISRLAT_URGENT_PERIOD, ISRLAT_URGENT_PRIORITY);
+	while (_urgent.count < ISRLAT_SAMPLES) {
+	}
+	// TIM4 carries on; creating the tasks below is kernel activity too
+	idleWorst = _urgent.worst;
+	_urgent.count = _urgent.worst = 0;
+
+	// Under load
+	OS_createTask(isrlatPing, 0, 0, HIGH);
+	OS_createTask(isrlatPong, 0, 0, HIGH);
+	OS_createTask(isrlatLocker, 0, 0, HIGH);
+	OS_createTask(isrlatLocker, 0, 0, HIGH);
+	OS_createTask(isrlatAllocator, 0, 0, HIGH);
+	OS_createTask(isrlatWaiter, 0, 0, HIGH);
+	OS_createTask(isrlatReporter, &idleWorst, 0, HIGH);
+	isrlatTimerStart(TIM3, TIM3_IRQn, ISRLAT_KERNEL_PERIOD, OS_MAX_SYSCALL_PRIORITY);
+	OS_start();
+	return 0;
+}
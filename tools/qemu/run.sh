@@ -0,0 +1,69 @@
+#!/bin/sh
+# Builds the kernel with each program in tools/qemu in place of main.c, and runs them on QEMU.
+#
+#   tools/qemu/run.sh              build and run every program
+#   tools/qemu/run.sh isrlatency   only this one
+#
+# The kernel's SVC stubs (__svc, __value_in_regs) and os_asm.s need the ARM Compiler 5 tools
+# that the Keil project uses, so armcc, armasm and armlink must be on the PATH (or in $ARMCC),
+# and the device header and system file come from the packs:
+#
+#   DFP     Keil.STM32F3xx_DFP pack directory
+#   CMSIS   ARM.CMSIS pack directory
+#
+# QEMU's netduinoplus2 stands in for the STM32F303 (see startup.s and qemu.sct), with
+# -icount so the runs are repeatable.  Binaries go to $OUT (default /tmp/qemutests).  A
+# program passes if it prints a line ending in PASS before $TIMEOUT seconds (default 600):
+# semihosting's exit on 32-bit ARM can't carry a status, so QEMU's own status isn't used.  The
+# exit status is non-zero if anything fails to build, or any program doesn't pass.
+
+set -e
+
+root=$(cd "$(dirname "$0")/../.." && pwd)
+out=${OUT:-/tmp/qemutests}
+bin=${ARMCC:+$ARMCC/}
+qemu=${QEMU:-qemu-system-arm}
+timeout=${TIMEOUT:-600}
+: "${DFP:?set DFP to the Keil.STM32F3xx_DFP pack directory}"
+: "${CMSIS:?set CMSIS to the ARM.CMSIS pack directory}"
+mkdir -p "$out"
+
+# No FPU: PendSV doesn't save the floating-point registers
+cflags="--c99 --gnu --cpu=Cortex-M4 -O2 -g --apcs=interwork -DSTM32F303xE \
+	-I$root -I$root/OS -I$DFP/Drivers/CMSIS/Device/ST/STM32F3xx/Include -I$CMSIS/CMSIS/Core/Include"
+aflags="--cpu=Cortex-M4 -g --apcs=interwork"
+
+# As tools/hostbench/run.sh, less the port, plus the context switch and the clock setup
+kernel="OS/os.c OS/timer.c OS/idle.c OS/latency.c OS/tasknotify.c \
+	isr.c batch.c mutex.c cond.c semaphore.c lockstat.c queue.c queueset.c pqueue.c sleep.c memory.c heap.c \
+	seqlock.c rwlock.c streambuffer.c coroutine.c \
+	FixedPriorityScheduler.c simpleRoundRobin.c OS/waittable.c"
+
+if [ $# -eq 0 ]; then
+	set -- $(cd "$root/tools/qemu" && ls *.c | sed 's/\.c$//')
+fi
+
+status=0
+for test in "$@"; do
+	echo "== $test"
+	objects="$out/$test.obj"
+	rm -rf "$objects"
+	mkdir -p "$objects"
+	for source in $kernel tools/qemu/$test.c; do
+		"${bin}armcc" $cflags -c -o "$objects/$(basename "$source" .c).o" "$root/$source"
+	done
+	"${bin}armcc" $cflags -c -o "$objects/system_stm32f3xx.o" \
+		"$DFP/Drivers/CMSIS/Device/ST/STM32F3xx/Source/Templates/system_stm32f3xx.c"
+	"${bin}armasm" $aflags -o "$objects/os_asm.o" "$root/OS/os_asm.s"
+	"${bin}armasm" $aflags -o "$objects/startup.o" "$root/tools/qemu/startup.s"
+	"${bin}armlink" --cpu=Cortex-M4 --strict --scatter "$root/tools/qemu/qemu.sct" \
+		--entry=Reset_Handler --keep="startup.o(RESET)" -o "$out/$test.axf" "$objects"/*.o
+	timeout "$timeout" "$qemu" -M netduinoplus2 -nographic -icount shift=0 \
+		-semihosting-config enable=on,target=native -kernel "$out/$test.axf" > "$out/$test.log" || true
+	cat "$out/$test.log"
+	if ! grep -q 'PASS$' "$out/$test.log"; then
+		echo "== $test FAILED"
+		status=1
+	fi
+done
+exit $status
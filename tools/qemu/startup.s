@@ -0,0 +1,89 @@
+; Vector table and reset handler for the programs in tools/qemu, in place of the device pack's
+; startup file, which calls SystemInit() and gives the C library too little heap for stdio.
+; Only the vectors the kernel and the QEMU tests use have handlers; anything else stops at
+; Default_Handler, where run.sh's timeout catches it.
+
+Stack_Size  EQU     0x00001000
+Heap_Size   EQU     0x00001000
+
+    AREA STACK, NOINIT, READWRITE, ALIGN=3
+Stack_Mem
+    SPACE   Stack_Size
+__initial_sp
+
+    AREA HEAP, NOINIT, READWRITE, ALIGN=3
+__heap_base
+Heap_Mem
+    SPACE   Heap_Size
+__heap_limit
+
+    PRESERVE8
+    THUMB
+
+    AREA RESET, DATA, READONLY
+    EXPORT __Vectors
+
+__Vectors
+    DCD     __initial_sp
+    DCD     Reset_Handler
+    DCD     Default_Handler     ; NMI
+    DCD     Default_Handler     ; HardFault
+    DCD     Default_Handler     ; MemManage
+    DCD     Default_Handler     ; BusFault
+    DCD     Default_Handler     ; UsageFault
+    DCD     0
+    DCD     0
+    DCD     0
+    DCD     0
+    DCD     SVC_Handler
+    DCD     Default_Handler     ; DebugMon
+    DCD     0
+    DCD     PendSV_Handler
+    DCD     SysTick_Handler
+    ; IRQ 0 to 27 are unused
+    FILL    28 * 4, 0
+    DCD     TIM2_IRQHandler     ; IRQ 28
+    DCD     TIM3_IRQHandler     ; IRQ 29
+    DCD     TIM4_IRQHandler     ; IRQ 30
+
+    AREA |.text|, CODE, READONLY
+
+; Straight into the C library, which sets up the stack and heap and calls main().  The clock
+; is left as it comes out of reset (HSI), which is what SystemCoreClockUpdate() reports.
+Reset_Handler PROC
+    EXPORT  Reset_Handler
+    IMPORT  __main
+    LDR     r0, =__main
+    BX      r0
+    ENDP
+
+Default_Handler PROC
+    EXPORT  SVC_Handler [WEAK]
+    EXPORT  PendSV_Handler [WEAK]
+    EXPORT  SysTick_Handler [WEAK]
+    EXPORT  TIM2_IRQHandler [WEAK]
+    EXPORT  TIM3_IRQHandler [WEAK]
+    EXPORT  TIM4_IRQHandler [WEAK]
+SVC_Handler
+PendSV_Handler
+SysTick_Handler
+TIM2_IRQHandler
+TIM3_IRQHandler
+TIM4_IRQHandler
+    B       .
+    ENDP
+
+    ALIGN
+
+; Stack and heap for the C library's two-region memory model
+    IMPORT  __use_two_region_memory
+    EXPORT  __user_initial_stackheap
+__user_initial_stackheap
+    LDR     r0, =Heap_Mem
+    LDR     r1, =(Stack_Mem + Stack_Size)
+    LDR     r2, =(Heap_Mem + Heap_Size)
+    LDR     r3, =Stack_Mem
+    BX      lr
+
+    ALIGN
+    END
@@ -0,0 +1,1109 @@
+/* Host-side scheduler simulator and schedulability benchmark.
+
+   This program links the unmodified scheduler sources against a small stand-in for the
+	 kernel (OS_currentTCB(), OS_elapsedTicks(), the idle TCB and a fake SCB) and drives their
+	 callbacks from a synthetic tick clock, exactly as SysTick_Handler and PendSV_Handler
+	 would on the target.  For every configuration a random periodic task set is generated
+	 (task count, periods, execution times and shared-resource blocking are all varied) and
+	 run against each selected scheduler, so policies can be compared on identical loads.
+
+   Each simulated task runs jobs of 'wcet' ticks every 'period' ticks.  Some jobs take a
+	 shared resource part way through, waiting with wait_callback() if another task holds it
+	 and releasing it with notify_callback(), which is how OS_mutex_t behaves.  When a job
+	 finishes the task sleeps until its next release the way OS_sleep() does.
+
+   Build and run from the repository root:
+
+     gcc -O2 -no-pie -fno-pie -Itools/schedsim -IOS -I. -include stm32f3xx.h -o schedsim \
+         tools/schedsim/schedsim.c FixedPriorityScheduler.c simpleRoundRobin.c OS/waittable.c cond.c -lm
+     ./schedsim -n 1000 -t 2:8 -u 0.2:0.95
+
+   One CSV row is printed per configuration and scheduler, followed by a summary for each
+	 scheduler.  Columns:
+     scheduler, config, tasks, util     - the generated load
+     jobs, misses                       - completed jobs, and jobs that finished after their
+                                          next release (implicit deadlines)
+     resp_mean, resp_p50/p95/p99/max    - response time in ticks from release to completion
+     norm_max                           - worst response time as a fraction of its period
+     switches, sched_calls              - context switches and scheduler invocations (a
+                                          scheduler's tick_callback decides whether a tick
+                                          invokes it; -e invokes it on every tick instead)
+     sched_ns_mean, sched_ns_max        - host time spent inside scheduler_callback
+     idle_pct                           - share of ticks spent in the idle task
+
+   Time within a tick is modelled as SIM_TICK_CYCLES core clock cycles, and the running task
+	 is charged for the cycles since the last switch whenever the scheduler is invoked, as
+	 _OS_scheduler() does on the target.  In the task set runs a task uses whole ticks.
+
+   With -w, no task sets are run.  Instead, tasks of mixed priority wait on one reason and
+	 are released with notifyone_callback() and then notify_callback(), and the order in
+	 which each scheduler wakes them is printed.  The exit status is non-zero if any selected
+	 scheduler that claims to (SIM_CLAIMS_WAKE_ORDER in the table below) didn't wake them
+	 highest priority first, in waiting order within a priority; for the others the result is
+	 only shown, as N/A:
+
+     ./schedsim -w -s fixedPriority
+
+   With -f, no task sets are run either.  Instead, CPU-bound tasks of each priority share the
+	 CPU with tasks that wake every few ticks, run for part of a tick and sleep again, and each
+	 CPU-bound task's share of the cycles the CPU-bound tasks got is compared with its priority's
+	 share of their total priority (its intended weight).  The exit status is non-zero if any
+	 selected scheduler that claims to share by priority (SIM_CLAIMS_SHARE) is more than
+	 SIM_SHARE_TOLERANCE away from a weight, relatively; the others are shown as N/A:
+
+     ./schedsim -f -s fixedPriority
+
+   With -c, no task sets are run either.  Instead, growing numbers of tasks wait on
+	 SIM_SCALE_REASONS shared reasons, while one more task repeatedly waits on a reason of its
+	 own and is woken with notifyone_callback() and then notify_callback().  The host time per
+	 wait and notify is printed for each task count, and the exit status is non-zero if any
+	 selected scheduler's cost at the largest count is more than SIM_SCALE_TOLERANCE times its
+	 cost at the smallest, i.e. if waking a task depends on how many others are waiting:
+
+     ./schedsim -c
+
+   With -l, no task sets are run either.  Instead, producers and consumers share an item
+	 count through an OS_mutex_t and a condition variable (cond.c), whose SVC handlers are
+	 called the way the kernel would call them.  The tasks are run a step at a time, a step
+	 being anything the target could do without being interrupted, and after any step the
+	 running task may be preempted at random.  Producers signal or broadcast, either holding
+	 the mutex or after releasing it.  Each of SIM_COND_ROUNDS rounds must end with every item
+	 consumed; the exit status is non-zero if any selected scheduler ever gets stuck with tasks
+	 waiting (a lost wakeup).  The handlers take pointers in 32-bit registers, which is why
+	 the simulator is built with -no-pie:
+
+     ./schedsim -l
+
+   To add a scheduler, add its OS_Scheduler_t and the properties it claims to the table
+	 below, and its source file to the command line. */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <time.h>
+#include <unistd.h>
+#include "os.h"
+#include "stm32f3xx.h"
+#include "FixedPriorityScheduler.h"
+#include "simpleRoundRobin.h"
+#include "cond.h"
+#include "os_internal.h"
+
+#define SIM_MAX_TASKS 1024
+#define SIM_MAX_RESOURCES 16
+#define SIM_TICK_CYCLES 1000
+#define SIM_SHARE_TOLERANCE 0.02
+#define SIM_SCALE_REASONS 16
+#define SIM_SCALE_OPS 20000
+#define SIM_SCALE_TOLERANCE 2.0
+#define SIM_COND_PRODUCERS 2
+#define SIM_COND_CONSUMERS 3
+#define SIM_COND_ITEMS 150        // per producer
+#define SIM_COND_ROUNDS 200
+#define SIM_COND_PREEMPT 0.3      // chance of a preemption after each step
+
+/* Properties a scheduler claims, which the checks that test them hold it to */
+#define SIM_CLAIMS_WAKE_ORDER (1UL << 0)   // waiting tasks are woken highest priority first (-w)
+#define SIM_CLAIMS_SHARE (1UL << 1)        // CPU time is shared in proportion to priority (-f)
+
+/* Schedulers that can be selected with -s */
+static struct {
+	char const * name;
+	OS_Scheduler_t const * scheduler;
+	uint32_t claims;
+} const schedulers[] = {
+	{ "fixedPriority", &fixedPriorityScheduler, SIM_CLAIMS_WAKE_ORDER | SIM_CLAIMS_SHARE },
+	{ "roundRobin", &simpleRoundRobinScheduler, 0 },
+};
+#define SIM_SCHEDULERS (sizeof(schedulers) / sizeof(schedulers[0]))
+
+/* One simulated task.  The TCB is the first member, so the TCB pointers handed back by a
+   scheduler can be cast straight back to the task that owns them. */
+typedef struct {
+	OS_TCB_t tcb;
+	/* Parameters */
+	uint32_t period;
+	uint32_t wcet;
+	uint32_t phase;
+	uint32_t priority;
+	uint32_t resource;      // 0 = never blocks, otherwise resource index + 1
+	uint32_t blockStart;    // ticks into the job at which the resource is taken
+	uint32_t blockLength;   // ticks for which it is held
+	/* Current job */
+	uint32_t started;
+	uint32_t release;
+	uint32_t executed;
+	uint32_t holding;
+	/* Statistics */
+	uint32_t jobs;
+	uint32_t misses;
+	uint32_t waits;
+	uint32_t runTicks;
+	uint32_t maxResponse;
+	uint64_t runCycles;
+	/* Condition variable check (-l) */
+	uint32_t pc;
+	uint32_t check;
+	uint32_t mode;
+} simTask_t;
+
+/* Results of running one task set on one scheduler */
+typedef struct {
+	uint32_t length;
+	uint32_t jobs;
+	uint32_t misses;
+	uint32_t switches;
+	uint32_t schedCalls;
+	uint32_t idleTicks;
+	uint64_t schedNs;
+	uint64_t schedNsMax;
+	double normMax;
+	uint32_t * responses;
+	uint32_t responsesSize;
+} simRun_t;
+
+typedef enum {
+	SIM_RAN,       // the task used the tick
+	SIM_BLOCKED,   // the task trapped into the kernel without using the tick
+	SIM_SLEPT      // the task used the tick and then went to sleep
+} simStep_e;
+
+/******************/
+/* Kernel stand-in */
+/******************/
+
+SCB_Type simSCB;
+static OS_TCB_t _idleTCB;
+OS_TCB_t const * const OS_idleTCB_p = &_idleTCB;
+// Not static: cond.c's SVC handlers look at it
+OS_TCB_t * volatile _currentTCB = &_idleTCB;
+static OS_Scheduler_t const * _scheduler;
+static uint32_t _ticks = 0;
+static uint32_t _checkValue = 0;
+static uint32_t _cycles = 0;
+static uint32_t _cycleMark = 0;
+
+OS_TCB_t * OS_currentTCB(void) {
+	return _currentTCB;
+}
+
+uint32_t OS_elapsedTicks(void) {
+	return _ticks;
+}
+
+uint32_t currentCheckValue(void) {
+	return _checkValue;
+}
+
+uint32_t OS_taskCycles(OS_TCB_t const * task) {
+	uint32_t cycles = task->cycles;
+	if (task == _currentTCB) {
+		cycles += _cycles - _cycleMark;
+	}
+	return cycles;
+}
+
+uint32_t OS_tickCycles(void) {
+	return SIM_TICK_CYCLES;
+}
+
+/* The kernel's wait and notify, for cond.c's SVC handlers */
+void _OS_notify(void * reason) {
+	_checkValue++;
+	_scheduler->notify_callback(reason);
+}
+
+uint32_t _OS_notifyOne(void * reason) {
+	_checkValue++;
+	return _scheduler->notifyone_callback(reason);
+}
+
+void _OS_wait(void * reason) {
+	_scheduler->wait_callback(reason, _checkValue);
+}
+
+/* cond.c's SVC handlers, which the -l check calls as the kernel would */
+void _svc_OS_condWait(_OS_SVC_StackFrame_t * const stack);
+void _svc_OS_condSignal(_OS_SVC_StackFrame_t const * const stack);
+
+/* cond.c's task side is linked but never run: the -l check steps through it itself */
+void mutexAquire(OS_mutex_t * mutex) {
+	(void)mutex;
+	abort();
+}
+
+uint32_t _OS_condWait(OS_cond_t * cond, OS_mutex_t * mutex) {
+	(void)cond;
+	(void)mutex;
+	abort();
+}
+
+void _OS_condSignal(OS_cond_t * cond, uint32_t all) {
+	(void)cond;
+	(void)all;
+	abort();
+}
+
+/*************/
+/* Simulator */
+/*************/
+
+static simTask_t _tasks[SIM_MAX_TASKS];
+static uint32_t _taskCount;
+static simTask_t * _resourceOwner[SIM_MAX_RESOURCES];
+
+/* Command line options */
+static uint32_t _configs = 100;
+static uint32_t _minTasks = 2, _maxTasks = 8;
+static double _minUtil = 0.3, _maxUtil = 0.9;
+static double _blockProbability = 0.3;
+static uint32_t _resources = 2;
+static uint32_t _length = 10000;
+static uint32_t _minPeriod = 10, _maxPeriod = 200;
+static uint32_t _seed = 1;
+static int _verbose = 0;
+static int _everyTick = 0;
+static uint32_t _epoch = 0;
+
+static double sim_random(void) {
+	return (double)rand() / ((double)RAND_MAX + 1.0);
+}
+
+static uint32_t sim_randomRange(uint32_t min, uint32_t max) {
+	return min + (uint32_t)(sim_random() * (double)(max - min + 1));
+}
+
+static int sim_comparePeriod(void const * a, void const * b) {
+	simTask_t const * const * ta = a;
+	simTask_t const * const * tb = b;
+	return (int)(*ta)->period - (int)(*tb)->period;
+}
+
+static int sim_compareU32(void const * a, void const * b) {
+	uint32_t x = *(uint32_t const *)a, y = *(uint32_t const *)b;
+	return (x > y) - (x < y);
+}
+
+/* Generates a task set with the given task count and total utilisation.  Utilisation is
+   split between tasks with UUniFast, periods are log-uniform, and priorities are given
+	 rate-monotonically in three bands (shortest periods HIGH, longest LOW). */
+static double sim_generate(uint32_t count, double utilisation) {
+	simTask_t * byPeriod[SIM_MAX_TASKS];
+	double remaining = utilisation, actual = 0;
+	memset(_tasks, 0, sizeof(_tasks));
+	_taskCount = count;
+	for (uint32_t i = 0; i < count; i++) {
+		simTask_t * task = &_tasks[i];
+		double share = remaining;
+		if (i < count - 1) {
+			double next = remaining * pow(sim_random(), 1.0 / (double)(count - i - 1));
+			share = remaining - next;
+			remaining = next;
+		}
+		task->period = (uint32_t)lround(exp(log((double)_minPeriod) + sim_random() * (log((double)_maxPeriod) - log((double)_minPeriod))));
+		task->wcet = (uint32_t)lround(share * task->period);
+		if (task->wcet == 0) {
+			task->wcet = 1;
+		}
+		if (task->wcet > task->period) {
+			task->wcet = task->period;
+		}
+		task->phase = sim_randomRange(1, task->period);
+		if (_resources && sim_random() < _blockProbability) {
+			task->resource = sim_randomRange(1, _resources);
+			task->blockLength = sim_randomRange(1, task->wcet > 1 ? task->wcet / 2 : 1);
+			task->blockStart = sim_randomRange(0, task->wcet - task->blockLength);
+		}
+		actual += (double)task->wcet / task->period;
+		byPeriod[i] = task;
+	}
+	qsort(byPeriod, count, sizeof(byPeriod[0]), sim_comparePeriod);
+	for (uint32_t i = 0; i < count; i++) {
+		byPeriod[i]->priority = (i * 3 < count) ? HIGH : (i * 3 < count * 2) ? MEDIUM : LOW;
+	}
+	return actual;
+}
+
+/* Equivalent of PendSV: calls the scheduler and switches to whatever it returns */
+static void sim_schedule(simRun_t * run) {
+	struct timespec start, end;
+	simSCB.ICSR = 0;
+	_currentTCB->cycles += _cycles - _cycleMark;
+	_cycleMark = _cycles;
+	clock_gettime(CLOCK_MONOTONIC, &start);
+	OS_TCB_t const * next = _scheduler->scheduler_callback();
+	clock_gettime(CLOCK_MONOTONIC, &end);
+	uint64_t ns = (uint64_t)(end.tv_sec - start.tv_sec) * 1000000000u + (uint64_t)(end.tv_nsec - start.tv_nsec);
+	run->schedCalls++;
+	run->schedNs += ns;
+	if (ns > run->schedNsMax) {
+		run->schedNsMax = ns;
+	}
+	if (next != _currentTCB) {
+		run->switches++;
+	}
+	_currentTCB = (OS_TCB_t *)next;
+}
+
+static void sim_recordResponse(simRun_t * run, simTask_t * task, uint32_t response) {
+	if (run->jobs == run->responsesSize) {
+		run->responsesSize = run->responsesSize ? run->responsesSize * 2 : 1024;
+		run->responses = realloc(run->responses, run->responsesSize * sizeof(uint32_t));
+		if (!run->responses) {
+			perror("realloc");
+			exit(1);
+		}
+	}
+	run->responses[run->jobs++] = response;
+	task->jobs++;
+	if (response > task->maxResponse) {
+		task->maxResponse = response;
+	}
+	if ((double)response / task->period > run->normMax) {
+		run->normMax = (double)response / task->period;
+	}
+	if (response > task->period) {
+		task->misses++;
+		run->misses++;
+	}
+}
+
+/* Runs the current task for the tick starting at 'now' */
+static simStep_e sim_step(simRun_t * run, simTask_t * task, uint32_t now) {
+	if (!task->started) {
+		// The first thing each task does is sleep until its first release
+		task->started = 1;
+		if (task->release > now) {
+			task->tcb.data = _epoch + task->release - 1;
+			task->tcb.state = TASK_STATE_SLEEP | TASK_STATE_YIELD;
+			return SIM_BLOCKED;
+		}
+	}
+	if (task->resource && !task->holding && task->executed == task->blockStart) {
+		simTask_t ** owner = &_resourceOwner[task->resource - 1];
+		if (*owner && *owner != task) {
+			// Resource is taken: block on it like mutexAquire() does
+			task->waits++;
+			_scheduler->wait_callback((void *)owner, currentCheckValue());
+			return SIM_BLOCKED;
+		}
+		*owner = task;
+		task->holding = 1;
+	}
+	task->executed++;
+	task->runTicks++;
+	if (task->holding && task->executed == task->blockStart + task->blockLength) {
+		simTask_t ** owner = &_resourceOwner[task->resource - 1];
+		*owner = NULL;
+		task->holding = 0;
+		_checkValue++;
+		_scheduler->notify_callback((void *)owner);
+	}
+	if (task->executed < task->wcet) {
+		return SIM_RAN;
+	}
+	// Job complete
+	sim_recordResponse(run, task, now + 1 - task->release);
+	task->release += task->period;
+	task->executed = 0;
+	if (task->release > now + 1) {
+		// Sleep until the next release, exactly as OS_sleep() followed by OS_yield() would
+		task->tcb.data = _epoch + task->release - 1;
+		task->tcb.state = TASK_STATE_SLEEP | TASK_STATE_YIELD;
+		return SIM_SLEPT;
+	}
+	return SIM_RAN;
+}
+
+/* Runs the current task set against the current scheduler */
+static void sim_run(simRun_t * run) {
+	run->jobs = run->misses = run->switches = run->schedCalls = run->idleTicks = 0;
+	run->schedNs = run->schedNsMax = 0;
+	run->normMax = 0;
+	run->length = _length;
+	memset(_resourceOwner, 0, sizeof(_resourceOwner));
+	memset(&_idleTCB, 0, sizeof(_idleTCB));
+	_currentTCB = &_idleTCB;
+	_ticks = _epoch;
+	_cycles = _cycleMark = 0;
+
+	for (uint32_t i = 0; i < _taskCount; i++) {
+		simTask_t * task = &_tasks[i];
+		memset(&task->tcb, 0, sizeof(task->tcb));
+		task->tcb.priority = task->priority;
+		// As OS_initialiseTCB() does
+		task->tcb.ticks = _epoch;
+		task->release = task->phase;
+		task->executed = task->holding = 0;
+		task->jobs = task->misses = task->waits = task->runTicks = task->maxResponse = 0;
+		task->started = 0;
+		if (!_scheduler->addtask_callback(&task->tcb)) {
+			fprintf(stderr, "# task %u rejected: scheduler is full\n", i);
+		}
+	}
+
+	for (uint32_t now = 1; now <= _length; now++) {
+		// SysTick: advance the clock and pend PendSV if the scheduler asks for it
+		_ticks = _epoch + now;
+		if (_everyTick || !_scheduler->tick_callback || _scheduler->tick_callback(_ticks)
+				|| (simSCB.ICSR & SCB_ICSR_PENDSVSET_Msk)) {
+			sim_schedule(run);
+		}
+		// Give this tick to whichever task the scheduler settles on
+		for (uint32_t attempts = 0; ; attempts++) {
+			if (_currentTCB == &_idleTCB || attempts > _taskCount) {
+				run->idleTicks++;
+				break;
+			}
+			simStep_e step = sim_step(run, (simTask_t *)_currentTCB, now);
+			if (step == SIM_RAN) {
+				break;
+			}
+			// Blocking or sleeping traps into the kernel, which pends PendSV straight away
+			if (step == SIM_SLEPT) {
+				_cycles = now * SIM_TICK_CYCLES;
+			}
+			sim_schedule(run);
+			if (step == SIM_SLEPT) {
+				break;
+			}
+		}
+		_cycles = now * SIM_TICK_CYCLES;
+	}
+
+	for (uint32_t i = 0; i < _taskCount; i++) {
+		_scheduler->taskexit_callback(&_tasks[i].tcb);
+	}
+}
+
+/* Task priorities for the wake-order check, in the order the tasks start waiting */
+static uint32_t const _wakePriorities[] = { LOW, HIGH, MEDIUM, LOW, HIGH, MEDIUM, HIGH, LOW };
+#define SIM_WAKE_TASKS (sizeof(_wakePriorities) / sizeof(_wakePriorities[0]))
+
+/* Adds the wake-order tasks and makes each one wait on 'reason', the way OS_wait() does */
+static void sim_wakeSetup(void * reason) {
+	_ticks = _epoch;
+	_taskCount = SIM_WAKE_TASKS;
+	for (uint32_t i = 0; i < SIM_WAKE_TASKS; i++) {
+		simTask_t * task = &_tasks[i];
+		memset(task, 0, sizeof(*task));
+		task->tcb.priority = task->priority = _wakePriorities[i];
+		task->tcb.ticks = _epoch;
+		_scheduler->addtask_callback(&task->tcb);
+	}
+	for (uint32_t i = 0; i < SIM_WAKE_TASKS; i++) {
+		_currentTCB = &_tasks[i].tcb;
+		_scheduler->wait_callback(reason, currentCheckValue());
+	}
+	_currentTCB = &_idleTCB;
+	simSCB.ICSR = 0;
+}
+
+/* Prints a wake order, and returns non-zero if it is highest priority first and first come
+   first served within a priority */
+static uint32_t sim_wakeReport(char const * name, char const * how, uint32_t const * order, uint32_t count) {
+	uint32_t ordered = count == SIM_WAKE_TASKS;
+	printf("%s %s:", name, how);
+	for (uint32_t i = 0; i < count; i++) {
+		printf(" %u(%u)", order[i], _wakePriorities[order[i]]);
+		if (i > 0) {
+			uint32_t before = _wakePriorities[order[i - 1]], after = _wakePriorities[order[i]];
+			if (before < after || (before == after && order[i - 1] > order[i])) {
+				ordered = 0;
+			}
+		}
+	}
+	printf(" - %s\n", ordered ? "priority order" : "NOT priority order");
+	return ordered;
+}
+
+/* Wake-order check (-w).  Returns non-zero if the scheduler passes. */
+static uint32_t sim_wakeOrder(char const * name) {
+	static uint32_t reason;
+	uint32_t order[SIM_WAKE_TASKS], count, passed;
+
+	// Notify-one: see which task leaves the waiting state each time
+	sim_wakeSetup(&reason);
+	for (count = 0; count < SIM_WAKE_TASKS; count++) {
+		if (!_scheduler->notifyone_callback(&reason)) {
+			break;
+		}
+		for (uint32_t i = 0; i < SIM_WAKE_TASKS; i++) {
+			simTask_t * task = &_tasks[i];
+			if (!task->holding && !(task->tcb.state & TASK_STATE_WAIT)) {
+				task->holding = 1;
+				order[count] = i;
+			}
+		}
+	}
+	passed = sim_wakeReport(name, "notify-one", order, count);
+	for (uint32_t i = 0; i < SIM_WAKE_TASKS; i++) {
+		_scheduler->taskexit_callback(&_tasks[i].tcb);
+	}
+
+	// Notify-all: the woken tasks should be scheduled in priority order
+	sim_wakeSetup(&reason);
+	_checkValue++;
+	_scheduler->notify_callback(&reason);
+	for (count = 0; count < SIM_WAKE_TASKS; count++) {
+		OS_TCB_t const * next = _scheduler->scheduler_callback();
+		if (next == &_idleTCB) {
+			break;
+		}
+		order[count] = (uint32_t)((simTask_t const *)next - _tasks);
+		_scheduler->taskexit_callback((OS_TCB_t *)next);
+	}
+	passed &= sim_wakeReport(name, "notify-all", order, count);
+	for (uint32_t i = 0; i < SIM_WAKE_TASKS; i++) {
+		_scheduler->taskexit_callback(&_tasks[i].tcb);
+	}
+	return passed;
+}
+
+/* Tasks for the CPU share check (-f).  The first ones never stop running; the rest wake every
+   'period' ticks, run for a random part of a tick and go back to sleep. */
+static uint32_t const _shareBusy[] = { HIGH, MEDIUM, LOW, LOW };
+static uint32_t const _shareBursty[] = { 3, 5, 7 };
+#define SIM_SHARE_BUSY (sizeof(_shareBusy) / sizeof(_shareBusy[0]))
+#define SIM_SHARE_TASKS (SIM_SHARE_BUSY + sizeof(_shareBursty) / sizeof(_shareBursty[0]))
+
+/* CPU share check (-f).  Returns non-zero if the scheduler passes. */
+static uint32_t sim_share(char const * name) {
+	simRun_t run;
+	uint32_t weights = 0;
+	uint64_t busyCycles = 0;
+	double worst = 0;
+	memset(&run, 0, sizeof(run));
+	memset(&_idleTCB, 0, sizeof(_idleTCB));
+	_currentTCB = &_idleTCB;
+	_ticks = _epoch;
+	_cycles = _cycleMark = 0;
+	srand(_seed);
+	_taskCount = SIM_SHARE_TASKS;
+	for (uint32_t i = 0; i < SIM_SHARE_TASKS; i++) {
+		simTask_t * task = &_tasks[i];
+		memset(task, 0, sizeof(*task));
+		task->priority = (i < SIM_SHARE_BUSY) ? _shareBusy[i] : HIGH;
+		task->period = (i < SIM_SHARE_BUSY) ? 0 : _shareBursty[i - SIM_SHARE_BUSY];
+		task->tcb.priority = task->priority;
+		task->tcb.ticks = _epoch;
+		_scheduler->addtask_callback(&task->tcb);
+		if (i < SIM_SHARE_BUSY) {
+			weights += task->priority;
+		}
+	}
+
+	for (uint32_t now = 1; now <= _length; now++) {
+		uint32_t const end = now * SIM_TICK_CYCLES;
+		_ticks = _epoch + now;
+		if (!_scheduler->tick_callback || _scheduler->tick_callback(_ticks) || (simSCB.ICSR & SCB_ICSR_PENDSVSET_Msk)) {
+			sim_schedule(&run);
+		}
+		// Hand out the rest of the tick until it is used up
+		while (_cycles != end) {
+			if (_currentTCB == &_idleTCB) {
+				_cycles = end;
+				break;
+			}
+			simTask_t * task = (simTask_t *)_currentTCB;
+			if (!task->period) {
+				task->runCycles += end - _cycles;
+				_cycles = end;
+				break;
+			}
+			if (!task->executed) {
+				task->executed = sim_randomRange(SIM_TICK_CYCLES / 10, SIM_TICK_CYCLES * 9 / 10);
+			}
+			uint32_t const burst = (task->executed < end - _cycles) ? task->executed : end - _cycles;
+			task->runCycles += burst;
+			task->executed -= burst;
+			_cycles += burst;
+			if (!task->executed) {
+				// Burst over: sleep until 'period' ticks from now, as OS_sleep() would
+				task->tcb.data = _epoch + now + task->period - 1;
+				task->tcb.state = TASK_STATE_SLEEP | TASK_STATE_YIELD;
+				sim_schedule(&run);
+			}
+		}
+	}
+
+	for (uint32_t i = 0; i < SIM_SHARE_BUSY; i++) {
+		busyCycles += _tasks[i].runCycles;
+	}
+	printf("%s:", name);
+	for (uint32_t i = 0; i < SIM_SHARE_BUSY; i++) {
+		double const intended = (double)_tasks[i].priority / weights;
+		double const achieved = busyCycles ? (double)_tasks[i].runCycles / busyCycles : 0.0;
+		double const error = fabs(achieved - intended) / intended;
+		if (error > worst) {
+			worst = error;
+		}
+		printf(" %u(%u) %.2f%%/%.2f%%", i, _tasks[i].priority, 100.0 * achieved, 100.0 * intended);
+	}
+	printf(" - worst %.1f%% off, %s\n", 100.0 * worst, worst <= SIM_SHARE_TOLERANCE ? "fair" : "NOT fair");
+	for (uint32_t i = 0; i < SIM_SHARE_TASKS; i++) {
+		_scheduler->taskexit_callback(&_tasks[i].tcb);
+	}
+	return worst <= SIM_SHARE_TOLERANCE;
+}
+
+/* Returns the least host time in nanoseconds over several rounds of SIM_SCALE_OPS waits by
+   'probe' on its own reason, each followed by a notify-one (or, if 'all', a notify-all) */
+static double sim_scaleTime(simTask_t * probe, void * reason, uint32_t all) {
+	double best = 0;
+	for (uint32_t round = 0; round < 5; round++) {
+		struct timespec start, end;
+		clock_gettime(CLOCK_MONOTONIC, &start);
+		for (uint32_t i = 0; i < SIM_SCALE_OPS; i++) {
+			_currentTCB = &probe->tcb;
+			_scheduler->wait_callback(reason, currentCheckValue());
+			_currentTCB = &_idleTCB;
+			if (all) {
+				_scheduler->notify_callback(reason);
+			}
+			else {
+				_scheduler->notifyone_callback(reason);
+			}
+		}
+		clock_gettime(CLOCK_MONOTONIC, &end);
+		double const ns = ((end.tv_sec - start.tv_sec) * 1e9 + (end.tv_nsec - start.tv_nsec)) / SIM_SCALE_OPS;
+		if (round == 0 || ns < best) {
+			best = ns;
+		}
+	}
+	return best;
+}
+
+/* Wait/notify scaling check (-c).  Returns non-zero if the scheduler passes. */
+static uint32_t sim_scaling(char const * name) {
+	static uint32_t reasons[SIM_SCALE_REASONS + 1];
+	static uint32_t const priorities[] = { HIGH, MEDIUM, LOW };
+	double first[2] = { 0, 0 }, last[2] = { 0, 0 };
+	uint32_t passed = 1;
+	for (uint32_t count = 16; count <= SIM_MAX_TASKS; count *= 4) {
+		_ticks = _epoch;
+		_currentTCB = &_idleTCB;
+		_taskCount = count;
+		for (uint32_t i = 0; i < count; i++) {
+			simTask_t * task = &_tasks[i];
+			memset(task, 0, sizeof(*task));
+			task->tcb.priority = task->priority = priorities[i % 3];
+			task->tcb.ticks = _epoch;
+			_scheduler->addtask_callback(&task->tcb);
+		}
+		// All but the last wait on the shared reasons; the last, of the lowest priority, is the probe
+		for (uint32_t i = 0; i < count - 1; i++) {
+			_currentTCB = &_tasks[i].tcb;
+			_scheduler->wait_callback(&reasons[i % SIM_SCALE_REASONS], currentCheckValue());
+		}
+		simTask_t * const probe = &_tasks[count - 1];
+		probe->tcb.priority = probe->priority = LOW;
+		double const one = sim_scaleTime(probe, &reasons[SIM_SCALE_REASONS], 0);
+		double const all = sim_scaleTime(probe, &reasons[SIM_SCALE_REASONS], 1);
+		printf("%s: %u tasks: wait + notify-one %.1f ns, wait + notify-all %.1f ns\n", name, count, one, all);
+		if (count == 16) {
+			first[0] = one;
+			first[1] = all;
+		}
+		last[0] = one;
+		last[1] = all;
+		for (uint32_t i = 0; i < count; i++) {
+			_scheduler->taskexit_callback(&_tasks[i].tcb);
+		}
+		simSCB.ICSR = 0;
+	}
+	for (uint32_t i = 0; i < 2; i++) {
+		if (last[i] > SIM_SCALE_TOLERANCE * first[i]) {
+			passed = 0;
+		}
+	}
+	printf("%s: notify-one x%.2f, notify-all x%.2f from 16 to %u tasks - %s\n", name,
+		last[0] / first[0], last[1] / first[1], SIM_MAX_TASKS, passed ? "flat" : "NOT flat");
+	return passed;
+}
+
+/* Steps of the condition variable check's tasks (-l).  Each is something the target does
+   without a chance of being interrupted part way through. */
+typedef enum {
+	COND_LOCK,          // mutexAquire(): take the check value and try for the mutex
+	COND_LOCK_WAIT,     // mutexAquire(): OS_wait() on the mutex, with that check value
+	COND_CHECK,         // consumer: look at the item count
+	COND_WAIT,          // consumer: _OS_condWait()
+	COND_TAKE,          // consumer: take an item
+	COND_PUT,           // producer: add an item
+	COND_SIGNAL,        // producer: condSignal() or condBroadcast()
+	COND_UNLOCK,        // mutexRelease(): let go of the mutex
+	COND_UNLOCK_NOTIFY, // mutexRelease(): OS_notify() on the mutex
+	COND_DONE
+} simCondStep_e;
+
+static OS_mutex_t _condMutex;
+static OS_cond_t _condVar;
+static uint32_t _condItems;
+
+/* Producer modes: bit 0 broadcasts rather than signals, bit 1 signals after unlocking */
+#define SIM_COND_BROADCAST 1
+#define SIM_COND_AFTER 2
+
+/* Signals the condition variable as condSignal() and condBroadcast() do */
+static void sim_condSignal(simTask_t * task) {
+	if (_condVar.waiting) {
+		_OS_SVC_StackFrame_t frame = { (uint32_t)(uintptr_t)&_condVar, task->mode & SIM_COND_BROADCAST };
+		_svc_OS_condSignal(&frame);
+	}
+}
+
+/* Runs one step of the current task.  Returns non-zero if it trapped into the kernel in a way
+   that pends PendSV, or finished. */
+static uint32_t sim_condStep(simTask_t * task, uint32_t * waits) {
+	uint32_t const producer = task->resource;
+	switch (task->pc) {
+	case COND_LOCK:
+		task->check = currentCheckValue();
+		if (_condMutex.task) {
+			task->pc = COND_LOCK_WAIT;
+			return 0;
+		}
+		_condMutex.task = &task->tcb;
+		_condMutex.counter = 1;
+		task->pc = producer ? COND_PUT : COND_CHECK;
+		return 0;
+	case COND_LOCK_WAIT:
+		task->pc = COND_LOCK;
+		_scheduler->wait_callback((void *)&_condMutex, task->check);
+		return 1;
+	case COND_CHECK:
+		task->pc = _condItems ? COND_TAKE : COND_WAIT;
+		return 0;
+	case COND_WAIT: {
+		_OS_SVC_StackFrame_t frame = { (uint32_t)(uintptr_t)&_condVar, (uint32_t)(uintptr_t)&_condMutex };
+		_svc_OS_condWait(&frame);
+		(*waits)++;
+		// condWait() takes the mutex again when it is woken
+		task->pc = COND_LOCK;
+		return 1;
+	}
+	case COND_TAKE:
+		_condItems--;
+		task->jobs++;
+		task->pc = COND_UNLOCK;
+		return 0;
+	case COND_PUT:
+		_condItems++;
+		task->jobs++;
+		task->mode = (uint32_t)rand() % 4;
+		task->pc = (task->mode & SIM_COND_AFTER) ? COND_UNLOCK : COND_SIGNAL;
+		return 0;
+	case COND_SIGNAL:
+		sim_condSignal(task);
+		task->pc = (task->mode & SIM_COND_AFTER) ? COND_DONE : COND_UNLOCK;
+		break;
+	case COND_UNLOCK:
+		_condMutex.counter = 0;
+		_condMutex.task = 0;
+		task->pc = COND_UNLOCK_NOTIFY;
+		return 0;
+	case COND_UNLOCK_NOTIFY:
+		_OS_notify((void *)&_condMutex);
+		task->pc = (producer && (task->mode & SIM_COND_AFTER)) ? COND_SIGNAL : COND_DONE;
+		break;
+	}
+	// The end of an item: carry on, or exit once the task has done its share
+	if (task->pc == COND_DONE) {
+		if (task->jobs < task->period) {
+			task->pc = COND_LOCK;
+			return 0;
+		}
+		_scheduler->taskexit_callback(&task->tcb);
+		return 1;
+	}
+	return 0;
+}
+
+/* Lost wakeup check (-l).  Returns non-zero if the scheduler passes. */
+static uint32_t sim_condition(char const * name) {
+	uint32_t const tasks = SIM_COND_PRODUCERS + SIM_COND_CONSUMERS;
+	uint32_t const total = SIM_COND_PRODUCERS * SIM_COND_ITEMS;
+	uint64_t steps = 0, preemptions = 0;
+	uint32_t waits = 0;
+	simRun_t run;
+	memset(&run, 0, sizeof(run));
+	if ((uintptr_t)&_condVar > 0xFFFFFFFFu) {
+		printf("%s: the condition variable is above 4 GiB, so build with -no-pie to run -l\n", name);
+		return 0;
+	}
+	for (uint32_t round = 0; round < SIM_COND_ROUNDS; round++) {
+		srand(_seed + round);
+		memset(&_idleTCB, 0, sizeof(_idleTCB));
+		_currentTCB = &_idleTCB;
+		_ticks = _epoch;
+		_cycles = _cycleMark = 0;
+		_condMutex.task = 0;
+		_condMutex.counter = 0;
+		condInit(&_condVar);
+		_condItems = 0;
+		_taskCount = tasks;
+		for (uint32_t i = 0; i < tasks; i++) {
+			simTask_t * task = &_tasks[i];
+			memset(task, 0, sizeof(*task));
+			// 'resource' marks a producer, 'period' is how many items it puts or takes
+			task->resource = i < SIM_COND_PRODUCERS;
+			task->period = task->resource ? SIM_COND_ITEMS
+				: total / SIM_COND_CONSUMERS + (i - SIM_COND_PRODUCERS < total % SIM_COND_CONSUMERS);
+			task->tcb.priority = task->priority = sim_randomRange(LOW, HIGH);
+			task->tcb.ticks = _epoch;
+			_scheduler->addtask_callback(&task->tcb);
+		}
+		sim_schedule(&run);
+		uint32_t finished = 0;
+		while (finished < tasks) {
+			if (_currentTCB == &_idleTCB) {
+				uint32_t consumed = 0;
+				for (uint32_t i = SIM_COND_PRODUCERS; i < tasks; i++) {
+					consumed += _tasks[i].jobs;
+				}
+				printf("%s: round %u stuck with %u of %u tasks unfinished, %u items left, %u consumed, %u waiting on the condition variable - LOST WAKEUP\n",
+					name, round, tasks - finished, tasks, _condItems, consumed, _condVar.waiting);
+				for (uint32_t i = 0; i < tasks; i++) {
+					_scheduler->taskexit_callback(&_tasks[i].tcb);
+				}
+				simSCB.ICSR = 0;
+				return 0;
+			}
+			simTask_t * const task = (simTask_t *)_currentTCB;
+			steps++;
+			_cycles += SIM_TICK_CYCLES / 4;
+			uint32_t trapped = sim_condStep(task, &waits);
+			finished += task->pc == COND_DONE;
+			if (steps % 4 == 0) {
+				// SysTick
+				_ticks++;
+				trapped |= !_scheduler->tick_callback || _scheduler->tick_callback(_ticks);
+			}
+			if (!trapped && task->pc != COND_DONE && sim_random() < SIM_COND_PREEMPT) {
+				// Preempted: go to the back of the queue, as at the end of a time slice
+				task->tcb.state |= TASK_STATE_YIELD;
+				preemptions++;
+				trapped = 1;
+			}
+			if (trapped || (simSCB.ICSR & SCB_ICSR_PENDSVSET_Msk)) {
+				sim_schedule(&run);
+			}
+		}
+		if (_condItems || _condMutex.task) {
+			printf("%s: round %u ended with %u items left and the mutex %s - BROKEN\n",
+				name, round, _condItems, _condMutex.task ? "held" : "free");
+			return 0;
+		}
+	}
+	printf("%s: %u rounds, %llu steps, %llu preemptions, %u waits on the condition variable - no lost wakeups\n",
+		name, SIM_COND_ROUNDS, (unsigned long long)steps, (unsigned long long)preemptions, waits);
+	return 1;
+}
+
+static uint32_t sim_percentile(simRun_t const * run, double p) {
+	if (run->jobs == 0) {
+		return 0;
+	}
+	uint32_t index = (uint32_t)(p * (run->jobs - 1) + 0.5);
+	return run->responses[index];
+}
+
+static void sim_report(char const * name, uint32_t config, double utilisation, simRun_t * run) {
+	uint64_t total = 0;
+	for (uint32_t i = 0; i < run->jobs; i++) {
+		total += run->responses[i];
+	}
+	qsort(run->responses, run->jobs, sizeof(uint32_t), sim_compareU32);
+	printf("%s,%u,%u,%.3f,%u,%u,%.2f,%u,%u,%u,%u,%.2f,%u,%u,%.1f,%llu,%.1f\n",
+		name, config, _taskCount, utilisation, run->jobs, run->misses,
+		run->jobs ? (double)total / run->jobs : 0.0,
+		sim_percentile(run, 0.50), sim_percentile(run, 0.95), sim_percentile(run, 0.99),
+		run->jobs ? run->responses[run->jobs - 1] : 0, run->normMax,
+		run->switches, run->schedCalls,
+		run->schedCalls ? (double)run->schedNs / run->schedCalls : 0.0,
+		(unsigned long long)run->schedNsMax,
+		100.0 * run->idleTicks / run->length);
+	if (_verbose) {
+		for (uint32_t i = 0; i < _taskCount; i++) {
+			simTask_t const * task = &_tasks[i];
+			printf("#  task %u: period %u wcet %u priority %u resource %u(%u+%u) jobs %u misses %u waits %u cpu %.1f%% max response %u\n",
+				i, task->period, task->wcet, task->priority, task->resource, task->blockStart, task->blockLength,
+				task->jobs, task->misses, task->waits, 100.0 * task->runTicks / run->length, task->maxResponse);
+		}
+	}
+}
+
+static void sim_usage(char const * argv0) {
+	fprintf(stderr,
+		"usage: %s [options]\n"
+		"  -s name      scheduler to run, or 'all' (default all)\n"
+		"  -n count     number of task sets to generate (default %u)\n"
+		"  -t min:max   tasks per set (default %u:%u)\n"
+		"  -u min:max   total utilisation per set (default %.2f:%.2f)\n"
+		"  -p min:max   task period range in ticks (default %u:%u)\n"
+		"  -b prob      probability that a task blocks on a shared resource (default %.2f)\n"
+		"  -r count     number of shared resources (default %u)\n"
+		"  -T ticks     simulated ticks per run (default %u)\n"
+		"  -x seed      random seed (default %u)\n"
+		"  -v           print per-task statistics\n"
+		"  -e           run the scheduler on every tick, ignoring tick_callback\n"
+		"  -o ticks     value of OS_elapsedTicks() when each run starts (default 0); try\n"
+		"               0xfffff000 to check that the schedulers cope with it wrapping\n"
+		"  -w           check the order in which waiting tasks of mixed priority are woken\n"
+		"  -f           check that CPU-bound tasks get CPU time in proportion to priority\n"
+		"  -c           check that waking a task costs the same however many are waiting\n"
+		"  -l           check that condition variables never lose a wakeup under preemption\n"
+		"schedulers:", argv0, _configs, _minTasks, _maxTasks, _minUtil, _maxUtil,
+		_minPeriod, _maxPeriod, _blockProbability, _resources, _length, _seed);
+	for (size_t i = 0; i < SIM_SCHEDULERS; i++) {
+		fprintf(stderr, " %s", schedulers[i].name);
+	}
+	fprintf(stderr, "\n");
+	exit(2);
+}
+
+int main(int argc, char ** argv) {
+	char const * selected = "all";
+	int opt, wakeOrder = 0, share = 0, scaling = 0, condition = 0;
+	while ((opt = getopt(argc, argv, "s:n:t:u:p:b:r:T:x:veo:wfcl")) != -1) {
+		switch (opt) {
+			case 's': selected = optarg; break;
+			case 'n': _configs = (uint32_t)strtoul(optarg, NULL, 0); break;
+			case 't': if (sscanf(optarg, "%u:%u", &_minTasks, &_maxTasks) != 2) sim_usage(argv[0]); break;
+			case 'u': if (sscanf(optarg, "%lf:%lf", &_minUtil, &_maxUtil) != 2) sim_usage(argv[0]); break;
+			case 'p': if (sscanf(optarg, "%u:%u", &_minPeriod, &_maxPeriod) != 2) sim_usage(argv[0]); break;
+			case 'b': _blockProbability = strtod(optarg, NULL); break;
+			case 'r': _resources = (uint32_t)strtoul(optarg, NULL, 0); break;
+			case 'T': _length = (uint32_t)strtoul(optarg, NULL, 0); break;
+			case 'x': _seed = (uint32_t)strtoul(optarg, NULL, 0); break;
+			case 'v': _verbose = 1; break;
+			case 'e': _everyTick = 1; break;
+			case 'o': _epoch = (uint32_t)strtoul(optarg, NULL, 0); break;
+			case 'w': wakeOrder = 1; break;
+			case 'f': share = 1; break;
+			case 'c': scaling = 1; break;
+			case 'l': condition = 1; break;
+			default: sim_usage(argv[0]);
+		}
+	}
+	if (_minTasks < 1 || _maxTasks > SIM_MAX_TASKS || _minTasks > _maxTasks || _resources > SIM_MAX_RESOURCES
+			|| _minPeriod < 1 || _minPeriod > _maxPeriod || _minUtil > _maxUtil) {
+		sim_usage(argv[0]);
+	}
+
+	int enabled[SIM_SCHEDULERS] = {0};
+	for (size_t i = 0; i < SIM_SCHEDULERS; i++) {
+		enabled[i] = !strcmp(selected, "all") || !strcmp(selected, schedulers[i].name);
+		if (enabled[i]) {
+			// Mirror the checks OS_init() makes on the callback block
+			if (!schedulers[i].scheduler->scheduler_callback || !schedulers[i].scheduler->addtask_callback
+					|| !schedulers[i].scheduler->taskexit_callback || !schedulers[i].scheduler->wait_callback
+					|| !schedulers[i].scheduler->notify_callback || !schedulers[i].scheduler->notifyone_callback) {
+				fprintf(stderr, "scheduler %s is missing callbacks\n", schedulers[i].name);
+				return 1;
+			}
+		}
+	}
+
+	if (wakeOrder) {
+		uint32_t passed = 1;
+		for (size_t i = 0; i < SIM_SCHEDULERS; i++) {
+			if (enabled[i]) {
+				_scheduler = schedulers[i].scheduler;
+				uint32_t const ordered = sim_wakeOrder(schedulers[i].name);
+				if (schedulers[i].claims & SIM_CLAIMS_WAKE_ORDER) {
+					passed &= ordered;
+				} else {
+					printf("%s: N/A, it doesn't claim to wake in priority order\n", schedulers[i].name);
+				}
+			}
+		}
+		return passed ? 0 : 1;
+	}
+
+	if (share) {
+		uint32_t passed = 1;
+		for (size_t i = 0; i < SIM_SCHEDULERS; i++) {
+			if (enabled[i]) {
+				_scheduler = schedulers[i].scheduler;
+				uint32_t const fair = sim_share(schedulers[i].name);
+				if (schedulers[i].claims & SIM_CLAIMS_SHARE) {
+					passed &= fair;
+				} else {
+					printf("%s: N/A, it doesn't claim to share by priority\n", schedulers[i].name);
+				}
+			}
+		}
+		return passed ? 0 : 1;
+	}
+
+	if (scaling) {
+		uint32_t passed = 1;
+		for (size_t i = 0; i < SIM_SCHEDULERS; i++) {
+			if (enabled[i]) {
+				_scheduler = schedulers[i].scheduler;
+				passed &= sim_scaling(schedulers[i].name);
+			}
+		}
+		return passed ? 0 : 1;
+	}
+
+	if (condition) {
+		uint32_t passed = 1;
+		for (size_t i = 0; i < SIM_SCHEDULERS; i++) {
+			if (enabled[i]) {
+				_scheduler = schedulers[i].scheduler;
+				passed &= sim_condition(schedulers[i].name);
+			}
+		}
+		return passed ? 0 : 1;
+	}
+
+	simRun_t runs[SIM_SCHEDULERS];
+	uint64_t jobs[SIM_SCHEDULERS] = {0}, misses[SIM_SCHEDULERS] = {0}, switches[SIM_SCHEDULERS] = {0};
+	uint64_t calls[SIM_SCHEDULERS] = {0}, ns[SIM_SCHEDULERS] = {0}, nsMax[SIM_SCHEDULERS] = {0};
+	uint32_t missedSets[SIM_SCHEDULERS] = {0};
+	memset(runs, 0, sizeof(runs));
+
+	printf("scheduler,config,tasks,util,jobs,misses,resp_mean,resp_p50,resp_p95,resp_p99,resp_max,norm_max,"
+		"switches,sched_calls,sched_ns_mean,sched_ns_max,idle_pct\n");
+	for (uint32_t config = 0; config < _configs; config++) {
+		// Every scheduler sees the same task set for a given configuration
+		srand(_seed + config);
+		uint32_t count = sim_randomRange(_minTasks, _maxTasks);
+		double utilisation = sim_generate(count, _minUtil + sim_random() * (_maxUtil - _minUtil));
+		for (size_t i = 0; i < SIM_SCHEDULERS; i++) {
+			if (!enabled[i]) {
+				continue;
+			}
+			_scheduler = schedulers[i].scheduler;
+			sim_run(&runs[i]);
+			jobs[i] += runs[i].jobs;
+			misses[i] += runs[i].misses;
+			missedSets[i] += runs[i].misses != 0;
+			switches[i] += runs[i].switches;
+			calls[i] += runs[i].schedCalls;
+			ns[i] += runs[i].schedNs;
+			if (runs[i].schedNsMax > nsMax[i]) {
+				nsMax[i] = runs[i].schedNsMax;
+			}
+			sim_report(schedulers[i].name, config, utilisation, &runs[i]);
+		}
+	}
+
+	for (size_t i = 0; i < SIM_SCHEDULERS; i++) {
+		if (!enabled[i]) {
+			continue;
+		}
+		printf("# %s: %u sets, %u with misses, %llu jobs, %.3f%% missed, %.3f switches/tick, %.3f calls/tick, %.1f ns/call (max %llu)\n",
+			schedulers[i].name, _configs, missedSets[i], (unsigned long long)jobs[i],
+			jobs[i] ? 100.0 * misses[i] / jobs[i] : 0.0,
+			(double)switches[i] / ((double)_configs * _length),
+			(double)calls[i] / ((double)_configs * _length),
+			calls[i] ? (double)ns[i] / calls[i] : 0.0, (unsigned long long)nsMax[i]);
+		free(runs[i].responses);
+	}
+	return 0;
+}
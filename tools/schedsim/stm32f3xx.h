@@ -0,0 +1,32 @@
+#ifndef __STM32F3xx_H
+#define __STM32F3xx_H
+
+/* Host stand-in for the device header, used only by the scheduler simulator.
+
+   The schedulers include "stm32f3xx.h" to reach SCB (to pend PendSV), and os.h relies on
+	 the __svc keyword that the ARM compiler provides.  The simulator is built with
+	 -Itools/schedsim -include stm32f3xx.h, so this file is seen before anything else and
+	 the scheduler sources compile unmodified for Linux. */
+
+#include <stdint.h>
+#include <stdlib.h>
+
+/* ARM compiler keywords and intrinsics */
+#define __svc(x)
+#define __align(x)
+#define __breakpoint(x) abort()
+
+/* System control block.  Only the registers the kernel touches are modelled; the
+   simulator watches ICSR to see when a scheduler callback has asked for PendSV. */
+typedef struct {
+	volatile uint32_t ICSR;
+	volatile uint32_t CCR;
+} SCB_Type;
+
+extern SCB_Type simSCB;
+#define SCB (&simSCB)
+
+#define SCB_ICSR_PENDSVSET_Msk (1UL << 28)
+#define SCB_CCR_STKALIGN_Msk   (1UL << 9)
+
+#endif /* __STM32F3xx_H */
@@ -0,0 +1,62 @@
+#include "uartrx.h"
+#include "stm32f3xx.h"
+#include "critical.h"
+
+/* USART2 receive path.  DMA1 channel 6 copies every received byte into a circular buffer
+   without any CPU involvement.  The half-transfer and transfer-complete interrupts report
+	 progress at least twice per lap of the buffer, and the USART idle-line interrupt reports
+	 the end of each burst, so the reader sees short messages straight away. */
+
+static uint8_t _rxBuffer[UART_RX_BUFFER_SIZE];
+static streamBuffer_t _rxStream;
+
+/* Offset in the buffer that the DMA channel will write next */
+static uint32_t _rxPosition(void) {
+	return UART_RX_BUFFER_SIZE - DMA1_Channel6->CNDTR;
+}
+
+streamBuffer_t *uartRxInit(uint32_t trigger) {
+	streamBufferInit(&_rxStream, _rxBuffer, UART_RX_BUFFER_SIZE, trigger);
+
+	RCC->AHBENR |= RCC_AHBENR_GPIOAEN | RCC_AHBENR_DMA1EN;
+	GPIOA->MODER &= ~GPIO_MODER_MODER3;
+	GPIOA->MODER |= GPIO_MODER_MODER3_1;		/* Setup RX pin (GPIOA_3) for Alternate Function */
+	GPIOA->AFR[0] |= (7 << (4*3));				/* Setup USART RX as the Alternate Function */
+
+	/* Peripheral to memory, byte to byte, incrementing memory address, circular */
+	DMA1_Channel6->CCR = 0;
+	DMA1_Channel6->CPAR = (uint32_t)&USART2->RDR;
+	DMA1_Channel6->CMAR = (uint32_t)_rxBuffer;
+	DMA1_Channel6->CNDTR = UART_RX_BUFFER_SIZE;
+	DMA1_Channel6->CCR = DMA_CCR_MINC | DMA_CCR_CIRC | DMA_CCR_HTIE | DMA_CCR_TCIE;
+	DMA1_Channel6->CCR |= DMA_CCR_EN;
+
+	USART2->ICR = USART_ICR_IDLECF;
+	USART2->CR3 |= USART_CR3_DMAR;				/* Received bytes are taken by DMA */
+	USART2->CR1 |= USART_CR1_IDLEIE | USART_CR1_RE;	/* Enable Rx and the idle-line interrupt */
+
+	/* Both handlers wake the reader, so they must be allowed to call the kernel */
+	NVIC_SetPriority(DMA1_Channel6_IRQn, OS_MAX_SYSCALL_PRIORITY);
+	NVIC_SetPriority(USART2_IRQn, OS_MAX_SYSCALL_PRIORITY);
+	NVIC_EnableIRQ(DMA1_Channel6_IRQn);
+	NVIC_EnableIRQ(USART2_IRQn);
+	return &_rxStream;
+}
+
+/* Half and full buffer interrupts */
+void DMA1_Channel6_IRQHandler(void) {
+	DMA1->IFCR = DMA_IFCR_CHTIF6 | DMA_IFCR_CTCIF6 | DMA_IFCR_CGIF6;
+	streamBufferWritten(&_rxStream, _rxPosition(), 0);
+}
+
+/* Idle line interrupt: the sender has paused, so whatever has arrived is a complete burst */
+void USART2_IRQHandler(void) {
+	if (USART2->ISR & USART_ISR_IDLE) {
+		USART2->ICR = USART_ICR_IDLECF;
+		streamBufferWritten(&_rxStream, _rxPosition(), 1);
+	}
+	if (USART2->ISR & USART_ISR_ORE) {
+		// Only possible if DMA falls behind; clear it so reception carries on
+		USART2->ICR = USART_ICR_ORECF;
+	}
+}
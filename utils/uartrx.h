@@ -0,0 +1,14 @@
+#ifndef _UARTRX_H_
+#define _UARTRX_H_
+
+#include "streambuffer.h"
+
+/* Size of the USART2 receive buffer in bytes.  Must be a power of two. */
+#define UART_RX_BUFFER_SIZE 256
+
+/* Starts receiving on USART2 (PA3) into a stream buffer, by circular DMA, and returns the
+   stream.  The reader is woken when 'trigger' bytes have arrived or the line goes idle.
+	 Must be called after config_init(). */
+streamBuffer_t *uartRxInit(uint32_t trigger);
+
+#endif /*_UARTRX_H_*/